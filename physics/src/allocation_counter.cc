@@ -0,0 +1,86 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace vstr {
+namespace {
+
+std::atomic<int64_t> allocation_count{0};
+
+void *Allocate(std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (size == 0) size = 1;
+  void *ptr = std::malloc(size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void *AllocateAligned(std::size_t size, std::align_val_t alignment) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  const std::size_t align = static_cast<std::size_t>(alignment);
+  // aligned_alloc wants the size to be a multiple of the alignment.
+  size = (size + align - 1) / align * align;
+  if (size == 0) size = align;
+  void *ptr = std::aligned_alloc(align, size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+}  // namespace
+
+int64_t AllocationCount() {
+  return allocation_count.load(std::memory_order_relaxed);
+}
+
+}  // namespace vstr
+
+void *operator new(std::size_t size) { return vstr::Allocate(size); }
+void *operator new[](std::size_t size) { return vstr::Allocate(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return vstr::Allocate(size);
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return vstr::Allocate(size);
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return vstr::AllocateAligned(size, alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return vstr::AllocateAligned(size, alignment);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
@@ -0,0 +1,29 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_ALLOCATION_COUNTER
+#define VSTR_ALLOCATION_COUNTER
+
+#include <cstdint>
+
+namespace vstr {
+
+// Linking the allocation_counter library replaces the global operator new and
+// delete with versions that count allocations on every thread. Tests and
+// benchmarks use this to assert that the steady-state simulation doesn't touch
+// the heap:
+//
+//   const int64_t before = AllocationCount();
+//   timeline.Simulate();
+//   EXPECT_EQ(AllocationCount() - before, 0);
+//
+// Don't link it into the library itself.
+int64_t AllocationCount();
+
+}  // namespace vstr
+
+#endif
@@ -9,39 +9,172 @@
 
 #include <absl/types/span.h>
 
-#include <chrono>
+#include <memory>
 
 #include "debug.h"
 #include "systems/object_pool.h"
 
 namespace vstr {
+namespace {
+
+// Where each optional component goes in FrameView.
+template <OptionalComponent T>
+struct ViewField;
+
+template <>
+struct ViewField<Orbit> {
+  static constexpr auto kCount = &FrameView::orbit_count;
+  static constexpr auto kData = &FrameView::orbit_data;
+};
+
+template <>
+struct ViewField<Durability> {
+  static constexpr auto kCount = &FrameView::durability_count;
+  static constexpr auto kData = &FrameView::durability_data;
+};
+
+template <>
+struct ViewField<Rocket> {
+  static constexpr auto kCount = &FrameView::rocket_count;
+  static constexpr auto kData = &FrameView::rocket_data;
+};
+
+template <>
+struct ViewField<Trigger> {
+  static constexpr auto kCount = &FrameView::trigger_count;
+  static constexpr auto kData = &FrameView::trigger_data;
+};
+
+template <>
+struct ViewField<ReusePool> {
+  static constexpr auto kCount = &FrameView::reuse_pool_count;
+  static constexpr auto kData = &FrameView::reuse_pool_data;
+};
+
+template <>
+struct ViewField<ReuseTag> {
+  static constexpr auto kCount = &FrameView::reuse_tag_count;
+  static constexpr auto kData = &FrameView::reuse_tag_data;
+};
+
+// Points view at the frame's arrays. Optional components that the frame type
+// leaves out show up as empty.
+template <OptionalComponent... Optional>
+void SyncView(BasicFrame<Optional...> &frame, FrameView &view) {
+  view = FrameView{};
+  view.object_count = frame.transforms.size();
+  view.transform_data = frame.transforms.data();
+  view.mass_data = frame.mass.data();
+  view.motion_data = frame.motion.data();
+  view.collider_data = frame.colliders.data();
+  view.glue_data = frame.glue.data();
+  view.flags_data = frame.flags.data();
+  frame.ForEachOptional([&]<typename T>(SparseSet<T> &components) {
+    view.*ViewField<T>::kCount = components.size();
+    view.*ViewField<T>::kData = components.data();
+  });
+}
+
+template <typename T>
+bool CopyColumn(const T *data, const int32_t count, std::vector<T> &column) {
+  if (count < 0) return false;
+  if (count > 0) column.assign(data, data + count);
+  return true;
+}
+
+template <typename T>
+bool AllocateColumn(const int32_t count, std::vector<T> &column, T *&data) {
+  if (count < 0) return false;
+  column.resize(count);
+  data = column.data();
+  return true;
+}
+
+template <typename T>
+void SyncColumnDelta(ColumnDelta<T> &delta, int32_t &range_count,
+                     DeltaRange *&ranges, T *&data) {
+  range_count = delta.ranges.size();
+  ranges = delta.ranges.data();
+  data = delta.values.data();
+}
+
+template <OptionalComponent T>
+void SyncOptionalDelta(OptionalDelta<T> &delta, int32_t &count, T *&data) {
+  count = delta.changed ? static_cast<int32_t>(delta.components.size()) : -1;
+  data = delta.components.data();
+}
+
+}  // namespace
+
 extern "C" {
 
 Frame *CreateFrame() { return new Frame(); }
 
 void FrameSyncView(Frame *frame, FrameView *out_view) {
-  out_view->transform_data = frame->transforms.data();
-  out_view->mass_data = frame->mass.data();
-  out_view->motion_data = frame->motion.data();
-  out_view->collider_data = frame->colliders.data();
-  out_view->glue_data = frame->glue.data();
-  out_view->flags_data = frame->flags.data();
-  out_view->orbit_data = frame->orbits.data();
-  out_view->durability_data = frame->durability.data();
-  out_view->rocket_data = frame->rockets.data();
-  out_view->trigger_data = frame->triggers.data();
-  out_view->reuse_pool_data = frame->reuse_pools.data();
-  out_view->reuse_tag_data = frame->reuse_tags.data();
-
-  out_view->object_count = frame->transforms.size();
-  out_view->orbit_count = frame->orbits.size();
-  out_view->durability_count = frame->durability.size();
-  out_view->rocket_count = frame->rockets.size();
-  out_view->trigger_count = frame->triggers.size();
-  out_view->reuse_pool_count = frame->reuse_pools.size();
-  out_view->reuse_tag_count = frame->reuse_tags.size();
+  SyncView(*frame, *out_view);
+}
+
+void FrameFlagsChanged(Frame *frame) { frame->flag_index.Sync(frame->flags); }
+
+bool FrameReserve(Frame *frame, int32_t capacity) {
+  if (capacity < 0) return false;
+  frame->Reserve(capacity);
+  return true;
+}
+
+bool FrameImport(Frame *frame, const FrameView *view) {
+  FrameColumns columns;
+  const int32_t n = view->object_count;
+  bool ok = CopyColumn(view->transform_data, n, columns.transforms) &&
+            CopyColumn(view->mass_data, n, columns.mass) &&
+            CopyColumn(view->motion_data, n, columns.motion) &&
+            CopyColumn(view->collider_data, n, columns.colliders) &&
+            CopyColumn(view->glue_data, n, columns.glue) &&
+            CopyColumn(view->flags_data, n, columns.flags) &&
+            CopyColumn(view->orbit_data, view->orbit_count, columns.orbits) &&
+            CopyColumn(view->durability_data, view->durability_count,
+                       columns.durability) &&
+            CopyColumn(view->rocket_data, view->rocket_count,
+                       columns.rockets) &&
+            CopyColumn(view->trigger_data, view->trigger_count,
+                       columns.triggers) &&
+            CopyColumn(view->reuse_pool_data, view->reuse_pool_count,
+                       columns.reuse_pools) &&
+            CopyColumn(view->reuse_tag_data, view->reuse_tag_count,
+                       columns.reuse_tags);
+  return ok && frame->Import(std::move(columns)).ok();
+}
+
+FrameColumns *CreateFrameColumns(FrameView *view) {
+  auto columns = std::make_unique<FrameColumns>();
+  const int32_t n = view->object_count;
+  bool ok =
+      AllocateColumn(n, columns->transforms, view->transform_data) &&
+      AllocateColumn(n, columns->mass, view->mass_data) &&
+      AllocateColumn(n, columns->motion, view->motion_data) &&
+      AllocateColumn(n, columns->colliders, view->collider_data) &&
+      AllocateColumn(n, columns->glue, view->glue_data) &&
+      AllocateColumn(n, columns->flags, view->flags_data) &&
+      AllocateColumn(view->orbit_count, columns->orbits, view->orbit_data) &&
+      AllocateColumn(view->durability_count, columns->durability,
+                     view->durability_data) &&
+      AllocateColumn(view->rocket_count, columns->rockets, view->rocket_data) &&
+      AllocateColumn(view->trigger_count, columns->triggers,
+                     view->trigger_data) &&
+      AllocateColumn(view->reuse_pool_count, columns->reuse_pools,
+                     view->reuse_pool_data) &&
+      AllocateColumn(view->reuse_tag_count, columns->reuse_tags,
+                     view->reuse_tag_data);
+  if (!ok) return nullptr;
+  return columns.release();
+}
+
+bool FrameImportColumns(Frame *frame, FrameColumns *columns) {
+  return frame->Import(std::move(*columns)).ok();
 }
 
+void DestroyFrameColumns(FrameColumns *columns) { delete columns; }
+
 int32_t FramePush(Frame *frame, Transform transform, Mass mass, Motion motion,
                   Collider collider, Glue glue, Flags flags) {
   return frame
@@ -71,9 +204,37 @@ int32_t FramePushObjectPool(Frame *frame, int32_t pool_id, int32_t prototype_id,
 }
 
 int32_t FrameSetOrbit(Frame *frame, Orbit orbit) {
+  // A zero-initialized parent_id would make object 0 the parent.
+  const Orbit *previous = frame->orbits.Find(orbit.id);
+  orbit.parent_id = previous != nullptr ? previous->parent_id : Entity::Nil();
   return SetOptionalComponent(orbit.id, orbit, frame->orbits);
 }
 
+bool FrameSetOrbitParent(Frame *frame, const int32_t id,
+                         const int32_t parent_id) {
+  Orbit *orbit = frame->orbits.Find(Entity(id));
+  if (orbit == nullptr) return false;
+  if (parent_id == -1) {
+    orbit->parent_id = Entity::Nil();
+    return true;
+  }
+  if (parent_id < 0 ||
+      parent_id >= static_cast<int32_t>(frame->transforms.size())) {
+    return false;
+  }
+
+  // Refuse to close a cycle. The depth limit guards against one that was
+  // imported.
+  const Orbit *ancestor = frame->orbits.Find(Entity(parent_id));
+  for (size_t depth = 0; ancestor != nullptr && depth < frame->orbits.size();
+       ++depth) {
+    if (ancestor->id == orbit->id) return false;
+    ancestor = frame->orbits.Find(ancestor->parent_id);
+  }
+  orbit->parent_id = Entity(parent_id);
+  return true;
+}
+
 int32_t FrameSetDurability(Frame *frame, Durability durability) {
   return SetOptionalComponent(durability.id, durability, frame->durability);
 }
@@ -88,6 +249,48 @@ int32_t FrameSetTrigger(Frame *frame, Trigger trigger) {
 
 void DestroyFrame(Frame *frame) { delete frame; }
 
+FrameDelta *CreateFrameDelta() { return new FrameDelta(); }
+
+void FrameDeltaSyncView(FrameDelta *delta, FrameDeltaView *out_view) {
+  out_view->object_count = delta->object_count;
+
+  SyncColumnDelta(delta->transforms, out_view->transform_range_count,
+                  out_view->transform_ranges, out_view->transform_data);
+  SyncColumnDelta(delta->mass, out_view->mass_range_count,
+                  out_view->mass_ranges, out_view->mass_data);
+  SyncColumnDelta(delta->motion, out_view->motion_range_count,
+                  out_view->motion_ranges, out_view->motion_data);
+  SyncColumnDelta(delta->colliders, out_view->collider_range_count,
+                  out_view->collider_ranges, out_view->collider_data);
+  SyncColumnDelta(delta->glue, out_view->glue_range_count,
+                  out_view->glue_ranges, out_view->glue_data);
+  SyncColumnDelta(delta->flags, out_view->flags_range_count,
+                  out_view->flags_ranges, out_view->flags_data);
+
+  SyncOptionalDelta(delta->orbits, out_view->orbit_count,
+                    out_view->orbit_data);
+  SyncOptionalDelta(delta->durability, out_view->durability_count,
+                    out_view->durability_data);
+  SyncOptionalDelta(delta->rockets, out_view->rocket_count,
+                    out_view->rocket_data);
+  SyncOptionalDelta(delta->triggers, out_view->trigger_count,
+                    out_view->trigger_data);
+  SyncOptionalDelta(delta->reuse_pools, out_view->reuse_pool_count,
+                    out_view->reuse_pool_data);
+  SyncOptionalDelta(delta->reuse_tags, out_view->reuse_tag_count,
+                    out_view->reuse_tag_data);
+}
+
+void FrameDiff(const Frame *from, const Frame *to, FrameDelta *delta) {
+  Diff(*from, *to, *delta);
+}
+
+void FramePatch(Frame *frame, const FrameDelta *delta) {
+  Patch(*delta, *frame);
+}
+
+void DestroyFrameDelta(FrameDelta *delta) { delete delta; }
+
 Vector3 KeplerEllipticalPosition(Orbit::Kepler kepler) {
   return EllipticalPosition(kepler);
 }
@@ -149,42 +352,35 @@ void TimelineInputEventRange(Timeline *timeline, int first_frame_no,
 
 int TimelineSimulate(Timeline *timeline, float time_budget, int limit,
                      uint64_t *time_spent_nanos) {
-  const int max_frames = limit - timeline->head();
-  if (max_frames <= 0) return 0;
-
-  // Simulate one frame and measure how long that took us.
-  auto now = std::chrono::steady_clock::now();
-  auto start = now;
-  timeline->Simulate();
-  int frames = 1;
-
-  // We really don't want to exceed the time budget, so we assume subsequent
-  // frames might take 1.2x as long as the first frame did.
-  now = std::chrono::steady_clock::now();
-  auto cost = 1.2 * (now - start);
-  auto deadline = start + std::chrono::duration<double>(time_budget);
-
-  // Keep going as long as we think simulating the next frame won't exceed the
-  // deadline.
-  while (now + cost < deadline && frames < max_frames) {
-    timeline->Simulate();
-    now = std::chrono::steady_clock::now();
-    ++frames;
-  }
-
-  *time_spent_nanos =
-      std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
-  return frames;
+  return timeline->Simulate(time_budget, limit, *time_spent_nanos);
 }
 
 int TimelineGetHead(Timeline *timeline) { return timeline->head(); }
 
 int TimelineGetTail(Timeline *timeline) { return timeline->tail(); }
 
+bool TimelineSetTimeLod(Timeline *timeline, const int horizon,
+                        const int stride) {
+  return timeline->SetTimeLod(horizon, stride).ok();
+}
+
+void TimelineSetPlayhead(Timeline *timeline, const int frame_no) {
+  timeline->SetPlayhead(frame_no);
+}
+
+int TimelineGetCoarseStart(Timeline *timeline) {
+  return timeline->coarse_start();
+}
+
 const Frame *TimelineGetFrame(Timeline *timeline, int frame_no) {
   return timeline->GetFrame(frame_no);
 }
 
+bool TimelineGetChanges(Timeline *timeline, int since_frame_no, int frame_no,
+                        FrameDelta *delta) {
+  return timeline->GetChanges(since_frame_no, frame_no, *delta);
+}
+
 void TimelineGetEvents(Timeline *timeline, int frame_no, EventBuffer *buffer) {
   timeline->GetEvents(frame_no, *buffer);
 }
@@ -207,5 +403,55 @@ bool TimelineRunQuery(Timeline *timeline, TimelineQuery *query) {
   auto status = timeline->Query(query->resolution, trajectories);
   return status.ok();
 }
+
+void TimelineSetApproximateQueries(Timeline *timeline, const bool approximate) {
+  timeline->set_approximate_queries(approximate);
+}
+
+bool TimelineRunPrediction(Timeline *timeline, TimelineQuery *query) {
+  auto trajectories =
+      absl::MakeSpan(query->trajectory_buffer, query->trajectory_buffer_sz);
+  auto status = timeline->Predict(query->resolution, trajectories);
+  return status.ok();
+}
+
+TimelineScheduler *CreateTimelineScheduler(const int threads) {
+  if (threads <= 0) return new TimelineScheduler();
+  return new TimelineScheduler(std::make_shared<ThreadPool>(threads));
+}
+
+int TimelineSchedulerAdd(TimelineScheduler *scheduler, Timeline *timeline,
+                         const float time_budget) {
+  return scheduler->Add(timeline, time_budget);
+}
+
+bool TimelineSchedulerRemove(TimelineScheduler *scheduler, const int handle) {
+  return scheduler->Remove(handle);
+}
+
+bool TimelineSchedulerSetLimit(TimelineScheduler *scheduler, const int handle,
+                               const int limit) {
+  return scheduler->SetLimit(handle, limit);
+}
+
+bool TimelineSchedulerSetTimeBudget(TimelineScheduler *scheduler,
+                                    const int handle, const float time_budget) {
+  return scheduler->SetTimeBudget(handle, time_budget);
+}
+
+int TimelineSchedulerRun(TimelineScheduler *scheduler) {
+  return scheduler->Run();
+}
+
+bool TimelineSchedulerGetStats(TimelineScheduler *scheduler, const int handle,
+                               TimelineScheduler::Stats *stats) {
+  if (!scheduler->Registered(handle)) return false;
+  *stats = scheduler->stats(handle);
+  return true;
+}
+
+void DestroyTimelineScheduler(TimelineScheduler *scheduler) {
+  delete scheduler;
+}
 }
 }  // namespace vstr
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include "geometry/layer_matrix.h"
 #include "geometry/vector3.h"
 #include "timeline.h"
+#include "timeline_scheduler.h"
 #include "types/required_components.h"
 
 #if defined(__APPLE__) || defined(__linux__) || defined(ANDROID)
@@ -36,6 +37,11 @@ EXPORT Frame *CreateFrame();
 // components include as their first field the ID of the object they belong to.
 // (With core components that's not needed, because the array offset is the ID.)
 // They must still be kept sorted by object ID, to enable binary search.
+//
+// References to other objects, like Glue::parent_id and Orbit::parent_id, are
+// -1 when there is none. Zero refers to the first object, so zero-initialized
+// structs must have them set before import. (Orbit::parent_id is the last field
+// of Orbit, and foreign mirrors of the struct must include it.)
 struct FrameView {
   int32_t object_count;
 
@@ -67,6 +73,32 @@ struct FrameView {
 
 EXPORT void FrameSyncView(Frame *frame, FrameView *out_view);
 
+// Must be called after writing to flags_data in a FrameView, before the frame
+// is simulated. The simulation keeps an index of the flags, which doesn't see
+// writes made through the view.
+EXPORT void FrameFlagsChanged(Frame *frame);
+
+// Reserves space for capacity objects, so that FramePush doesn't move the
+// arrays in FrameView until there are more. Returns false if capacity is
+// negative.
+EXPORT bool FrameReserve(Frame *frame, int32_t capacity);
+
+// Replaces the contents of frame with the scene described by view, copying
+// each array once. Optional components may be in any order. This is much faster
+// than building a large scene with FramePush and the FrameSet* functions.
+// Returns false, leaving the frame unchanged, if the scene is invalid (e.g. an
+// optional component refers to an object that doesn't exist).
+EXPORT bool FrameImport(Frame *frame, const FrameView *view);
+
+// Zero-copy version of FrameImport. CreateFrameColumns allocates arrays for the
+// counts given in view and stores their addresses in view's data pointers. The
+// caller fills them in, and FrameImportColumns then hands them over to the
+// frame without copying. (The columns object is left empty and must still be
+// destroyed.) CreateFrameColumns returns null if any count is negative.
+EXPORT FrameColumns *CreateFrameColumns(FrameView *view);
+EXPORT bool FrameImportColumns(Frame *frame, FrameColumns *columns);
+EXPORT void DestroyFrameColumns(FrameColumns *columns);
+
 EXPORT int32_t FramePush(Frame *frame, Transform transform, Mass mass,
                          Motion motion, Collider collider, Glue glue,
                          Flags flags);
@@ -74,13 +106,78 @@ EXPORT int32_t FramePush(Frame *frame, Transform transform, Mass mass,
 EXPORT int32_t FramePushObjectPool(Frame *frame, int32_t pool_id,
                                    int32_t prototype_id, int32_t capacity, int32_t *out_ids);
 
+// Ignores orbit.parent_id: the orbit keeps the parent it had, or has none if
+// it's new. Use FrameSetOrbitParent to set one.
 EXPORT int32_t FrameSetOrbit(Frame *frame, Orbit orbit);
+// Makes the orbit of object id follow the orbit of parent_id (see
+// Orbit::parent_id), or clears the parent if parent_id is -1. Returns false,
+// changing nothing, if id has no orbit, parent_id isn't an object, or the
+// parent would close a cycle.
+EXPORT bool FrameSetOrbitParent(Frame *frame, int32_t id, int32_t parent_id);
 EXPORT int32_t FrameSetDurability(Frame *frame, Durability durability);
 EXPORT int32_t FrameSetRocket(Frame *frame, Rocket rocket);
 EXPORT int32_t FrameSetTrigger(Frame *frame, Trigger trigger);
 
 EXPORT void DestroyFrame(Frame *frame);
 
+// FRAME DELTA API //
+
+// Changes between two frames, laid out like FrameView. For each required
+// component, *_ranges lists runs of changed objects, and *_data holds the new
+// values for all the objects in those runs, in order. Optional component sets
+// are either unchanged (count is -1) or replaced whole.
+struct FrameDeltaView {
+  int32_t object_count;
+
+  int32_t transform_range_count;
+  DeltaRange *transform_ranges;
+  Transform *transform_data;
+
+  int32_t mass_range_count;
+  DeltaRange *mass_ranges;
+  Mass *mass_data;
+
+  int32_t motion_range_count;
+  DeltaRange *motion_ranges;
+  Motion *motion_data;
+
+  int32_t collider_range_count;
+  DeltaRange *collider_ranges;
+  Collider *collider_data;
+
+  int32_t glue_range_count;
+  DeltaRange *glue_ranges;
+  Glue *glue_data;
+
+  int32_t flags_range_count;
+  DeltaRange *flags_ranges;
+  Flags *flags_data;
+
+  int32_t orbit_count;
+  Orbit *orbit_data;
+
+  int32_t durability_count;
+  Durability *durability_data;
+
+  int32_t rocket_count;
+  Rocket *rocket_data;
+
+  int32_t trigger_count;
+  Trigger *trigger_data;
+
+  int32_t reuse_pool_count;
+  ReusePool *reuse_pool_data;
+
+  int32_t reuse_tag_count;
+  ReuseTag *reuse_tag_data;
+};
+
+EXPORT FrameDelta *CreateFrameDelta();
+EXPORT void FrameDeltaSyncView(FrameDelta *delta, FrameDeltaView *out_view);
+EXPORT void FrameDiff(const Frame *from, const Frame *to, FrameDelta *delta);
+EXPORT void FramePatch(Frame *frame, const FrameDelta *delta);
+EXPORT void DestroyFrameDelta(FrameDelta *delta);
+
 // ORBIT API //
 
 EXPORT Vector3 KeplerEllipticalPosition(Orbit::Kepler kepler);
@@ -121,8 +218,18 @@ EXPORT void TimelineInputEventRange(Timeline *timeline, int first_frame_no,
 EXPORT int TimelineSimulate(Timeline *timeline, float time_budget, int limit,
                             uint64_t *time_spent_nanos);
 EXPORT const Frame *TimelineGetFrame(Timeline *timeline, int frame_no);
+// Stores the changes from since_frame_no to frame_no in delta. Returns false if
+// either frame is out of range.
+EXPORT bool TimelineGetChanges(Timeline *timeline, int since_frame_no,
+                               int frame_no, FrameDelta *delta);
 EXPORT int TimelineGetHead(Timeline *timeline);
 EXPORT int TimelineGetTail(Timeline *timeline);
+// Frames more than horizon frames past the playhead are simulated stride frames
+// at a time. Returns false if stride doesn't divide the key frame period.
+EXPORT bool TimelineSetTimeLod(Timeline *timeline, int horizon, int stride);
+EXPORT void TimelineSetPlayhead(Timeline *timeline, int frame_no);
+// Frames after this one are coarse.
+EXPORT int TimelineGetCoarseStart(Timeline *timeline);
 EXPORT void TimelineGetEvents(Timeline *timeline, int frame_no,
                               EventBuffer *buffer);
 EXPORT void TimelineGetEventRange(Timeline *timeline, int first_frame_no,
@@ -139,6 +246,33 @@ struct TimelineQuery {
 };
 
 EXPORT bool TimelineRunQuery(Timeline *timeline, TimelineQuery *query);
+// See Timeline::set_approximate_queries.
+EXPORT void TimelineSetApproximateQueries(Timeline *timeline, bool approximate);
+// Same as above, but for Timeline::Predict.
+EXPORT bool TimelineRunPrediction(Timeline *timeline, TimelineQuery *query);
+
+// Timeline scheduler API //
+
+// Steps many timelines on a shared pool of worker threads. With threads <= 0,
+// TimelineSchedulerRun steps them all on the calling thread.
+EXPORT TimelineScheduler *CreateTimelineScheduler(int threads);
+// The timeline must stay alive until it's removed or the scheduler destroyed.
+// Returns a handle for the other calls.
+EXPORT int TimelineSchedulerAdd(TimelineScheduler *scheduler,
+                                Timeline *timeline, float time_budget);
+// These return false if the handle isn't registered.
+EXPORT bool TimelineSchedulerRemove(TimelineScheduler *scheduler, int handle);
+EXPORT bool TimelineSchedulerSetLimit(TimelineScheduler *scheduler, int handle,
+                                      int limit);
+EXPORT bool TimelineSchedulerSetTimeBudget(TimelineScheduler *scheduler,
+                                           int handle, float time_budget);
+// Simulates every timeline towards its limit, within its time budget. Returns
+// the total number of frames simulated.
+EXPORT int TimelineSchedulerRun(TimelineScheduler *scheduler);
+// Returns false, leaving stats unchanged, if the handle isn't registered.
+EXPORT bool TimelineSchedulerGetStats(TimelineScheduler *scheduler, int handle,
+                                      TimelineScheduler::Stats *stats);
+EXPORT void DestroyTimelineScheduler(TimelineScheduler *scheduler);
 }
 }  // namespace vstr
 
@@ -0,0 +1,100 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "c_api.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace vstr {
+namespace {
+
+int32_t PushObject(Frame *frame) {
+  return FramePush(frame, Transform{}, Mass{}, Motion{}, Collider{}, Glue{},
+                   Flags{});
+}
+
+TEST(CApiTest, FrameSetOrbitIgnoresParent) {
+  Frame *frame = CreateFrame();
+  const int32_t sun = PushObject(frame);
+  const int32_t planet = PushObject(frame);
+  ASSERT_EQ(sun, 0);
+
+  // What a foreign caller gets from zero-initializing the struct.
+  Orbit orbit{};
+  orbit.id = Entity(planet);
+  orbit.parent_id = Entity(0);
+  FrameSetOrbit(frame, orbit);
+  EXPECT_EQ(frame->orbits.Find(Entity(planet))->parent_id, Entity::Nil());
+
+  // An explicitly set parent survives updates to the orbit.
+  EXPECT_TRUE(FrameSetOrbitParent(frame, planet, sun));
+  orbit.parent_id = Entity::Nil();
+  FrameSetOrbit(frame, orbit);
+  EXPECT_EQ(frame->orbits.Find(Entity(planet))->parent_id, Entity(sun));
+
+  EXPECT_TRUE(FrameSetOrbitParent(frame, planet, -1));
+  EXPECT_EQ(frame->orbits.Find(Entity(planet))->parent_id, Entity::Nil());
+  DestroyFrame(frame);
+}
+
+TEST(CApiTest, FrameSetOrbitParentRefusesCycles) {
+  Frame *frame = CreateFrame();
+  const int32_t sun = PushObject(frame);
+  const int32_t planet = PushObject(frame);
+  const int32_t moon = PushObject(frame);
+  for (const int32_t id : {sun, planet, moon}) {
+    Orbit orbit{};
+    orbit.id = Entity(id);
+    FrameSetOrbit(frame, orbit);
+  }
+
+  EXPECT_TRUE(FrameSetOrbitParent(frame, planet, sun));
+  EXPECT_TRUE(FrameSetOrbitParent(frame, moon, planet));
+  EXPECT_FALSE(FrameSetOrbitParent(frame, sun, moon));
+  EXPECT_FALSE(FrameSetOrbitParent(frame, sun, sun));
+  EXPECT_EQ(frame->orbits.Find(Entity(sun))->parent_id, Entity::Nil());
+
+  // Neither the orbit nor the parent may be missing.
+  EXPECT_FALSE(FrameSetOrbitParent(frame, 3, sun));
+  EXPECT_FALSE(FrameSetOrbitParent(frame, moon, 3));
+  DestroyFrame(frame);
+}
+
+TEST(CApiTest, FrameFlagsChanged) {
+  Frame *frame = CreateFrame();
+  const int32_t id = PushObject(frame);
+  FrameView view;
+  FrameSyncView(frame, &view);
+
+  view.flags_data[id].value |= Flags::kDestroyed;
+  EXPECT_FALSE(frame->flag_index.Matches(frame->flags));
+  FrameFlagsChanged(frame);
+  EXPECT_TRUE(frame->flag_index.Test(Entity(id), Flags::kDestroyed));
+  DestroyFrame(frame);
+}
+
+TEST(CApiTest, FrameReserveRejectsNegativeCapacity) {
+  Frame *frame = CreateFrame();
+  EXPECT_FALSE(FrameReserve(frame, -1));
+  EXPECT_TRUE(FrameReserve(frame, 1000));
+  EXPECT_GE(frame->transforms.capacity(), 1000u);
+  DestroyFrame(frame);
+}
+
+TEST(CApiTest, TimelineSchedulerGetStatsRejectsUnknownHandles) {
+  TimelineScheduler *scheduler = CreateTimelineScheduler(0);
+  TimelineScheduler::Stats stats{.frames = 7};
+  for (const int bad : {-1, 0, 1}) {
+    EXPECT_FALSE(TimelineSchedulerGetStats(scheduler, bad, &stats)) << bad;
+  }
+  EXPECT_EQ(stats.frames, 7);
+  DestroyTimelineScheduler(scheduler);
+}
+
+}  // namespace
+}  // namespace vstr
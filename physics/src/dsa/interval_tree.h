@@ -8,6 +8,7 @@
 #ifndef VSTR_INTERVAL_TREE
 #define VSTR_INTERVAL_TREE
 
+#include <absl/container/inlined_vector.h>
 #include <absl/status/statusor.h>
 #include <assert.h>
 
@@ -151,7 +152,10 @@ class IntervalTree {
     const IntervalTree* tree_;
     int node_;
     const Interval interval_;
-    std::vector<int> stack_;
+    // The DFS stack grows by at most one entry per level, so it only
+    // allocates for trees far deeper than the red-black invariants allow at
+    // realistic sizes.
+    absl::InlinedVector<int, 64> stack_;
 
     friend class IntervalTree;  // To call the constructor.
   };
@@ -0,0 +1,44 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "union_find.h"
+
+#include <cstddef>
+#include <numeric>
+#include <utility>
+
+namespace vstr {
+
+void UnionFind::Reset(const size_t size) {
+  parent_.resize(size);
+  std::iota(parent_.begin(), parent_.end(), 0);
+  set_size_.assign(size, 1);
+}
+
+int32_t UnionFind::Find(int32_t x) {
+  while (parent_[x] != x) {
+    // Path halving: point every other node on the path at its grandparent.
+    parent_[x] = parent_[parent_[x]];
+    x = parent_[x];
+  }
+  return x;
+}
+
+bool UnionFind::Union(const int32_t a, const int32_t b) {
+  int32_t root_a = Find(a);
+  int32_t root_b = Find(b);
+  if (root_a == root_b) return false;
+  if (set_size_[root_a] < set_size_[root_b] ||
+      (set_size_[root_a] == set_size_[root_b] && root_b < root_a)) {
+    std::swap(root_a, root_b);
+  }
+  parent_[root_b] = root_a;
+  set_size_[root_a] += set_size_[root_b];
+  return true;
+}
+
+}  // namespace vstr
@@ -0,0 +1,47 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_UNION_FIND
+#define VSTR_UNION_FIND
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vstr {
+
+// Disjoint sets of the integers [0, size), with union by size and path halving.
+// Both operations take amortized near-constant time.
+//
+// The representative of a set only depends on the order of Union calls, so
+// callers that join in a deterministic order get deterministic roots.
+class UnionFind {
+ public:
+  // Puts every element in a set of its own. Keeps the storage.
+  void Reset(size_t size);
+
+  inline size_t size() const { return parent_.size(); }
+
+  int32_t Find(int32_t x);
+
+  // Joins the sets containing a and b. Returns false if they were already the
+  // same set. When the sets are the same size, the root with the lower value
+  // becomes the root of the union.
+  bool Union(int32_t a, int32_t b);
+
+  // Number of elements in the set containing x.
+  inline int32_t SetSize(const int32_t x) { return set_size_[Find(x)]; }
+
+ private:
+  std::vector<int32_t> parent_;
+  // Only valid for roots.
+  std::vector<int32_t> set_size_;
+};
+
+}  // namespace vstr
+
+#endif
@@ -0,0 +1,70 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "union_find.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <random>
+
+namespace vstr {
+namespace {
+
+TEST(UnionFindTest, Basic) {
+  UnionFind sets;
+  sets.Reset(6);
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(sets.Find(i), i);
+    EXPECT_EQ(sets.SetSize(i), 1);
+  }
+
+  EXPECT_TRUE(sets.Union(4, 1));
+  // Equal sizes: the lower root wins.
+  EXPECT_EQ(sets.Find(4), 1);
+  EXPECT_TRUE(sets.Union(5, 4));
+  // The larger set's root wins.
+  EXPECT_EQ(sets.Find(5), 1);
+  EXPECT_FALSE(sets.Union(5, 1));
+  EXPECT_EQ(sets.SetSize(4), 3);
+  EXPECT_EQ(sets.SetSize(0), 1);
+
+  sets.Reset(3);
+  EXPECT_EQ(sets.size(), 3);
+  EXPECT_EQ(sets.Find(1), 1);
+}
+
+TEST(UnionFindTest, MatchesNaive) {
+  constexpr int kSize = 500;
+  std::mt19937 random_generator(1);
+  std::uniform_int_distribution<int> element_rg(0, kSize - 1);
+
+  UnionFind sets;
+  sets.Reset(kSize);
+  // Each element's set, relabeled in full on every union.
+  std::vector<int> naive(kSize);
+  for (int i = 0; i < kSize; ++i) naive[i] = i;
+
+  for (int n = 0; n < 300; ++n) {
+    const int a = element_rg(random_generator);
+    const int b = element_rg(random_generator);
+    EXPECT_EQ(sets.Union(a, b), naive[a] != naive[b]);
+    const int from = naive[b];
+    for (int &label : naive) {
+      if (label == from) label = naive[a];
+    }
+  }
+
+  for (int a = 0; a < kSize; ++a) {
+    for (int b = a + 1; b < kSize; b += 7) {
+      EXPECT_EQ(sets.Find(a) == sets.Find(b), naive[a] == naive[b]);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace vstr
@@ -10,7 +10,10 @@
 namespace vstr {
 
 bool AABB::Overlaps(const AABB &other) const {
-  return max >= other.min && min <= other.max;
+  // Vector3's comparison operators are lexicographic, so compare each axis.
+  return max.x >= other.min.x && max.y >= other.min.y &&
+         max.z >= other.min.z && min.x <= other.max.x &&
+         min.y <= other.max.y && min.z <= other.max.z;
 }
 
 void AABB::Encapsulate(const AABB &other) {
@@ -0,0 +1,35 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "geometry/aabb.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace vstr {
+namespace {
+
+TEST(AABBTest, Overlaps) {
+  const AABB box(Vector3{0, 0, 0}, Vector3{2, 2, 2});
+  EXPECT_TRUE(box.Overlaps(AABB(Vector3{1, 1, 1}, Vector3{3, 3, 3})));
+  EXPECT_TRUE(box.Overlaps(AABB(Vector3{-1, -1, -1}, Vector3{3, 3, 3})));
+  // Touching faces count.
+  EXPECT_TRUE(box.Overlaps(AABB(Vector3{2, 0, 0}, Vector3{3, 2, 2})));
+  EXPECT_FALSE(box.Overlaps(AABB(Vector3{3, 0, 0}, Vector3{4, 2, 2})));
+}
+
+TEST(AABBTest, SeparatedOnOneAxis) {
+  // Overlapping on x, which a lexicographic comparison of the corners stops at,
+  // but apart on y or z.
+  const AABB box(Vector3{0, 0, 0}, Vector3{2, 2, 2});
+  EXPECT_FALSE(box.Overlaps(AABB(Vector3{1, 5, 0}, Vector3{3, 6, 2})));
+  EXPECT_FALSE(box.Overlaps(AABB(Vector3{1, 0, -6}, Vector3{3, 2, -5})));
+  EXPECT_FALSE(AABB(Vector3{1, 5, 0}, Vector3{3, 6, 2}).Overlaps(box));
+}
+
+}  // namespace
+}  // namespace vstr
@@ -193,7 +193,11 @@ class BoundingVolumeHierarchy {
 
   static AABB BoundingVolume(typename std::vector<KV>::const_iterator start,
                              typename std::vector<KV>::const_iterator end) {
-    AABB result;
+    // Start from the first box, not AABB(), which would always include the
+    // origin.
+    if (start == end) return AABB();
+    AABB result = start->bounds;
+    ++start;
     while (start != end) {
       result.Encapsulate(start->bounds);
       ++start;
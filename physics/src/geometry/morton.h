@@ -0,0 +1,51 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_MORTON
+#define VSTR_MORTON
+
+#include <cstdint>
+
+#include "geometry/aabb.h"
+
+namespace vstr {
+
+// Spreads the low 21 bits of v so there are two zero bits between each.
+inline uint64_t SpreadBits(uint64_t v) {
+  v &= 0x1fffff;
+  v = (v | v << 32) & 0x1f00000000ffff;
+  v = (v | v << 16) & 0x1f0000ff0000ff;
+  v = (v | v << 8) & 0x100f00f00f00f00f;
+  v = (v | v << 4) & 0x10c30c30c30c30c3;
+  v = (v | v << 2) & 0x1249249249249249;
+  return v;
+}
+
+// Maps v in [lo, hi] onto 21 bits. Values outside the range (and NaNs) are
+// clamped.
+inline uint64_t QuantizeAxis(const float v, const float lo, const float hi) {
+  constexpr uint64_t kMax = (1 << 21) - 1;
+  const float extent = hi - lo;
+  if (!(extent > 0)) return 0;
+  const float t = (v - lo) / extent * (1 << 21);
+  if (!(t > 0)) return 0;
+  if (t >= kMax) return kMax;
+  return static_cast<uint64_t>(t);
+}
+
+// Z-order curve index of point within bounds, 21 bits per axis. Points that are
+// close together in space mostly have close Morton codes, so sorting objects by
+// their Morton code puts spatial neighbors next to each other in memory.
+inline uint64_t MortonCode(const Vector3 &point, const AABB &bounds) {
+  return SpreadBits(QuantizeAxis(point.x, bounds.min.x, bounds.max.x)) |
+         SpreadBits(QuantizeAxis(point.y, bounds.min.y, bounds.max.y)) << 1 |
+         SpreadBits(QuantizeAxis(point.z, bounds.min.z, bounds.max.z)) << 2;
+}
+
+}  // namespace vstr
+
+#endif
@@ -0,0 +1,41 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "geometry/morton.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <limits>
+
+namespace vstr {
+namespace {
+
+TEST(MortonTest, InterleavesAxes) {
+  const AABB bounds(Vector3{0, 0, 0}, Vector3{1, 1, 1});
+  EXPECT_EQ(MortonCode(Vector3{0, 0, 0}, bounds), 0);
+  // The top bit of each axis ends up in bits 60 (x), 61 (y) and 62 (z).
+  EXPECT_EQ(MortonCode(Vector3{0.5, 0, 0}, bounds), 1ull << 60);
+  EXPECT_EQ(MortonCode(Vector3{0, 0.5, 0}, bounds), 1ull << 61);
+  EXPECT_EQ(MortonCode(Vector3{0, 0, 0.5}, bounds), 1ull << 62);
+  EXPECT_EQ(MortonCode(Vector3{1, 1, 1}, bounds), (1ull << 63) - 1);
+}
+
+TEST(MortonTest, Clamps) {
+  const AABB bounds(Vector3{-1, -1, -1}, Vector3{1, 1, 1});
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  EXPECT_EQ(MortonCode(Vector3{-5, -5, -5}, bounds), 0);
+  EXPECT_EQ(MortonCode(Vector3{nan, nan, nan}, bounds), 0);
+  EXPECT_EQ(MortonCode(Vector3{5, 5, 5}, bounds), (1ull << 63) - 1);
+
+  // Degenerate bounds.
+  const AABB point(Vector3{1, 1, 1}, Vector3{1, 1, 1});
+  EXPECT_EQ(MortonCode(Vector3{1, 1, 1}, point), 0);
+}
+
+}  // namespace
+}  // namespace vstr
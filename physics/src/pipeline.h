@@ -10,46 +10,754 @@
 
 #include <absl/types/span.h>
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <vector>
 
 #include "systems/collision_detector.h"
 #include "systems/collision_rule_set.h"
+#include "systems/event_effects.h"
 #include "systems/glue_system.h"
+#include "systems/islands.h"
 #include "systems/kepler.h"
 #include "systems/motion.h"
+#include "systems/neighbor_lists.h"
+#include "systems/object_pool.h"
+#include "systems/orbit_cache.h"
+#include "systems/rocket.h"
+#include "task_graph.h"
 #include "types/frame.h"
 #include "types/required_components.h"
 
 namespace vstr {
 
-class Pipeline {
+// Selects, at compile time, which stages a BasicPipeline runs and how it
+// integrates motion. Stages that are off are compiled out, together with their
+// scheduling, so a pipeline specialized for a scene only pays for what the
+// scene uses.
+struct PipelineConfig {
+  // Convert SpawnAttempt events using ReusePools. When off, spawn attempts are
+  // ignored.
+  bool spawns = true;
+  // Move objects with an Orbit along it. When off, kOrbiting objects stay put.
+  bool orbits = true;
+  // Convert RocketBurn events to acceleration. When off, burns are ignored.
+  bool rockets = true;
+  // Detect collisions and apply the CollisionRuleSet. When off, objects pass
+  // through each other.
+  bool collisions = true;
+  // Allow set_fidelity_lod. When off, every object is simulated in full.
+  bool spatial_lod = true;
+  // With a thread pool (and spatial LOD off), split integration between tasks
+  // by interaction island. When off, or with kFourthOrderYoshida, one task
+  // integrates every object.
+  bool islands = true;
+  // When true, the integrator is chosen by the constructor argument. When
+  // false, the pipeline always calls the one below, with no dispatch.
+  bool runtime_integrator = true;
+  IntegrationMethod integrator = kVelocityVerlet;
+};
+
+// Runs every stage. This is what the Timeline and the C API use.
+inline constexpr PipelineConfig kGenericPipeline{};
+
+// Spatial LOD: objects far from every point of interest are simulated at
+// reduced fidelity.
+struct FidelityLod {
+  // Objects within radius of any of these points, or of any of these entities
+  // that isn't destroyed, are simulated in full.
+  std::vector<Vector3> points;
+  std::vector<Entity> entities;
+  float radius = 0;
+  // Objects further out only feel gravity from this many of the most massive
+  // attractors. With zero, they drift in straight lines.
+  int attractors = 1;
+  // Pairs of objects that are both further out are only checked for collisions
+  // on frames divisible by this, and collisions between them on other frames
+  // are missed. Pairs with an object simulated in full are checked every frame.
+  int collision_interval = 1;
+};
+
+// What each LOD region cost in the last Step or Replay.
+struct FidelityStats {
+  // Objects that aren't destroyed in each region.
+  int full_objects;
+  int reduced_objects;
+  // Time spent integrating each region.
+  uint64_t full_nanos;
+  uint64_t reduced_nanos;
+  // Time spent detecting collisions, and whether pairs of reduced objects were
+  // checked.
+  uint64_t collision_nanos;
+  bool reduced_collisions;
+};
+
+namespace pipeline_internal {
+
+// The data stages read and write, for the purpose of scheduling them. Each
+// component of the frame is its own resource, except that the flags and the
+// flag index always go together.
+enum Resource : uint32_t {
+  kTransforms = 1 << 0,
+  kMass = 1 << 1,
+  kMotion = 1 << 2,
+  kColliders = 1 << 3,
+  kGlue = 1 << 4,
+  kFlags = 1 << 5,
+  kOrbits = 1 << 6,
+  kDurability = 1 << 7,
+  kRockets = 1 << 8,
+  kTriggers = 1 << 9,
+  kReusePools = 1 << 10,
+  kReuseTags = 1 << 11,
+  // Input events. (Rockets rewrite them in place.)
+  kInput = 1 << 12,
+  kOutEvents = 1 << 13,
+  // BasicPipeline::motion_buffers_, neighbors_, ballistic_ and the scratch
+  // buffers of island_tasks_.
+  kMotionBuffers = 1 << 14,
+  // BasicPipeline::spatial_order_.
+  kSpatialOrder = 1 << 15,
+  // BasicPipeline::regions_ and fidelity_stats_.
+  kFidelity = 1 << 16,
+  // BasicPipeline::islands_, island_task_index_ and island_stats_.
+  kIslands = 1 << 17,
+  kEverything = ~0u,
+};
+
+// How many lookahead windows of orbit positions BasicPipeline::orbit_cache_
+// keeps, counting the current one.
+constexpr int kOrbitCacheWindows = 4;
+
+// Values of BasicPipeline::regions_.
+enum Region : uint8_t {
+  kFullFidelity = 0,
+  kReducedFidelity = 1,
+};
+
+// The arguments to Step or Replay. Stages capture a reference to this and the
+// pipeline, which is small enough for std::function not to allocate.
+template <typename FrameType>
+struct StageContext {
+  // The length of the whole step, which spans frames frames.
+  float dt;
+  int frame_no;
+  int frames;
+  FrameType &frame;
+  absl::Span<Event> input;
+  std::vector<Event> *out_events;
+};
+
+inline bool CompareIds(const Event &a, const Event &b) { return a.id < b.id; }
+
+inline uint64_t NanosSince(const std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+}  // namespace pipeline_internal
+
+// Steps frames of type FrameType, which can be any BasicFrame that has the
+// optional components the configured stages need. Events that need components
+// the frame type leaves out have no effect (see ApplyEventEffects).
+template <PipelineConfig kConfig, typename FrameType = Frame>
+class BasicPipeline {
+  static_assert(!kConfig.orbits || FrameType::template kHas<Orbit>,
+                "orbits need a frame with Orbit components");
+  static_assert(!kConfig.rockets || FrameType::template kHas<Rocket>,
+                "rockets need a frame with Rocket components");
+  static_assert(!kConfig.spawns || (FrameType::template kHas<ReusePool> &&
+                                    FrameType::template kHas<ReuseTag>),
+                "spawns need a frame with ReusePool and ReuseTag components");
+  static_assert(!kConfig.collisions || FrameType::template kHas<Trigger>,
+                "collisions need a frame with Trigger components");
+
  public:
-  explicit Pipeline(LayerMatrix collision_matrix,
-                    IntegrationMethod integrator = kVelocityVerlet)
-      : collision_detector_(collision_matrix), integrator_(integrator) {}
+  static constexpr PipelineConfig kConfiguration = kConfig;
+
+  explicit BasicPipeline(LayerMatrix collision_matrix,
+                         IntegrationMethod integrator = kConfig.integrator)
+      : collision_detector_(collision_matrix), integrator_(integrator) {
+    assert(kConfig.runtime_integrator || integrator == kConfig.integrator);
+  }
 
-  explicit Pipeline(LayerMatrix collision_matrix,
-                    const CollisionRuleSet &rule_set,
-                    IntegrationMethod integrator = kVelocityVerlet)
+  explicit BasicPipeline(LayerMatrix collision_matrix,
+                         const CollisionRuleSet &rule_set,
+                         IntegrationMethod integrator = kConfig.integrator)
       : collision_detector_(collision_matrix),
         integrator_(integrator),
-        rule_set_(rule_set) {}
+        rule_set_(rule_set) {
+    assert(kConfig.runtime_integrator || integrator == kConfig.integrator);
+  }
+
+  // Advances the frame to frame_no, by one frame of length dt, or by frames
+  // frames at once (a coarse step, see Timeline::SetTimeLod). A coarse step
+  // ends on a multiple of frames.
+  void Step(float dt, int frame_no, FrameType &frame,
+            absl::Span<Event> input, std::vector<Event> &out_events,
+            int frames = 1);
+  void Replay(float dt, int frame_no, FrameType &frame,
+              absl::Span<Event> events, int frames = 1);
 
-  void Step(float dt, int frame_no, Frame &frame, absl::Span<Event> input,
-            std::vector<Event> &out_events);
-  void Replay(float dt, int frame_no, Frame &frame, absl::Span<Event> events);
+  // Re-sorts the order in which the broadphase visits objects, to match their
+  // current positions. This only affects performance. Step calls it when the
+  // frame changes size and every kSpatialOrderPeriod steps, and the Timeline
+  // on key frames.
+  void UpdateSpatialOrder(const FrameType &frame);
+  static constexpr int kSpatialOrderPeriod = 64;
 
   inline CollisionDetector &collision_detector() { return collision_detector_; }
 
+  // Step and Replay run stages that don't depend on each other in parallel on
+  // the pool. Without a pool (the default), they run on the calling thread.
+  // Either way, the results are the same. The pool can be shared between
+  // pipelines, but only one can use it at a time.
+  inline void set_thread_pool(std::shared_ptr<ThreadPool> thread_pool) {
+    thread_pool_ = std::move(thread_pool);
+  }
+
+  // Enables spatial LOD (see FidelityLod), or disables it with nullopt. Which
+  // objects get reduced fidelity only depends on the frame and lod, so Replay
+  // reproduces Step as long as lod stays the same.
+  inline void set_fidelity_lod(std::optional<FidelityLod> lod) {
+    static_assert(kConfig.spatial_lod);
+    assert(!lod.has_value() || lod->collision_interval > 0);
+    fidelity_lod_ = std::move(lod);
+  }
+
+  // Only updated while spatial LOD is on.
+  inline const FidelityStats &fidelity_stats() const {
+    return fidelity_stats_;
+  }
+
+  // Objects that the last Step or Replay moved in a straight line, because no
+  // force acted on them (see MotionBuffers::ballistic). Events, such as
+  // collisions, might still have changed their motion afterwards.
+  inline const std::vector<int32_t> &ballistic() const { return ballistic_; }
+
+  // Gravity from attractors with a cutoff distance is computed using neighbor
+  // lists (see NeighborLists). This sets their margin, as a fraction of the
+  // cutoff distance, or turns them off with zero. The results are the same
+  // either way.
+  inline void set_neighbor_skin(const float skin) { neighbors_.set_skin(skin); }
+  inline const NeighborLists &neighbor_lists() const { return neighbors_; }
+
+  // Only updated by Step, while it splits integration by island (see
+  // PipelineConfig::islands). Replay always integrates in one task.
+  inline const IslandStats &island_stats() const { return island_stats_; }
+
+  // Positions of orbiting objects are computed for this many frames ahead at a
+  // time and cached (see OrbitCache), or every frame with zero, the default.
+  // The cache keeps a few windows' worth of past frames, so replaying recent
+  // history doesn't recompute them either. That's 12 bytes per orbit per
+  // cached frame. The results are the same either way.
+  inline void set_orbit_lookahead(const int frames) {
+    assert(frames >= 0);
+    orbit_lookahead_ = frames;
+  }
+  inline const OrbitCache &orbit_cache() const { return orbit_cache_; }
+
+  // See KeplerSolver::set_basis_tolerance.
+  inline void set_orbit_basis_tolerance(const float degrees) {
+    kepler_solver_.set_basis_tolerance(degrees);
+    orbit_cache_.set_basis_tolerance(degrees);
+  }
+
  private:
+  // Integrates the motion of objects in one task, see AddIslandStages.
+  struct IslandTask {
+    BasicPipeline *pipeline;
+    uint8_t index;
+    MotionBuffers scratch;
+  };
+
+  void UpdateOrbits(float dt, int frame_no, int frames, FrameType &frame);
+  void Integrate(float dt, absl::Span<Event> input, FrameType &frame);
+  void DetectCollisions(float dt, int frame_no, const FrameType &frame,
+                        std::vector<Event> &out_events);
+  void IntegrateRegion(float dt, absl::Span<Event> input,
+                       const MotionRegion &region, MotionBuffers &scratch,
+                       FrameType &frame);
+  // Sorts objects into regions_.
+  void ClassifyRegions(const FrameType &frame);
+  bool SplitsIslands() const;
+  // Adds the stages that integrate each island task in parallel.
+  void AddIslandStages(pipeline_internal::StageContext<FrameType> &ctx);
+  void RunStages();
+
   IntegrationMethod integrator_;
   CollisionDetector collision_detector_;
   GlueSystem glue_system_;
   CollisionRuleSet rule_set_;
 
+  MotionBuffers motion_buffers_;
+  NeighborLists neighbors_;
+  std::vector<int32_t> ballistic_;
+  SpatialOrder spatial_order_;
+  // Steps since spatial_order_ was rebuilt.
+  int spatial_order_age_ = 0;
   std::vector<Event> event_buffer_;
+
+  TaskGraph stages_;
+  std::shared_ptr<ThreadPool> thread_pool_;
+
+  std::optional<FidelityLod> fidelity_lod_;
+  // Per object: a pipeline_internal::Region.
+  std::vector<uint8_t> regions_;
+  FidelityStats fidelity_stats_{};
+
+  Islands islands_;
+  // Per object: the index of the IslandTask that integrates it.
+  std::vector<uint8_t> island_task_index_;
+  std::vector<IslandTask> island_tasks_;
+  IslandStats island_stats_{};
+
+  KeplerSolver kepler_solver_;
+  int orbit_lookahead_ = 0;
+  OrbitCache orbit_cache_;
 };
 
+using Pipeline = BasicPipeline<kGenericPipeline>;
+
+// Instantiated once, in pipeline.cc.
+extern template class BasicPipeline<kGenericPipeline>;
+
+template <PipelineConfig kConfig, typename FrameType>
+void BasicPipeline<kConfig, FrameType>::Step(const float dt,
+                                             const int frame_no,
+                                             FrameType &frame,
+                                             absl::Span<Event> input,
+                                             std::vector<Event> &out_events,
+                                             const int frames) {
+  using namespace pipeline_internal;
+
+  // The frame pipeline is as follows:
+  //
+  // 0) Convert SpawnAttempt events to Spawns <- SKIPPED ON REPLAY
+  // 1) Compute closed-form orbital motion
+  // 2) Compute acceleration from rockets
+  // 3) Compute forces from acceleration input and gravity, from them velocities
+  // 4) Compute motion of glued objects
+  // 5) Detect collisions <- SKIPPED ON REPLAY
+  // 6) Convert collision events to their effects <- SKIPPED ON REPLAY
+  // 7) Apply computed velocities and update positions
+  // 8) Apply events, including effects of collisions
+  //
+  // Each stage declares what it reads and writes, and stages_ works out which
+  // ones can overlap. In practice, orbital motion runs alongside spawn and
+  // rocket conversion, and the broadphase order is rebuilt (when needed)
+  // alongside integration.
+
+  // Frames that weren't built with Frame::Push come without a flag index.
+  // Everything else keeps it up to date as it changes flags.
+  if (frame.flag_index.size() != frame.flags.size()) {
+    frame.flag_index.Rebuild(frame.flags);
+  }
+  assert(frame.flag_index.Matches(frame.flags));
+
+  assert(frames >= 1 && frame_no % frames == 0);
+  StageContext<FrameType> ctx{dt * frames, frame_no, frames,
+                              frame,       input,    &out_events};
+
+  if constexpr (kConfig.spawns) {
+    stages_.Add(kInput | kReusePools | kReuseTags,
+                kReusePools | kReuseTags | kOutEvents, [&ctx] {
+                  ConvertSpawnAttempts(ctx.input, *ctx.out_events, ctx.frame);
+                });
+  }
+  if constexpr (kConfig.orbits) {
+    stages_.Add(kTransforms | kOrbits, kMotion, [this, &ctx] {
+      UpdateOrbits(ctx.dt, ctx.frame_no, ctx.frames, ctx.frame);
+    });
+  }
+  if constexpr (kConfig.rockets) {
+    stages_.Add(kInput | kMass | kRockets, kInput | kMass | kRockets, [&ctx] {
+      auto status = ConvertRocketBurnToAcceleration(
+          ctx.dt, ctx.input, ctx.frame.mass, ctx.frame.rockets);
+      assert(status.ok());
+    });
+  }
+  if constexpr (kConfig.spatial_lod) {
+    if (fidelity_lod_.has_value()) {
+      stages_.Add(kTransforms | kFlags, kFidelity,
+                  [this, &ctx] { ClassifyRegions(ctx.frame); });
+    }
+  }
+  if constexpr (kConfig.collisions) {
+    if (spatial_order_.size() != frame.transforms.size() ||
+        ++spatial_order_age_ >= kSpatialOrderPeriod) {
+      stages_.Add(kTransforms | kFlags, kSpatialOrder,
+                  [this, &ctx] { UpdateSpatialOrder(ctx.frame); });
+    }
+  }
+  const bool split_islands = SplitsIslands();
+  if (split_islands) {
+    AddIslandStages(ctx);
+  } else {
+    stages_.Add(kInput | kTransforms | kMass | kMotion | kFlags | kFidelity,
+                kInput | kMotion | kMotionBuffers | kFidelity, [this, &ctx] {
+                  // The motion system wants input events sorted by ID.
+                  std::sort(ctx.input.begin(), ctx.input.end(), CompareIds);
+                  Integrate(ctx.dt, ctx.input, ctx.frame);
+                });
+  }
+
+  // TODO: apply glue motion
+
+  if constexpr (kConfig.collisions) {
+    collision_detector_.set_record_pairs(split_islands);
+    stages_.Add(kMotionBuffers | kColliders | kFlags | kGlue | kSpatialOrder |
+                    kFidelity,
+                kOutEvents | kFidelity, [this, &ctx] {
+                  DetectCollisions(ctx.dt, ctx.frame_no, ctx.frame,
+                                   *ctx.out_events);
+                });
+
+    // convert collision events to effects
+    stages_.Add(kTransforms | kMass | kMotion | kColliders | kTriggers |
+                    kOutEvents,
+                kOutEvents, [this, &ctx] {
+                  rule_set_.Apply(ctx.frame.transforms, ctx.frame.mass,
+                                  ctx.frame.motion, ctx.frame.colliders,
+                                  ctx.frame.triggers, *ctx.out_events);
+                });
+  }
+  if (split_islands) {
+    // Broadphase pairs join islands, too. They don't change how this frame was
+    // split (integration doesn't depend on them), but the stats should show
+    // which objects interact. The pairs come from the collision detector, which
+    // only the stage writing kOutEvents uses.
+    stages_.Add(kOutEvents | kFlags, kIslands, [this, &ctx] {
+      if constexpr (kConfig.collisions) {
+        for (const auto &[a, b] : collision_detector_.pairs()) {
+          islands_.Join(a, b);
+        }
+      }
+      islands_.Count(ctx.frame.flag_index, island_stats_);
+    });
+  }
+  stages_.Add(kMotion | kFlags, kTransforms, [&ctx] {
+    UpdatePositions(ctx.dt, ctx.frame.motion, ctx.frame.flag_index,
+                    ctx.frame.transforms);
+  });
+  stages_.Add(kEverything, kEverything, [&ctx] {
+    ApplyEventEffects(ctx.input, ctx.frame);
+    ApplyEventEffects(absl::MakeSpan(*ctx.out_events), ctx.frame);
+  });
+
+  RunStages();
+}
+
+template <PipelineConfig kConfig, typename FrameType>
+void BasicPipeline<kConfig, FrameType>::UpdateSpatialOrder(
+    const FrameType &frame) {
+  if constexpr (kConfig.collisions) {
+    spatial_order_.Rebuild(frame.transforms, frame.flag_index);
+    spatial_order_age_ = 0;
+  }
+}
+
+template <PipelineConfig kConfig, typename FrameType>
+void BasicPipeline<kConfig, FrameType>::Replay(const float dt,
+                                               const int frame_no,
+                                               FrameType &frame,
+                                               absl::Span<Event> events,
+                                               const int frames) {
+  using namespace pipeline_internal;
+
+  if (frame.flag_index.size() != frame.flags.size()) {
+    frame.flag_index.Rebuild(frame.flags);
+  }
+  assert(frame.flag_index.Matches(frame.flags));
+
+  assert(frames >= 1 && frame_no % frames == 0);
+  StageContext<FrameType> ctx{dt * frames, frame_no, frames,
+                              frame,       events,   nullptr};
+
+  if constexpr (kConfig.spatial_lod) {
+    if (fidelity_lod_.has_value()) {
+      stages_.Add(kTransforms | kFlags, kFidelity,
+                  [this, &ctx] { ClassifyRegions(ctx.frame); });
+    }
+  }
+  if constexpr (kConfig.orbits) {
+    stages_.Add(kTransforms | kOrbits, kMotion, [this, &ctx] {
+      UpdateOrbits(ctx.dt, ctx.frame_no, ctx.frames, ctx.frame);
+    });
+  }
+  if constexpr (kConfig.rockets) {
+    stages_.Add(kInput | kMass | kRockets, kInput | kMass | kRockets, [&ctx] {
+      auto status = ConvertRocketBurnToAcceleration(
+          ctx.dt, ctx.input, ctx.frame.mass, ctx.frame.rockets);
+      assert(status.ok());
+    });
+  }
+  stages_.Add(kInput | kTransforms | kMass | kMotion | kFlags | kFidelity,
+              kMotion | kMotionBuffers | kFidelity, [this, &ctx] {
+                event_buffer_.clear();
+                for (const auto &event : ctx.input) {
+                  if (event.type == Event::kAcceleration) {
+                    event_buffer_.push_back(event);
+                  }
+                }
+                std::sort(event_buffer_.begin(), event_buffer_.end(),
+                          CompareIds);
+                Integrate(ctx.dt, absl::MakeSpan(event_buffer_), ctx.frame);
+              });
+  stages_.Add(kMotion | kFlags, kTransforms, [&ctx] {
+    UpdatePositions(ctx.dt, ctx.frame.motion, ctx.frame.flag_index,
+                    ctx.frame.transforms);
+  });
+  stages_.Add(kEverything, kEverything,
+              [&ctx] { ApplyEventEffects(ctx.input, ctx.frame); });
+
+  RunStages();
+}
+
+template <PipelineConfig kConfig, typename FrameType>
+void BasicPipeline<kConfig, FrameType>::UpdateOrbits(const float dt,
+                                                     const int frame_no,
+                                                     const int frames,
+                                                     FrameType &frame) {
+  // Orbits are computed at dt × step_no, counting steps of the same length as
+  // this one, so coarse steps get the cache to themselves.
+  const int step_no = frame_no / frames;
+  if (orbit_lookahead_ == 0) {
+    UpdateOrbitalMotion(kepler_solver_, dt * step_no, frame.transforms,
+                        frame.orbits, frame.motion);
+    return;
+  }
+
+  // Past the end of the window, or a different timestep (coarse replay) or
+  // different orbits: start over.
+  if (!orbit_cache_.Matches(dt, frame.orbits) ||
+      step_no < orbit_cache_.first_frame_no() ||
+      step_no > orbit_cache_.end_frame_no()) {
+    orbit_cache_.Fill(dt, step_no, orbit_lookahead_, frame.orbits);
+  } else if (step_no == orbit_cache_.end_frame_no()) {
+    orbit_cache_.Extend(orbit_lookahead_,
+                        pipeline_internal::kOrbitCacheWindows *
+                            orbit_lookahead_);
+  }
+  UpdateOrbitalMotion(orbit_cache_, step_no, frame.transforms, frame.orbits,
+                      frame.motion);
+}
+
+template <PipelineConfig kConfig, typename FrameType>
+void BasicPipeline<kConfig, FrameType>::Integrate(const float dt,
+                                                  absl::Span<Event> input,
+                                                  FrameType &frame) {
+  using namespace pipeline_internal;
+
+  motion_buffers_.kinematics.Load(frame.transforms, frame.motion);
+  neighbors_.Update(motion_buffers_.kinematics.position, frame.mass,
+                    frame.flag_index);
+  ballistic_.clear();
+  if constexpr (kConfig.spatial_lod) {
+    if (fidelity_lod_.has_value()) {
+      // The regions don't interact here: each only writes the motion of its
+      // own objects, and attractors are read from the kinematics' positions,
+      // which integration doesn't change.
+      auto start = std::chrono::steady_clock::now();
+      IntegrateRegion(dt, input,
+                      MotionRegion{.regions = &regions_,
+                                   .region = kFullFidelity,
+                                   .neighbors = &neighbors_},
+                      motion_buffers_, frame);
+      fidelity_stats_.full_nanos = NanosSince(start);
+      ballistic_.insert(ballistic_.end(), motion_buffers_.ballistic.begin(),
+                        motion_buffers_.ballistic.end());
+
+      start = std::chrono::steady_clock::now();
+      IntegrateRegion(dt, input,
+                      MotionRegion{&regions_, kReducedFidelity,
+                                   fidelity_lod_->attractors},
+                      motion_buffers_, frame);
+      fidelity_stats_.reduced_nanos = NanosSince(start);
+      ballistic_.insert(ballistic_.end(), motion_buffers_.ballistic.begin(),
+                        motion_buffers_.ballistic.end());
+      return;
+    }
+  }
+  IntegrateRegion(dt, input, MotionRegion{.neighbors = &neighbors_},
+                  motion_buffers_, frame);
+  ballistic_.insert(ballistic_.end(), motion_buffers_.ballistic.begin(),
+                    motion_buffers_.ballistic.end());
+}
+
+template <PipelineConfig kConfig, typename FrameType>
+void BasicPipeline<kConfig, FrameType>::IntegrateRegion(
+    const float dt, absl::Span<Event> input, const MotionRegion &region,
+    MotionBuffers &scratch, FrameType &frame) {
+  Kinematics &kinematics = motion_buffers_.kinematics;
+  if constexpr (kConfig.runtime_integrator) {
+    IntegrateMotion(integrator_, dt, input, frame.mass, frame.flag_index,
+                    region, kinematics, scratch, frame.motion);
+  } else if constexpr (kConfig.integrator == kFirstOrderEuler) {
+    IntegrateFirstOrderEuler(dt, input, frame.mass, frame.flag_index, region,
+                             kinematics, scratch, frame.motion);
+  } else if constexpr (kConfig.integrator == kVelocityVerlet) {
+    IntegrateVelocityVerlet(dt, input, frame.mass, frame.flag_index, region,
+                            kinematics, scratch, frame.motion);
+  } else {
+    static_assert(kConfig.integrator == kFourthOrderYoshida);
+    IntegrateFourthOrderYoshida(dt, input, frame.mass, frame.flag_index,
+                                region, kinematics, scratch, frame.motion);
+  }
+}
+
+template <PipelineConfig kConfig, typename FrameType>
+bool BasicPipeline<kConfig, FrameType>::SplitsIslands() const {
+  if constexpr (!kConfig.islands) return false;
+  // Islands are found from where objects start the step. Yoshida evaluates
+  // gravity at positions they only reach later, so it integrates in one task.
+  if (integrator_ == kFourthOrderYoshida) return false;
+  return thread_pool_ != nullptr && !fidelity_lod_.has_value();
+}
+
+template <PipelineConfig kConfig, typename FrameType>
+void BasicPipeline<kConfig, FrameType>::AddIslandStages(
+    pipeline_internal::StageContext<FrameType> &ctx) {
+  using namespace pipeline_internal;
+
+  // One task per thread, counting the one calling Step.
+  const size_t task_count = std::min(thread_pool_->threads() + 1, 256);
+  if (island_tasks_.size() != task_count) {
+    island_tasks_.resize(task_count);
+    for (size_t i = 0; i < task_count; ++i) {
+      island_tasks_[i].pipeline = this;
+      island_tasks_[i].index = i;
+    }
+  }
+
+  stages_.Add(kInput | kTransforms | kMass | kMotion | kFlags,
+              kInput | kMotionBuffers | kIslands, [this, &ctx] {
+                std::sort(ctx.input.begin(), ctx.input.end(), CompareIds);
+                const auto start = std::chrono::steady_clock::now();
+                const FrameType &frame = ctx.frame;
+                Kinematics &kinematics = motion_buffers_.kinematics;
+                kinematics.Load(frame.transforms, frame.motion);
+                neighbors_.Update(kinematics.position, frame.mass,
+                                  frame.flag_index);
+                islands_.Rebuild(kinematics.position, neighbors_.attractors(),
+                                 frame.flag_index, &neighbors_);
+                islands_.Split(frame.flag_index, island_tasks_.size(),
+                               island_task_index_, island_stats_);
+                island_stats_.nanos = NanosSince(start);
+              });
+
+  // Each task writes the motion and kinematics of its own objects, so the tasks
+  // partition those resources. (The capture fits in std::function without
+  // allocating, unlike [this, &ctx, &task].)
+  for (IslandTask &task : island_tasks_) {
+    stages_.Add(
+        kInput | kMass | kFlags | kIslands, kMotion | kMotionBuffers,
+        [&task, &ctx] {
+          BasicPipeline &pipeline = *task.pipeline;
+          pipeline.IntegrateRegion(
+              ctx.dt, ctx.input,
+              MotionRegion{.regions = &pipeline.island_task_index_,
+                           .region = task.index,
+                           .local_attractors = true,
+                           .neighbors = &pipeline.neighbors_},
+              task.scratch, ctx.frame);
+        },
+        kMotion | kMotionBuffers);
+  }
+
+  // In ascending order, as if one task had integrated everything.
+  stages_.Add(kIslands, kMotionBuffers, [this] {
+    ballistic_.clear();
+    for (const IslandTask &task : island_tasks_) {
+      ballistic_.insert(ballistic_.end(), task.scratch.ballistic.begin(),
+                        task.scratch.ballistic.end());
+    }
+    std::sort(ballistic_.begin(), ballistic_.end());
+  });
+}
+
+template <PipelineConfig kConfig, typename FrameType>
+void BasicPipeline<kConfig, FrameType>::DetectCollisions(
+    const float dt, const int frame_no, const FrameType &frame,
+    std::vector<Event> &out_events) {
+  using namespace pipeline_internal;
+
+  const std::vector<uint8_t> *reduced = nullptr;
+  if constexpr (kConfig.spatial_lod) {
+    if (fidelity_lod_.has_value()) {
+      const bool all = frame_no % fidelity_lod_->collision_interval == 0;
+      if (!all) reduced = &regions_;
+      const auto start = std::chrono::steady_clock::now();
+      collision_detector_.DetectCollisions(
+          motion_buffers_.kinematics, frame.colliders, frame.flag_index,
+          spatial_order_, frame.glue, reduced, dt, out_events);
+      fidelity_stats_.collision_nanos = NanosSince(start);
+      fidelity_stats_.reduced_collisions = all;
+      return;
+    }
+  }
+  collision_detector_.DetectCollisions(motion_buffers_.kinematics,
+                                       frame.colliders, frame.flag_index,
+                                       spatial_order_, frame.glue, reduced, dt,
+                                       out_events);
+}
+
+template <PipelineConfig kConfig, typename FrameType>
+void BasicPipeline<kConfig, FrameType>::ClassifyRegions(
+    const FrameType &frame) {
+  using namespace pipeline_internal;
+
+  const FidelityLod &lod = *fidelity_lod_;
+  const float radius_sqr = lod.radius * lod.radius;
+  const size_t count = frame.transforms.size();
+  regions_.resize(count);
+  fidelity_stats_.full_objects = 0;
+  fidelity_stats_.reduced_objects = 0;
+  frame.flag_index.ForEach(0, Flags::kDestroyed, [&](const size_t i) {
+    const Vector3 position = frame.transforms[i].position;
+    bool near = false;
+    for (const Vector3 point : lod.points) {
+      if (Vector3::SqrMagnitude(point - position) <= radius_sqr) {
+        near = true;
+        break;
+      }
+    }
+    for (const Entity entity : lod.entities) {
+      if (near) break;
+      if (entity.value() < 0 || static_cast<size_t>(entity.value()) >= count ||
+          frame.flag_index.Test(entity, Flags::kDestroyed)) {
+        continue;
+      }
+      const Vector3 point = entity.Get(frame.transforms).position;
+      near = Vector3::SqrMagnitude(point - position) <= radius_sqr;
+    }
+    if (near) {
+      regions_[i] = kFullFidelity;
+      ++fidelity_stats_.full_objects;
+    } else {
+      regions_[i] = kReducedFidelity;
+      ++fidelity_stats_.reduced_objects;
+    }
+  });
+}
+
+template <PipelineConfig kConfig, typename FrameType>
+void BasicPipeline<kConfig, FrameType>::RunStages() {
+  if (thread_pool_ == nullptr) {
+    stages_.RunSerial();
+  } else {
+    stages_.Run(*thread_pool_);
+  }
+  // Don't hold on to references into the caller's frame.
+  stages_.Clear();
+}
+
 }  // namespace vstr
 
-#endif
\ No newline at end of file
+#endif
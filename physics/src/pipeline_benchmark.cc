@@ -7,6 +7,319 @@
 
 #include <benchmark/benchmark.h>
 
+#include <memory>
+#include <random>
+
 #include "pipeline.h"
 
+namespace vstr {
+namespace {
+
+constexpr float kDeltaTime = 1.0f / 60;
+constexpr int kAttractors = 8;
+
+// Builds a scene of small objects scattered through a large volume, moving
+// around a handful of attractors.
+Frame Generate(const int size, const bool reserve,
+               std::mt19937 &random_generator) {
+  std::uniform_real_distribution<float> position_rg(-1e6, 1e6);
+  std::uniform_real_distribution<float> velocity_rg(-100, 100);
+
+  Frame frame;
+  if (reserve) frame.Reserve(size);
+  for (int i = 0; i < size; ++i) {
+    const Vector3 position{position_rg(random_generator),
+                           position_rg(random_generator),
+                           position_rg(random_generator)};
+    const Vector3 velocity{velocity_rg(random_generator),
+                           velocity_rg(random_generator),
+                           velocity_rg(random_generator)};
+    frame.Push(Transform{.position = position},
+               Mass{.inertial = 1, .active = i < kAttractors ? 1e9f : 0},
+               Motion::FromPositionAndVelocity(position, velocity),
+               Collider{.layer = 1, .radius = 1}, Glue{}, Flags{});
+  }
+  return frame;
+}
+
+void BM_FramePush(benchmark::State &state) {
+  const int size = state.range(0);
+  const bool reserve = state.range(1);
+  std::mt19937 random_generator;
+
+  for (auto _ : state) {
+    Frame frame = Generate(size, reserve, random_generator);
+    benchmark::DoNotOptimize(frame.transforms.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * size);
+  state.SetComplexityN(size);
+}
+BENCHMARK(BM_FramePush)
+    ->ArgsProduct({
+        // size
+        benchmark::CreateRange(10000, 1000000, /*multi=*/10),
+        // reserve
+        {0, 1},
+    })
+    ->Unit(benchmark::kMillisecond);
+
+// Every other object gets an orbit. Scenes built by hand (e.g. in the order
+// the designer placed objects) don't add components in ID order, so this
+// inserts them back to front - the worst case for SetOptionalComponent.
+void BM_FrameBuildIncremental(benchmark::State &state) {
+  const int size = state.range(0);
+  std::mt19937 random_generator;
+
+  for (auto _ : state) {
+    Frame frame = Generate(size, true, random_generator);
+    for (int i = size - 1; i >= 0; i -= 2) {
+      SetOptionalComponent(Entity(i), Orbit{.id = Entity(i)}, frame.orbits);
+    }
+    benchmark::DoNotOptimize(frame.orbits.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * size);
+  state.SetComplexityN(size);
+}
+BENCHMARK(BM_FrameBuildIncremental)
+    ->RangeMultiplier(10)
+    ->Range(1000, 100000)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+
+// Same scene as BM_FrameBuildIncremental, built with Frame::Import.
+void BM_FrameImport(benchmark::State &state) {
+  const int size = state.range(0);
+  std::mt19937 random_generator;
+
+  for (auto _ : state) {
+    Frame scratch = Generate(size, true, random_generator);
+    FrameColumns columns{
+        .transforms = std::move(scratch.transforms),
+        .mass = std::move(scratch.mass),
+        .motion = std::move(scratch.motion),
+        .colliders = std::move(scratch.colliders),
+        .glue = std::move(scratch.glue),
+        .flags = std::move(scratch.flags),
+    };
+    columns.orbits.reserve(size / 2);
+    for (int i = size - 1; i >= 0; i -= 2) {
+      columns.orbits.push_back(Orbit{.id = Entity(i)});
+    }
+
+    Frame frame;
+    benchmark::DoNotOptimize(frame.Import(std::move(columns)));
+    benchmark::DoNotOptimize(frame.orbits.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * size);
+  state.SetComplexityN(size);
+}
+BENCHMARK(BM_FrameImport)
+    ->RangeMultiplier(10)
+    ->Range(1000, 1000000)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+
+// The scene from Generate has no orbits, rockets or pools, so none of those
+// stages do any work. The generic pipeline still schedules them and dispatches
+// on the integrator every frame.
+constexpr PipelineConfig kBallisticPipeline{
+    .spawns = false,
+    .orbits = false,
+    .rockets = false,
+    .runtime_integrator = false,
+    .integrator = kVelocityVerlet,
+};
+
+template <PipelineConfig kConfig>
+void BM_PipelineStep(benchmark::State &state) {
+  const int size = state.range(0);
+  std::mt19937 random_generator;
+  Frame frame = Generate(size, true, random_generator);
+
+  BasicPipeline<kConfig> pipeline(LayerMatrix(
+      std::vector<std::pair<uint32_t, uint32_t>>{std::make_pair(1, 1)}));
+  std::vector<Event> out_events;
+  int frame_no = 0;
+  for (auto _ : state) {
+    pipeline.Step(kDeltaTime, ++frame_no, frame, {}, out_events);
+    out_events.clear();
+  }
+
+  state.SetItemsProcessed(state.iterations() * size);
+  state.SetComplexityN(size);
+}
+BENCHMARK_TEMPLATE(BM_PipelineStep, kGenericPipeline)
+    ->RangeMultiplier(10)
+    ->Range(10000, 1000000)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+BENCHMARK_TEMPLATE(BM_PipelineStep, kBallisticPipeline)
+    ->RangeMultiplier(10)
+    ->Range(10000, 1000000)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+
+// Only objects within radius of the first attractor get full fidelity. The
+// counters break the time per frame down by region.
+void BM_PipelineStepFidelityLod(benchmark::State &state) {
+  const int size = state.range(0);
+  const float radius = state.range(1);
+  std::mt19937 random_generator;
+  Frame frame = Generate(size, true, random_generator);
+
+  Pipeline pipeline(LayerMatrix(
+      std::vector<std::pair<uint32_t, uint32_t>>{std::make_pair(1, 1)}));
+  pipeline.set_fidelity_lod(FidelityLod{
+      .entities = {Entity(0)},
+      .radius = radius,
+      .attractors = 1,
+      .collision_interval = 8,
+  });
+  std::vector<Event> out_events;
+  int frame_no = 0;
+  double full_nanos = 0;
+  double reduced_nanos = 0;
+  double collision_nanos = 0;
+  for (auto _ : state) {
+    pipeline.Step(kDeltaTime, ++frame_no, frame, {}, out_events);
+    out_events.clear();
+    const FidelityStats &stats = pipeline.fidelity_stats();
+    full_nanos += stats.full_nanos;
+    reduced_nanos += stats.reduced_nanos;
+    collision_nanos += stats.collision_nanos;
+  }
+
+  const FidelityStats &stats = pipeline.fidelity_stats();
+  state.counters["full_objects"] = stats.full_objects;
+  state.counters["reduced_objects"] = stats.reduced_objects;
+  state.counters["full_ns"] = full_nanos / state.iterations();
+  state.counters["reduced_ns"] = reduced_nanos / state.iterations();
+  state.counters["collision_ns"] = collision_nanos / state.iterations();
+  state.SetItemsProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_PipelineStepFidelityLod)
+    ->ArgsProduct({
+        // size
+        {10000, 100000},
+        // radius
+        {100000, 1000000},
+    })
+    ->Unit(benchmark::kMillisecond);
+
+// Fleets of a thousand ships, each around its own planet. The planets' gravity
+// has a cutoff, so the fleets don't interact.
+Frame GenerateFleets(const int size, std::mt19937 &random_generator) {
+  std::uniform_real_distribution<float> planet_rg(-1e6, 1e6);
+  std::uniform_real_distribution<float> offset_rg(-5e3, 5e3);
+  std::uniform_real_distribution<float> velocity_rg(-10, 10);
+
+  Frame frame;
+  frame.Reserve(size);
+  Vector3 planet;
+  for (int i = 0; i < size; ++i) {
+    if (i % 1000 == 0) {
+      planet = Vector3{planet_rg(random_generator),
+                       planet_rg(random_generator),
+                       planet_rg(random_generator)};
+      frame.Push(Transform{.position = planet},
+                 Mass{.inertial = 1e9, .active = 1e9, .cutoff_distance = 2e4},
+                 Motion{}, Collider{.layer = 1, .radius = 100}, Glue{},
+                 Flags{});
+      continue;
+    }
+    const Vector3 position =
+        planet + Vector3{offset_rg(random_generator),
+                         offset_rg(random_generator),
+                         offset_rg(random_generator)};
+    const Vector3 velocity{velocity_rg(random_generator),
+                           velocity_rg(random_generator),
+                           velocity_rg(random_generator)};
+    frame.Push(Transform{.position = position}, Mass{.inertial = 1},
+               Motion::FromPositionAndVelocity(position, velocity),
+               Collider{.layer = 1, .radius = 1}, Glue{}, Flags{});
+  }
+  return frame;
+}
+
+// With threads, integration is split between tasks by island. Without, one
+// task integrates everything. The counters describe the islands.
+void BM_PipelineStepIslands(benchmark::State &state) {
+  const int size = state.range(0);
+  const int threads = state.range(1);
+  std::mt19937 random_generator;
+  Frame frame = GenerateFleets(size, random_generator);
+
+  Pipeline pipeline(LayerMatrix(
+      std::vector<std::pair<uint32_t, uint32_t>>{std::make_pair(1, 1)}));
+  if (threads > 0) {
+    pipeline.set_thread_pool(std::make_shared<ThreadPool>(threads));
+  }
+  std::vector<Event> out_events;
+  int frame_no = 0;
+  double island_nanos = 0;
+  for (auto _ : state) {
+    pipeline.Step(kDeltaTime, ++frame_no, frame, {}, out_events);
+    out_events.clear();
+    island_nanos += pipeline.island_stats().nanos;
+  }
+
+  const IslandStats &stats = pipeline.island_stats();
+  state.counters["islands"] = stats.islands;
+  state.counters["largest"] = stats.largest;
+  state.counters["tasks"] = stats.tasks;
+  state.counters["largest_task"] = stats.largest_task;
+  state.counters["islands_ns"] = island_nanos / state.iterations();
+  state.SetItemsProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_PipelineStepIslands)
+    ->ArgsProduct({
+        // size
+        {10000, 100000},
+        // threads
+        {0, 3},
+    })
+    ->Unit(benchmark::kMillisecond);
+
+// Replays the same stretch of history over and over, as the Timeline does when
+// it's asked about recent frames, in a scene where every other object orbits.
+void BM_PipelineReplayOrbits(benchmark::State &state) {
+  const int size = state.range(0);
+  std::mt19937 random_generator;
+  Frame frame = Generate(size, true, random_generator);
+  for (int i = 0; i < size; i += 2) {
+    Orbit &orbit = frame.orbits.GetOrInit(Entity(i));
+    orbit.epoch.semi_major_axis = 1e3 + i;
+    orbit.epoch.eccentricity = 0.2;
+    orbit.delta.mean_longitude_deg = 0.1;
+    frame.flags[i].value |= Flags::kOrbiting;
+  }
+  frame.flag_index.Rebuild(frame.flags);
+
+  Pipeline pipeline(LayerMatrix(
+      std::vector<std::pair<uint32_t, uint32_t>>{std::make_pair(1, 1)}));
+  pipeline.set_orbit_lookahead(state.range(1));
+  pipeline.Replay(kDeltaTime, 0, frame, {});
+  int frame_no = 1;
+  for (auto _ : state) {
+    pipeline.Replay(kDeltaTime, frame_no, frame, {});
+    frame_no = (frame_no + 1) % 64;
+  }
+
+  state.SetItemsProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_PipelineReplayOrbits)
+    ->ArgsProduct({
+        // size
+        {10000, 100000},
+        // lookahead
+        {0, 64},
+    })
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace vstr
+
 BENCHMARK_MAIN();
@@ -10,6 +10,12 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <cstring>
+#include <memory>
+#include <random>
+
+#include "allocation_counter.h"
+
 namespace vstr {
 namespace {
 
@@ -63,5 +69,427 @@ TEST(PipelineTest, FallingSphere) {
   EXPECT_NE(buffer[0].collision.first_frame_offset_seconds, 0);
 }
 
+// A crowded scene with gravity, collisions and a few orbiting objects.
+Frame GenerateCluster(const int size, const bool orbits = true) {
+  std::mt19937 random_generator(1);
+  std::uniform_real_distribution<float> position_rg(-50, 50);
+  std::uniform_real_distribution<float> velocity_rg(-5, 5);
+
+  Frame frame;
+  for (int i = 0; i < size; ++i) {
+    const Vector3 position{position_rg(random_generator),
+                           position_rg(random_generator),
+                           position_rg(random_generator)};
+    const Vector3 velocity{velocity_rg(random_generator),
+                           velocity_rg(random_generator),
+                           velocity_rg(random_generator)};
+    const Entity id = frame.Push(
+        Transform{.position = position},
+        Mass{.inertial = 1, .active = i < 4 ? 1e6f : 0},
+        Motion::FromPositionAndVelocity(position, velocity),
+        Collider{.layer = 1, .radius = 1}, Glue{}, Flags{});
+    if (orbits && i % 16 == 0) {
+      Orbit &orbit = frame.orbits.GetOrInit(id);
+      orbit.epoch.semi_major_axis = 20 + i;
+      orbit.epoch.eccentricity = 0.1;
+      orbit.delta.mean_longitude_deg = 1;
+    }
+  }
+  return frame;
+}
+
+template <typename T>
+bool BitwiseEqual(const std::vector<T> &a, const std::vector<T> &b) {
+  return a.size() == b.size() &&
+         std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+}
+
+TEST(PipelineTest, FlagsWrittenInPlace) {
+  Pipeline pipeline(LayerMatrix({{1, 1}}));
+  const float dt = 0.1;
+  Frame frame;
+  const Entity id = frame.Push();
+  id.Get(frame.motion).velocity = Vector3{1, 0, 0};
+
+  std::vector<Event> buffer;
+  pipeline.Step(dt, 0, frame, {}, buffer);
+  const Vector3 position = id.Get(frame.transforms).position;
+  EXPECT_GT(position.x, 0);
+
+  // Written directly, like through FrameView, then synced.
+  id.Get(frame.flags).value |= Flags::kDestroyed;
+  frame.flag_index.Sync(frame.flags);
+  pipeline.Step(dt, 1, frame, {}, buffer);
+  EXPECT_EQ(id.Get(frame.transforms).position, position);
+  pipeline.Replay(dt, 2, frame, {});
+  EXPECT_EQ(id.Get(frame.transforms).position, position);
+
+  id.Get(frame.flags).value &= ~Flags::kDestroyed;
+  frame.flag_index.Set(id, id.Get(frame.flags));
+  pipeline.Replay(dt, 3, frame, {});
+  EXPECT_GT(id.Get(frame.transforms).position.x, position.x);
+}
+
+TEST(PipelineTest, ParallelMatchesSerial) {
+  const float dt = 1.0f / 60;
+  Pipeline serial(LayerMatrix({{1, 1}}));
+  Pipeline parallel(LayerMatrix({{1, 1}}));
+  parallel.set_thread_pool(std::make_shared<ThreadPool>(3));
+
+  Frame serial_frame = GenerateCluster(256);
+  Frame parallel_frame = serial_frame;
+  std::vector<Event> serial_events;
+  std::vector<Event> parallel_events;
+  int event_count = 0;
+  for (int frame_no = 0; frame_no < 300; ++frame_no) {
+    serial_events.clear();
+    parallel_events.clear();
+    serial.Step(dt, frame_no, serial_frame, {}, serial_events);
+    parallel.Step(dt, frame_no, parallel_frame, {}, parallel_events);
+
+    ASSERT_TRUE(serial_events == parallel_events) << frame_no;
+    event_count += serial_events.size();
+    ASSERT_TRUE(
+        BitwiseEqual(serial_frame.transforms, parallel_frame.transforms))
+        << frame_no;
+    ASSERT_TRUE(BitwiseEqual(serial_frame.motion, parallel_frame.motion))
+        << frame_no;
+    ASSERT_TRUE(BitwiseEqual(serial_frame.mass, parallel_frame.mass))
+        << frame_no;
+    ASSERT_TRUE(BitwiseEqual(serial_frame.flags, parallel_frame.flags))
+        << frame_no;
+  }
+
+  // Make sure the scene exercised collision handling.
+  EXPECT_GT(event_count, 0);
+
+  for (int frame_no = 300; frame_no < 310; ++frame_no) {
+    serial.Replay(dt, frame_no, serial_frame, {});
+    parallel.Replay(dt, frame_no, parallel_frame, {});
+  }
+  EXPECT_TRUE(BitwiseEqual(serial_frame.transforms, parallel_frame.transforms));
+  EXPECT_TRUE(BitwiseEqual(serial_frame.motion, parallel_frame.motion));
+}
+
+TEST(PipelineTest, OrbitCacheMatchesDirect) {
+  const float dt = 1.0f / 60;
+  Pipeline direct(LayerMatrix({{1, 1}}));
+  Pipeline cached(LayerMatrix({{1, 1}}));
+  cached.set_orbit_lookahead(16);
+
+  Frame direct_frame = GenerateCluster(256);
+  Frame cached_frame = direct_frame;
+  std::vector<Event> direct_events;
+  std::vector<Event> cached_events;
+  for (int frame_no = 0; frame_no < 100; ++frame_no) {
+    direct_events.clear();
+    cached_events.clear();
+    direct.Step(dt, frame_no, direct_frame, {}, direct_events);
+    cached.Step(dt, frame_no, cached_frame, {}, cached_events);
+    ASSERT_TRUE(direct_events == cached_events) << frame_no;
+    ASSERT_TRUE(BitwiseEqual(direct_frame.motion, cached_frame.motion))
+        << frame_no;
+  }
+  EXPECT_EQ(cached.orbit_cache().end_frame_no(), 112);
+
+  // Replaying recent history reads the cache, and a coarser timestep doesn't.
+  for (int frame_no = 80; frame_no < 90; ++frame_no) {
+    direct.Replay(dt, frame_no, direct_frame, {});
+    cached.Replay(dt, frame_no, cached_frame, {});
+    ASSERT_TRUE(BitwiseEqual(direct_frame.motion, cached_frame.motion))
+        << frame_no;
+  }
+  EXPECT_EQ(cached.orbit_cache().end_frame_no(), 112);
+  for (int frame_no = 45; frame_no < 50; ++frame_no) {
+    direct.Replay(dt * 2, frame_no, direct_frame, {});
+    cached.Replay(dt * 2, frame_no, cached_frame, {});
+    ASSERT_TRUE(BitwiseEqual(direct_frame.motion, cached_frame.motion))
+        << frame_no;
+  }
+}
+
+// Attractors with a short reach, spread out enough that the scene breaks up
+// into many interaction islands.
+Frame GenerateSystems(const int size) {
+  std::mt19937 random_generator(2);
+  std::uniform_real_distribution<float> position_rg(-500, 500);
+  std::uniform_real_distribution<float> velocity_rg(-5, 5);
+
+  Frame frame;
+  for (int i = 0; i < size; ++i) {
+    const Vector3 position{position_rg(random_generator),
+                           position_rg(random_generator),
+                           position_rg(random_generator)};
+    const Vector3 velocity{velocity_rg(random_generator),
+                           velocity_rg(random_generator),
+                           velocity_rg(random_generator)};
+    frame.Push(Transform{.position = position},
+               Mass{.inertial = 1,
+                    .active = i % 8 == 0 ? 1e4f : 0,
+                    .cutoff_distance = 30},
+               Motion::FromPositionAndVelocity(position, velocity),
+               Collider{.layer = 1, .radius = 3}, Glue{}, Flags{});
+  }
+  return frame;
+}
+
+TEST(PipelineTest, IslandsMatchSerial) {
+  const float dt = 1.0f / 60;
+  Pipeline serial(LayerMatrix({{1, 1}}));
+  Pipeline parallel(LayerMatrix({{1, 1}}));
+  parallel.set_thread_pool(std::make_shared<ThreadPool>(3));
+
+  Frame serial_frame = GenerateSystems(512);
+  Frame parallel_frame = serial_frame;
+  std::vector<Event> serial_events;
+  std::vector<Event> parallel_events;
+  for (int frame_no = 0; frame_no < 100; ++frame_no) {
+    serial_events.clear();
+    parallel_events.clear();
+    serial.Step(dt, frame_no, serial_frame, {}, serial_events);
+    parallel.Step(dt, frame_no, parallel_frame, {}, parallel_events);
+
+    ASSERT_TRUE(serial_events == parallel_events) << frame_no;
+    ASSERT_TRUE(
+        BitwiseEqual(serial_frame.transforms, parallel_frame.transforms))
+        << frame_no;
+    ASSERT_TRUE(BitwiseEqual(serial_frame.motion, parallel_frame.motion))
+        << frame_no;
+    ASSERT_EQ(serial.ballistic(), parallel.ballistic()) << frame_no;
+  }
+
+  const IslandStats &stats = parallel.island_stats();
+  EXPECT_EQ(stats.tasks, 4);
+  EXPECT_GT(stats.islands, stats.tasks);
+  EXPECT_GT(stats.singletons, 0);
+  EXPECT_GT(stats.largest, 1);
+  EXPECT_LT(stats.largest_task, 512);
+}
+
+TEST(PipelineTest, SpecializedMatchesGeneric) {
+  constexpr PipelineConfig kConfig{
+      .spawns = false,
+      .orbits = false,
+      .rockets = false,
+      .runtime_integrator = false,
+      .integrator = kFirstOrderEuler,
+  };
+  const float dt = 1.0f / 60;
+  Pipeline generic(LayerMatrix({{1, 1}}), kFirstOrderEuler);
+  BasicPipeline<kConfig> specialized(LayerMatrix({{1, 1}}));
+
+  Frame generic_frame = GenerateCluster(256, /*orbits=*/false);
+  Frame specialized_frame = generic_frame;
+  std::vector<Event> generic_events;
+  std::vector<Event> specialized_events;
+  for (int frame_no = 0; frame_no < 100; ++frame_no) {
+    generic_events.clear();
+    specialized_events.clear();
+    generic.Step(dt, frame_no, generic_frame, {}, generic_events);
+    specialized.Step(dt, frame_no, specialized_frame, {}, specialized_events);
+
+    ASSERT_TRUE(generic_events == specialized_events) << frame_no;
+    ASSERT_TRUE(
+        BitwiseEqual(generic_frame.transforms, specialized_frame.transforms))
+        << frame_no;
+    ASSERT_TRUE(BitwiseEqual(generic_frame.motion, specialized_frame.motion))
+        << frame_no;
+  }
+}
+
+TEST(PipelineTest, SlimFrameMatchesFrame) {
+  constexpr PipelineConfig kConfig{.spawns = false, .rockets = false};
+  using SlimFrame = BasicFrame<Orbit, Trigger>;
+  const float dt = 1.0f / 60;
+  BasicPipeline<kConfig> full(LayerMatrix({{1, 1}}));
+  BasicPipeline<kConfig, SlimFrame> slim(LayerMatrix({{1, 1}}));
+
+  Frame full_frame = GenerateCluster(256);
+  SlimFrame slim_frame;
+  static_cast<RequiredStorage &>(slim_frame) = full_frame;
+  slim_frame.orbits = full_frame.orbits;
+  ASSERT_GT(slim_frame.orbits.size(), 0);
+  std::vector<Event> full_events;
+  std::vector<Event> slim_events;
+  for (int frame_no = 0; frame_no < 100; ++frame_no) {
+    full_events.clear();
+    slim_events.clear();
+    full.Step(dt, frame_no, full_frame, {}, full_events);
+    slim.Step(dt, frame_no, slim_frame, {}, slim_events);
+
+    ASSERT_TRUE(full_events == slim_events) << frame_no;
+    ASSERT_TRUE(BitwiseEqual(full_frame.transforms, slim_frame.transforms))
+        << frame_no;
+    ASSERT_TRUE(BitwiseEqual(full_frame.motion, slim_frame.motion))
+        << frame_no;
+    ASSERT_TRUE(BitwiseEqual(full_frame.flags, slim_frame.flags)) << frame_no;
+  }
+}
+
+TEST(PipelineTest, FidelityLod) {
+  const float dt = 1.0f / 60;
+  const FidelityLod lod{
+      .entities = {Entity(0)},
+      .radius = 30,
+      .attractors = 1,
+      .collision_interval = 4,
+  };
+  Pipeline pipeline(LayerMatrix({{1, 1}}));
+  pipeline.set_fidelity_lod(lod);
+
+  Frame frame = GenerateCluster(256, /*orbits=*/false);
+  const Frame initial_frame = frame;
+  std::vector<std::vector<Event>> events(100);
+  for (int frame_no = 0; frame_no < 100; ++frame_no) {
+    pipeline.Step(dt, frame_no, frame, {}, events[frame_no]);
+    const FidelityStats &stats = pipeline.fidelity_stats();
+    EXPECT_GT(stats.full_objects, 0);
+    EXPECT_GT(stats.reduced_objects, 0);
+    EXPECT_EQ(stats.full_objects + stats.reduced_objects, 256);
+    EXPECT_EQ(stats.reduced_collisions, frame_no % 4 == 0);
+  }
+
+  // The regions only depend on the frame, so replaying the same events
+  // reproduces the same motion.
+  Pipeline replay(LayerMatrix({{1, 1}}));
+  replay.set_fidelity_lod(lod);
+  Frame replay_frame = initial_frame;
+  for (int frame_no = 0; frame_no < 100; ++frame_no) {
+    replay.Replay(dt, frame_no, replay_frame, absl::MakeSpan(events[frame_no]));
+  }
+  EXPECT_TRUE(BitwiseEqual(frame.transforms, replay_frame.transforms));
+  EXPECT_TRUE(BitwiseEqual(frame.motion, replay_frame.motion));
+}
+
+TEST(PipelineTest, CoarseStepsKeepFrameNumbers) {
+  const float dt = 1.0f / 60;
+  Pipeline coarse(LayerMatrix({{1, 1}}));
+  Pipeline scaled(LayerMatrix({{1, 1}}));
+  coarse.set_orbit_lookahead(16);
+  scaled.set_orbit_lookahead(16);
+
+  // A step over two frames integrates like a single frame twice as long, and
+  // puts the orbits at the same time.
+  Frame coarse_frame = GenerateCluster(256);
+  Frame scaled_frame = coarse_frame;
+  std::vector<Event> coarse_events;
+  std::vector<Event> scaled_events;
+  for (int frame_no = 2; frame_no <= 100; frame_no += 2) {
+    coarse_events.clear();
+    scaled_events.clear();
+    coarse.Step(dt, frame_no, coarse_frame, {}, coarse_events, 2);
+    scaled.Step(dt * 2, frame_no / 2, scaled_frame, {}, scaled_events);
+    ASSERT_TRUE(coarse_events == scaled_events) << frame_no;
+    ASSERT_TRUE(BitwiseEqual(coarse_frame.motion, scaled_frame.motion))
+        << frame_no;
+  }
+  EXPECT_TRUE(BitwiseEqual(coarse_frame.transforms, scaled_frame.transforms));
+
+  // Frame numbers count frames, not steps, so the collision interval does too.
+  Pipeline pipeline(LayerMatrix({{1, 1}}));
+  pipeline.set_fidelity_lod(FidelityLod{
+      .entities = {Entity(0)},
+      .radius = 30,
+      .attractors = 1,
+      .collision_interval = 4,
+  });
+  Frame frame = GenerateCluster(256, /*orbits=*/false);
+  for (int frame_no = 2; frame_no <= 20; frame_no += 2) {
+    coarse_events.clear();
+    pipeline.Step(dt, frame_no, frame, {}, coarse_events, 2);
+    EXPECT_EQ(pipeline.fidelity_stats().reduced_collisions, frame_no % 4 == 0);
+  }
+}
+
+TEST(PipelineTest, ReducedCollisionsKeepFullPairs) {
+  const float dt = 1.0f / 60;
+  Pipeline pipeline(LayerMatrix({{1, 1}}));
+  pipeline.set_fidelity_lod(FidelityLod{
+      .entities = {Entity(1)},
+      .radius = 30,
+      .attractors = 0,
+      .collision_interval = 1000,
+  });
+
+  // A reduced object flies into the one in full, which has the higher ID, and
+  // two reduced objects overlap far away.
+  Frame frame;
+  for (const auto &[position, velocity] :
+       {std::make_pair(Vector3{40, 0, 0}, Vector3{-2400, 0, 0}),
+        std::make_pair(Vector3{0, 0, 0}, Vector3{}),
+        std::make_pair(Vector3{100, 0, 0}, Vector3{}),
+        std::make_pair(Vector3{100.5, 0, 0}, Vector3{})}) {
+    frame.Push(Transform{.position = position}, Mass{.inertial = 1},
+               Motion::FromPositionAndVelocity(position, velocity),
+               Collider{.layer = 1, .radius = 1}, Glue{}, Flags{});
+  }
+  std::vector<Event> events;
+  pipeline.Step(dt, 1, frame, {}, events);
+  EXPECT_FALSE(pipeline.fidelity_stats().reduced_collisions);
+  EXPECT_EQ(pipeline.fidelity_stats().reduced_objects, 3);
+  ASSERT_THAT(events, testing::SizeIs(1));
+  EXPECT_EQ(events[0].type, Event::kCollision);
+  EXPECT_EQ(events[0].collision.first_id, Entity(0));
+  EXPECT_EQ(events[0].collision.second_id, Entity(1));
+}
+
+TEST(PipelineTest, ReducedFidelityDrifts) {
+  const float dt = 1.0f / 60;
+  Pipeline pipeline(LayerMatrix({{1, 1}}));
+  // Nothing is of interest, so every object drifts and never collides.
+  pipeline.set_fidelity_lod(FidelityLod{
+      .attractors = 0,
+      .collision_interval = 1000,
+  });
+
+  Frame frame = GenerateCluster(256, /*orbits=*/false);
+  const Frame initial_frame = frame;
+  std::vector<Event> events;
+  for (int frame_no = 1; frame_no < 100; ++frame_no) {
+    pipeline.Step(dt, frame_no, frame, {}, events);
+  }
+  EXPECT_THAT(events, testing::IsEmpty());
+  EXPECT_EQ(pipeline.fidelity_stats().reduced_objects, 256);
+  for (int i = 0; i < 256; ++i) {
+    EXPECT_EQ(frame.motion[i].velocity, initial_frame.motion[i].velocity);
+  }
+}
+
+class PipelineAllocationTest : public testing::TestWithParam<int> {};
+
+TEST_P(PipelineAllocationTest, SteadyStateDoesNotAllocate) {
+  const float dt = 1.0f / 60;
+  Pipeline pipeline(LayerMatrix({{1, 1}}));
+  if (GetParam() > 0) {
+    pipeline.set_thread_pool(std::make_shared<ThreadPool>(GetParam()));
+  }
+  Frame frame = GenerateCluster(256);
+
+  // Object 0 has no pool, so every attempt fails.
+  std::vector<Event> input;
+  std::vector<Event> out_events;
+  out_events.reserve(4096);
+  auto step = [&](const int frame_no) {
+    input.assign(1, Event(Entity(0), Vector3{}, SpawnAttempt{}));
+    out_events.clear();
+    pipeline.Step(dt, frame_no, frame, absl::MakeSpan(input), out_events);
+  };
+
+  // The first frames size the pipeline's buffers.
+  for (int frame_no = 0; frame_no < 10; ++frame_no) step(frame_no);
+
+  int event_count = 0;
+  const int64_t before = AllocationCount();
+  for (int frame_no = 10; frame_no < 100; ++frame_no) {
+    step(frame_no);
+    event_count += out_events.size();
+  }
+  EXPECT_EQ(AllocationCount() - before, 0);
+  EXPECT_GT(event_count, 0);
+}
+
+INSTANTIATE_TEST_SUITE_P(PipelineAllocationTest, PipelineAllocationTest,
+                         testing::Values(0, 2));
+
 }  // namespace
 }  // namespace vstr
\ No newline at end of file
@@ -7,7 +7,9 @@
 
 #include "collision_detector.h"
 
+#include <algorithm>
 #include <limits>
+#include <utility>
 
 #include "geometry/aabb.h"
 #include "geometry/float.h"
@@ -18,13 +20,14 @@ namespace vstr {
 
 namespace {
 
-float DistanceToCollision(const std::vector<Transform> &positions,
+float DistanceToCollision(const Kinematics &kinematics,
                           const std::vector<Collider> &colliders,
-                          const std::vector<Motion> &motion, const Entity a,
-                          const Entity b, const float t) {
-  Vector3 a_pos = a.Get(positions).position + a.Get(motion).velocity * t +
+                          const Entity a, const Entity b, const float t) {
+  Vector3 a_pos = kinematics.position.Get(a.value()) +
+                  kinematics.velocity.Get(a.value()) * t +
                   a.Get(colliders).center;
-  Vector3 b_pos = b.Get(positions).position + b.Get(motion).velocity * t +
+  Vector3 b_pos = kinematics.position.Get(b.value()) +
+                  kinematics.velocity.Get(b.value()) * t +
                   b.Get(colliders).center;
   return Vector3::Magnitude(a_pos - b_pos) - a.Get(colliders).radius -
          b.Get(colliders).radius;
@@ -32,9 +35,8 @@ float DistanceToCollision(const std::vector<Transform> &positions,
 
 // Returns the earliest time objects a and b will collide based on their current
 // velocities. If no such time can be found, returns a time greater than dt.
-float CollisionTime(const std::vector<Transform> &positions,
-                    const std::vector<Collider> &colliders,
-                    const std::vector<Motion> &motion, const Entity a,
+float CollisionTime(const Kinematics &kinematics,
+                    const std::vector<Collider> &colliders, const Entity a,
                     const Entity b, const float dt) {
   // The distance between the two objects is a function of time:
   //
@@ -66,15 +68,15 @@ float CollisionTime(const std::vector<Transform> &positions,
   //    linear.
   // 2) If d(0) == d(dt/2) == d(dt) then the lines are parallel.
   // 3) Otherwise the function is V-shaped.
-  float d0 = DistanceToCollision(positions, colliders, motion, a, b, 0);
+  float d0 = DistanceToCollision(kinematics, colliders, a, b, 0);
 
   // The objects are already in collision.
   if (d0 <= 0) {
     return 0;
   }
 
-  float d1 = DistanceToCollision(positions, colliders, motion, a, b, dt / 2);
-  float d2 = DistanceToCollision(positions, colliders, motion, a, b, dt);
+  float d1 = DistanceToCollision(kinematics, colliders, a, b, dt / 2);
+  float d2 = DistanceToCollision(kinematics, colliders, a, b, dt);
 
   if (FloatEq(d0, d1) && FloatEq(d0, d2)) {
     // The lines are parallel. The objects are either already in collision, or
@@ -141,7 +143,7 @@ float CollisionTime(const std::vector<Transform> &positions,
   // the value is negative, we know it will be just on the negative side of
   // zero.
   float t = (-d0 / slope);
-  if (DistanceToCollision(positions, colliders, motion, a, b,
+  if (DistanceToCollision(kinematics, colliders, a, b,
                           t + std::numeric_limits<float>::epsilon()) < 0) {
     return t;
   }
@@ -149,38 +151,35 @@ float CollisionTime(const std::vector<Transform> &positions,
   return std::numeric_limits<float>::infinity();
 }
 
+// Destroyed objects are never in the BVH, so they don't need checking here.
 bool Eligible(const std::vector<Collider> &colliders,
-              const std::vector<Flags> &flags, const std::vector<Glue> &glue,
+              const FlagIndex &flag_index, const std::vector<Glue> &glue,
               const LayerMatrix &matrix, const Entity a, const Entity b) {
   if (b <= a) {
     return false;  // Checked in the other direction or self-collision.
   }
 
-  if ((a.Get(flags).value & Flags::kDestroyed) ||
-      (b.Get(flags).value & Flags::kDestroyed)) {
-    return false;
-  }
-
   if (!matrix.Check(a.Get(colliders).layer, b.Get(colliders).layer)) {
     return false;
   }
 
   // TODO: recursive glue?
-  if (((a.Get(flags).value & Flags::kGlued) && a.Get(glue).parent_id == b) ||
-      (b.Get(flags).value & Flags::kGlued) && b.Get(glue).parent_id == a) {
+  if ((flag_index.Test(a, Flags::kGlued) && a.Get(glue).parent_id == b) ||
+      (flag_index.Test(b, Flags::kGlued) && b.Get(glue).parent_id == a)) {
     return false;
   }
 
   return true;
 }
 
-Vector3 CollisionLocation(const std::vector<Transform> &positions,
-                          const std::vector<Motion> &motion,
+Vector3 CollisionLocation(const Kinematics &kinematics,
                           const std::vector<Collider> &colliders, const float t,
                           const Entity a, const Entity b) {
-  Vector3 a_pos = a.Get(positions).position + a.Get(motion).velocity * t +
+  Vector3 a_pos = kinematics.position.Get(a.value()) +
+                  kinematics.velocity.Get(a.value()) * t +
                   a.Get(colliders).center;
-  Vector3 b_pos = b.Get(positions).position + b.Get(motion).velocity * t +
+  Vector3 b_pos = kinematics.position.Get(b.value()) +
+                  kinematics.velocity.Get(b.value()) * t +
                   b.Get(colliders).center;
   return (b.Get(colliders).radius * a_pos + a.Get(colliders).radius * b_pos) /
          (a.Get(colliders).radius + b.Get(colliders).radius);
@@ -193,36 +192,87 @@ void CollisionDetector::DetectCollisions(
     const std::vector<Collider> &colliders, const std::vector<Motion> &motion,
     const std::vector<Flags> &flags, const std::vector<Glue> &glue,
     const float dt, std::vector<Event> &out_events) {
-  cache_bvh_kvs_.clear();
-  cache_object_swept_bounds_.clear();
-  for (size_t i = 0; i < colliders.size(); ++i) {
-    float radius = colliders[i].radius;
-    AABB bounds = AABB::FromCenterAndHalfExtents(
-        positions[i].position + colliders[i].center,
-        Vector3{radius, radius, radius});
-    bounds.Encapsulate(AABB::FromCenterAndHalfExtents(
-        motion[i].new_position, Vector3{radius, radius, radius}));
-    cache_bvh_kvs_.push_back(BVH::KV(bounds, Entity(i)));
-    cache_object_swept_bounds_.push_back(bounds);
+  cache_kinematics_.Load(positions, motion);
+  cache_flag_index_.Rebuild(flags);
+  cache_spatial_order_.Rebuild(positions, cache_flag_index_);
+  DetectCollisions(cache_kinematics_, colliders, cache_flag_index_,
+                   cache_spatial_order_, glue, nullptr, dt, out_events);
+}
+
+void CollisionDetector::DetectCollisions(const Kinematics &kinematics,
+                                         const std::vector<Collider> &colliders,
+                                         const FlagIndex &flag_index,
+                                         const SpatialOrder &spatial_order,
+                                         const std::vector<Glue> &glue,
+                                         const std::vector<uint8_t> *reduced,
+                                         const float dt,
+                                         std::vector<Event> &out_events) {
+  // The swept bounds enclose each collider at its current and its new
+  // position. This loop has no branches and works on float arrays, so it
+  // vectorizes.
+  const size_t count = colliders.size();
+  pairs_.clear();
+  // Usually enough to never grow in the steady state.
+  if (record_pairs_) pairs_.reserve(count);
+  cache_swept_min_.resize(count);
+  cache_swept_max_.resize(count);
+  const Vector3Array &p = kinematics.position;
+  const Vector3Array &np = kinematics.new_position;
+  for (size_t i = 0; i < count; ++i) {
+    const float r = colliders[i].radius;
+    const Vector3 c = colliders[i].center;
+    cache_swept_min_.x[i] = std::min(p.x[i] + c.x - r, np.x[i] - r);
+    cache_swept_min_.y[i] = std::min(p.y[i] + c.y - r, np.y[i] - r);
+    cache_swept_min_.z[i] = std::min(p.z[i] + c.z - r, np.z[i] - r);
+    cache_swept_max_.x[i] = std::max(p.x[i] + c.x + r, np.x[i] + r);
+    cache_swept_max_.y[i] = std::max(p.y[i] + c.y + r, np.y[i] + r);
+    cache_swept_max_.z[i] = std::max(p.z[i] + c.z + r, np.z[i] + r);
   }
+
+  // Only objects that aren't destroyed go in the BVH. Inserting them in spatial
+  // order keeps the leaves of each subtree close together in memory, and makes
+  // consecutive queries below walk mostly the same nodes.
+  assert(spatial_order.size() == count);
+  cache_bvh_kvs_.clear();
+  spatial_order.ForEach(flag_index, [&](const size_t i) {
+    cache_bvh_kvs_.push_back(BVH::KV(
+        AABB(cache_swept_min_.Get(i), cache_swept_max_.Get(i)), Entity(i)));
+  });
+  if (cache_bvh_kvs_.empty()) return;
   cache_bvh_.Rebuild(cache_bvh_kvs_);
 
-  std::vector<BVH::KV> buffer;
-  for (size_t i = 0; i < colliders.size(); ++i) {
-    buffer.clear();
-    cache_bvh_.Overlap(cache_object_swept_bounds_[i], buffer);
-    for (const auto &kv : buffer) {
-      if (Eligible(colliders, flags, glue, matrix_, Entity(i), kv.value)) {
-        float t = CollisionTime(positions, colliders, motion, Entity(i),
-                                kv.value, dt);
+  const size_t first_event = out_events.size();
+  spatial_order.ForEach(flag_index, [&](const size_t i) {
+    if (reduced != nullptr && (*reduced)[i] != 0) return;
+    cache_overlap_.clear();
+    cache_bvh_.Overlap(AABB(cache_swept_min_.Get(i), cache_swept_max_.Get(i)),
+                       cache_overlap_);
+    for (const auto &kv : cache_overlap_) {
+      // A reduced object doesn't query, so its pairs with this one are
+      // checked here, whichever has the lower ID.
+      Entity a(i);
+      Entity b = kv.value;
+      if (reduced != nullptr && (*reduced)[b.value()] != 0 && b < a) {
+        std::swap(a, b);
+      }
+      if (Eligible(colliders, flag_index, glue, matrix_, a, b)) {
+        if (record_pairs_) pairs_.emplace_back(a, b);
+        float t = CollisionTime(kinematics, colliders, a, b, dt);
         if (t <= dt) {
           out_events.push_back(
-              Event(CollisionLocation(positions, motion, colliders, t,
-                                      Entity(i), kv.value),
-                    Collision{Entity(i), kv.value, t}));
+              Event(CollisionLocation(kinematics, colliders, t, a, b),
+                    Collision{a, b, t}));
         }
       }
     }
-  }
+  });
+
+  std::sort(out_events.begin() + first_event, out_events.end(),
+            [](const Event &a, const Event &b) {
+              return std::make_pair(a.collision.first_id,
+                                    a.collision.second_id) <
+                     std::make_pair(b.collision.first_id,
+                                    b.collision.second_id);
+            });
 }
-};  // namespace vstr
\ No newline at end of file
+};  // namespace vstr
@@ -12,7 +12,10 @@
 
 #include "geometry/bvh.h"
 #include "geometry/layer_matrix.h"
+#include "types/flag_index.h"
+#include "types/kinematics.h"
 #include "types/required_components.h"
+#include "types/spatial_order.h"
 
 namespace vstr {
 
@@ -26,14 +29,47 @@ class CollisionDetector {
                         const std::vector<Glue> &glue, float dt,
                         std::vector<Event> &out_events);
 
+  // Same as above, but reads positions and velocities from the SoA kinematics,
+  // which must be up to date with Motion.new_position. Destroyed objects are
+  // skipped using the flag index. Objects are visited in spatial order, which
+  // must cover all objects, but may be stale.
+  //
+  // Collision events are sorted by the IDs of the colliding objects, so the
+  // output doesn't depend on the spatial order.
+  //
+  // If reduced isn't null, pairs of objects that both have a non-zero entry in
+  // it are left out. Only the other objects query for overlaps.
+  void DetectCollisions(const Kinematics &kinematics,
+                        const std::vector<Collider> &colliders,
+                        const FlagIndex &flag_index,
+                        const SpatialOrder &spatial_order,
+                        const std::vector<Glue> &glue,
+                        const std::vector<uint8_t> *reduced, float dt,
+                        std::vector<Event> &out_events);
+
   const inline LayerMatrix &matrix() const { return matrix_; }
 
+  // While on, the SoA DetectCollisions records every pair of objects whose
+  // swept bounds overlap and that are eligible to collide, whether they end up
+  // colliding or not. Each pair is recorded once, lower ID first.
+  inline void set_record_pairs(const bool record) { record_pairs_ = record; }
+  inline const std::vector<std::pair<Entity, Entity>> &pairs() const {
+    return pairs_;
+  }
+
  private:
   using BVH = BoundingVolumeHierarchy<Entity>;
   LayerMatrix matrix_;
   BVH cache_bvh_;
   std::vector<BVH::KV> cache_bvh_kvs_;
-  std::vector<AABB> cache_object_swept_bounds_;
+  std::vector<BVH::KV> cache_overlap_;
+  Vector3Array cache_swept_min_;
+  Vector3Array cache_swept_max_;
+  Kinematics cache_kinematics_;
+  FlagIndex cache_flag_index_;
+  SpatialOrder cache_spatial_order_;
+  bool record_pairs_ = false;
+  std::vector<std::pair<Entity, Entity>> pairs_;
 };
 
 }  // namespace vstr
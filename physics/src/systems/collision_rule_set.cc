@@ -11,15 +11,13 @@ namespace vstr {
 
 namespace {
 
-void ApplyTrigger(const Event &event, const std::vector<Trigger> &triggers,
+void ApplyTrigger(const Event &event, const SparseSet<Trigger> &triggers,
                   std::vector<Event> &out_events) {
-  auto it = std::lower_bound(
-      triggers.begin(), triggers.end(), Trigger{.id = event.id},
-      [](const Trigger &a, const Trigger &b) { return a.id < b.id; });
-  if (it != triggers.end() && it->id == event.id) {
-    Event new_event = it->event;
+  const Trigger *trigger = event.id.Get(triggers);
+  if (trigger != nullptr) {
+    Event new_event = trigger->event;
     new_event.position = event.position;
-    switch (it->target) {
+    switch (trigger->target) {
       case Trigger::kSelf:
         new_event.id = event.id;
         break;
@@ -32,7 +30,7 @@ void ApplyTrigger(const Event &event, const std::vector<Trigger> &triggers,
     }
     out_events.push_back(new_event);
 
-    if (it->flags & Trigger::kDestroyTrigger) {
+    if (trigger->flags & Trigger::kDestroyTrigger) {
       out_events.push_back(Event(event.id, event.position, Destruction{}));
     }
   }
@@ -158,11 +156,12 @@ void CollisionRuleSet::Apply(const std::vector<Transform> &transforms,
                              const std::vector<Mass> &mass,
                              const std::vector<Motion> &motion,
                              const std::vector<Collider> &colliders,
-                             const std::vector<Trigger> &triggers,
+                             const SparseSet<Trigger> &triggers,
                              std::vector<Event> &in_out_events) {
   int limit = in_out_events.size();
   for (int i = 0; i < limit; ++i) {
-    const Event &event = in_out_events[i];
+    // A copy, because the rules append to in_out_events, which may move it.
+    const Event event = in_out_events[i];
     if (event.type != Event::kCollision) continue;
     // Apply once in either direction.
     ApplyToCollision(transforms, mass, motion, colliders, triggers, event,
@@ -175,7 +174,7 @@ void CollisionRuleSet::Apply(const std::vector<Transform> &transforms,
 void CollisionRuleSet::ApplyToCollision(
     const std::vector<Transform> &transforms, const std::vector<Mass> &mass,
     const std::vector<Motion> &motion, const std::vector<Collider> &colliders,
-    const std::vector<Trigger> &triggers, const Event &event,
+    const SparseSet<Trigger> &triggers, const Event &event,
     std::vector<Event> &out_events) {
   const auto it = collision_rules_.find(
       std::make_pair(event.collision.first_id.Get(colliders).layer,
@@ -79,7 +79,7 @@ class CollisionRuleSet {
   void Apply(const std::vector<Transform> &positions,
              const std::vector<Mass> &mass, const std::vector<Motion> &motion,
              const std::vector<Collider> &colliders,
-             const std::vector<Trigger> &triggers,
+             const SparseSet<Trigger> &triggers,
              std::vector<Event> &in_out_events);
 
  private:
@@ -89,7 +89,7 @@ class CollisionRuleSet {
                         const std::vector<Mass> &mass,
                         const std::vector<Motion> &motion,
                         const std::vector<Collider> &colliders,
-                        const std::vector<Trigger> &triggers,
+                        const SparseSet<Trigger> &triggers,
                         const Event &event, std::vector<Event> &out_events);
 };
 
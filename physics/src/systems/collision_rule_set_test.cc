@@ -44,7 +44,8 @@ TEST_P(RuleSetTest, RuleSetTest) {
   }
   std::vector<Event> events = GetParam().input;
   rule_set.Apply(GetParam().positions, GetParam().mass, GetParam().motion,
-                 GetParam().colliders, GetParam().triggers, events);
+                 GetParam().colliders, SparseSet<Trigger>(GetParam().triggers),
+                 events);
 
   std::vector<Event> output(events.begin() + GetParam().input.size(),
                             events.end());
@@ -391,5 +392,50 @@ INSTANTIATE_TEST_SUITE_P(
       return tc.param.comment;
     });
 
+// Regression test: the rules append to the event vector while Apply still
+// reads the collision from it. With no spare capacity, the first append
+// reallocates, and the inverse collision must still see the right ids.
+TEST(CollisionRuleSetTest, AppendReallocatesEvents) {
+  const CollisionEffect destroy{
+      .type = CollisionEffect::kDestroy,
+      .min_speed = 0,
+      .max_speed = std::numeric_limits<float>::infinity(),
+      .min_impactor_energy = 0,
+      .max_impactor_energy = std::numeric_limits<float>::infinity(),
+  };
+  CollisionRuleSet rule_set;
+  rule_set.Add({0, 1}, destroy);
+  rule_set.Add({1, 0}, destroy);
+
+  const std::vector<Transform> positions{{.position{0, 0, 0}},
+                                         {.position{1, 0, 0}}};
+  const std::vector<Mass> mass{{.inertial = 1}, {.inertial = 1}};
+  const std::vector<Motion> motion(2);
+  const std::vector<Collider> colliders{{.layer = 0, .radius = 1},
+                                        {.layer = 1, .radius = 1}};
+
+  std::vector<Event> events{
+      Event(Vector3{0.5, 0, 0}, Collision{
+                                    .first_id = Entity(0),
+                                    .second_id = Entity(1),
+                                    .first_frame_offset_seconds = 0,
+                                }),
+  };
+  events.shrink_to_fit();
+  ASSERT_EQ(events.capacity(), 1u);
+
+  rule_set.Apply(positions, mass, motion, colliders, SparseSet<Trigger>(),
+                 events);
+
+  EXPECT_THAT(
+      std::vector<Event>(events.begin() + 1, events.end()),
+      testing::Pointwise(
+          EventMatches(0.005),
+          std::vector<Event>{
+              Event(Entity(0), Vector3{0.5, 0, 0}, Destruction{}),
+              Event(Entity(1), Vector3{0.5, 0, 0}, Destruction{}),
+          }));
+}
+
 }  // namespace
 }  // namespace vstr
\ No newline at end of file
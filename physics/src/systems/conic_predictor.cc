@@ -0,0 +1,283 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "conic_predictor.h"
+
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace vstr {
+namespace {
+
+constexpr int kMaxNewtonIterations = 50;
+
+// Stumpff functions c(z) and s(z), with their series near zero.
+void Stumpff(const double z, double &c, double &s) {
+  if (z > 1e-6) {
+    const double sqrt_z = std::sqrt(z);
+    c = (1 - std::cos(sqrt_z)) / z;
+    s = (sqrt_z - std::sin(sqrt_z)) / (sqrt_z * sqrt_z * sqrt_z);
+  } else if (z < -1e-6) {
+    const double sqrt_z = std::sqrt(-z);
+    c = (std::cosh(sqrt_z) - 1) / -z;
+    s = (std::sinh(sqrt_z) - sqrt_z) / (sqrt_z * sqrt_z * sqrt_z);
+  } else {
+    c = 1.0 / 2 - z / 24;
+    s = 1.0 / 6 - z / 120;
+  }
+}
+
+}  // namespace
+
+void PropagateConic(const float mu, const float dt, Vector3 &position,
+                    Vector3 &velocity) {
+  const double r0 = Vector3::Magnitude(position);
+  if (mu <= 0 || r0 == 0) {
+    position += velocity * dt;
+    return;
+  }
+
+  // See Curtis, Orbital Mechanics for Engineering Students, algorithm 3.4.
+  // Solve the universal Kepler equation for the universal anomaly chi with
+  // Newton's method, in double precision, because the terms cancel out.
+  const double sqrt_mu = std::sqrt(static_cast<double>(mu));
+  const double radial_velocity = Vector3::Dot(position, velocity) / r0;
+  // Reciprocal of the semi-major axis: positive for ellipses.
+  const double alpha =
+      2 / r0 - Vector3::SqrMagnitude(velocity) / static_cast<double>(mu);
+  double chi = sqrt_mu * std::abs(alpha) * dt;
+  double z = 0;
+  double c = 0;
+  double s = 0;
+  for (int i = 0; i < kMaxNewtonIterations; ++i) {
+    z = alpha * chi * chi;
+    Stumpff(z, c, s);
+    const double f = r0 * radial_velocity / sqrt_mu * chi * chi * c +
+                     (1 - alpha * r0) * chi * chi * chi * s + r0 * chi -
+                     sqrt_mu * dt;
+    const double df = r0 * radial_velocity / sqrt_mu * chi * (1 - z * s) +
+                      (1 - alpha * r0) * chi * chi * c + r0;
+    const double step = f / df;
+    chi -= step;
+    if (std::abs(step) <= 1e-12 * (1 + std::abs(chi))) break;
+  }
+  z = alpha * chi * chi;
+  Stumpff(z, c, s);
+
+  // Lagrange coefficients.
+  const double f = 1 - chi * chi / r0 * c;
+  const double g = dt - chi * chi * chi * s / sqrt_mu;
+  const Vector3 new_position =
+      position * static_cast<float>(f) + velocity * static_cast<float>(g);
+  const double r = Vector3::Magnitude(new_position);
+  const double df = sqrt_mu / (r * r0) * chi * (z * s - 1);
+  const double dg = 1 - chi * chi / r * c;
+  const Vector3 new_velocity =
+      position * static_cast<float>(df) + velocity * static_cast<float>(dg);
+
+  // Far out on a hyperbola, cosh can overflow. The attractor's pull is weak
+  // there anyway.
+  if (!std::isfinite(Vector3::SqrMagnitude(new_position)) ||
+      !std::isfinite(Vector3::SqrMagnitude(new_velocity))) {
+    position += velocity * dt;
+    return;
+  }
+  position = new_position;
+  velocity = new_velocity;
+}
+
+void ConicPredictor::Reset(const float t, const float dt,
+                           absl::Span<const Entity> bodies,
+                           const std::vector<Transform> &transforms,
+                           const std::vector<Motion> &motion,
+                           const std::vector<Mass> &mass,
+                           const FlagIndex &flag_index,
+                           const SparseSet<Orbit> &orbits) {
+  t0_ = t;
+  t_ = t;
+  dt_ = dt;
+  transitions_ = 0;
+  attractors_.clear();
+  bodies_.clear();
+  orbits_.clear();
+
+  // Same attractors as GravityAt.
+  flag_index.ForEach(
+      0, Flags::kDestroyed | Flags::kGlued, [&](const size_t i) {
+        if (mass[i].active == 0) return;
+        const Entity id(i);
+        const Orbit *orbit = orbits.Find(id);
+        const bool on_orbit =
+            orbit != nullptr && flag_index.Test(id, Flags::kOrbiting);
+        attractors_.push_back(Attractor{
+            .id = id,
+            .mu = mass[i].active,
+            .cutoff = mass[i].cutoff_distance,
+            .orbit = on_orbit ? AddOrbit(orbits, *orbit) : -1,
+            .parent = -1,
+            .soi_scale = 0,
+            .initial_position = transforms[i].position,
+            .velocity = motion[i].velocity,
+        });
+      });
+  for (Attractor &attractor : attractors_) {
+    if (attractor.orbit < 0) continue;
+    const Entity parent_id = orbits_[attractor.orbit].parent_id;
+    for (size_t j = 0; j < attractors_.size(); ++j) {
+      if (attractors_[j].id != parent_id) continue;
+      attractor.parent = j;
+      attractor.soi_scale = std::pow(attractor.mu / attractors_[j].mu, 0.4f);
+    }
+  }
+
+  for (const Entity id : bodies) {
+    const Orbit *orbit = orbits.Find(id);
+    const bool on_orbit =
+        orbit != nullptr && flag_index.Test(id, Flags::kOrbiting);
+    bodies_.push_back(Body{
+        .id = id,
+        .orbit = on_orbit ? AddOrbit(orbits, *orbit) : -1,
+        .attractor = -1,
+        .position = id.Get(transforms).position,
+        .velocity = id.Get(motion).velocity,
+    });
+  }
+
+  UpdateAttractors();
+  for (Body &body : bodies_) {
+    if (body.orbit < 0) Rebase(body);
+  }
+  transitions_ = 0;
+}
+
+void ConicPredictor::Advance(const float t) {
+  assert(t >= t_);
+  // The attractor's frame is treated as inertial over the step.
+  for (Body &body : bodies_) {
+    if (body.orbit >= 0) continue;
+    const float mu = body.attractor < 0 ? 0 : attractors_[body.attractor].mu;
+    PropagateConic(mu, t - t_, body.position, body.velocity);
+  }
+  t_ = t;
+  UpdateAttractors();
+  for (Body &body : bodies_) {
+    if (body.orbit < 0) Rebase(body);
+  }
+}
+
+Vector3 ConicPredictor::position(const size_t k) const {
+  const Body &body = bodies_[k];
+  if (body.orbit >= 0) return orbit_positions_->Get(body.orbit);
+  if (body.attractor < 0) return body.position;
+  return body.position + attractors_[body.attractor].position;
+}
+
+Vector3 ConicPredictor::velocity(const size_t k) {
+  const Body &body = bodies_[k];
+  if (body.orbit >= 0) return OrbitVelocity(body.orbit);
+  if (body.attractor < 0) return body.velocity;
+  return body.velocity + AttractorVelocity(body.attractor);
+}
+
+Entity ConicPredictor::attractor(const size_t k) const {
+  const int32_t a = bodies_[k].attractor;
+  return a < 0 ? Entity::Nil() : attractors_[a].id;
+}
+
+int32_t ConicPredictor::AddOrbit(const SparseSet<Orbit> &orbits,
+                                 const Orbit &orbit) {
+  for (size_t k = 0; k < orbits_.size(); ++k) {
+    if (orbits_[k].id == orbit.id) return k;
+  }
+  const int32_t k = orbits_.size();
+  orbits_.push_back(orbit);
+  // The solver needs the parents to place moons.
+  const Orbit *parent = orbits.Find(orbit.parent_id);
+  if (parent != nullptr) AddOrbit(orbits, *parent);
+  return k;
+}
+
+void ConicPredictor::UpdateAttractors() {
+  if (!orbits_.empty()) orbit_positions_ = &solver_.Solve(t_, orbits_);
+  previous_orbit_positions_ = nullptr;
+  for (Attractor &attractor : attractors_) {
+    attractor.position =
+        attractor.orbit >= 0
+            ? orbit_positions_->Get(attractor.orbit)
+            : attractor.initial_position + attractor.velocity * (t_ - t0_);
+  }
+  for (Attractor &attractor : attractors_) {
+    attractor.soi = attractor.cutoff > 0
+                        ? attractor.cutoff
+                        : std::numeric_limits<float>::infinity();
+    if (attractor.parent < 0) continue;
+    const Attractor &parent = attractors_[attractor.parent];
+    const float laplace =
+        Vector3::Magnitude(attractor.position - parent.position) *
+        attractor.soi_scale;
+    attractor.soi = std::min(attractor.soi, laplace);
+  }
+}
+
+Vector3 ConicPredictor::OrbitVelocity(const int32_t orbit) {
+  // Same as in the pipeline, an orbiting body's velocity is how far it moved
+  // since the previous frame. (Here, it's per second.) Most steps don't need
+  // it, so the previous positions are only solved on demand.
+  if (previous_orbit_positions_ == nullptr) {
+    previous_orbit_positions_ = &previous_solver_.Solve(t_ - dt_, orbits_);
+  }
+  return (orbit_positions_->Get(orbit) -
+          previous_orbit_positions_->Get(orbit)) /
+         dt_;
+}
+
+Vector3 ConicPredictor::AttractorVelocity(const int32_t a) {
+  const Attractor &attractor = attractors_[a];
+  return attractor.orbit >= 0 ? OrbitVelocity(attractor.orbit)
+                              : attractor.velocity;
+}
+
+int32_t ConicPredictor::Dominant(const Vector3 &position,
+                                 const Entity id) const {
+  int32_t best = -1;
+  float best_pull = 0;
+  for (size_t a = 0; a < attractors_.size(); ++a) {
+    const Attractor &attractor = attractors_[a];
+    if (attractor.id == id) continue;
+    const float r_square =
+        Vector3::SqrMagnitude(position - attractor.position);
+    if (r_square >= attractor.soi * attractor.soi) continue;
+    const float pull = attractor.mu / r_square;
+    if (best < 0 || attractor.soi < attractors_[best].soi ||
+        (attractor.soi == attractors_[best].soi && pull > best_pull)) {
+      best = a;
+      best_pull = pull;
+    }
+  }
+  return best;
+}
+
+void ConicPredictor::Rebase(Body &body) {
+  Vector3 position = body.position;
+  if (body.attractor >= 0) position += attractors_[body.attractor].position;
+  const int32_t attractor = Dominant(position, body.id);
+  if (attractor == body.attractor) return;
+
+  ++transitions_;
+  Vector3 velocity = body.velocity;
+  if (body.attractor >= 0) velocity += AttractorVelocity(body.attractor);
+  body.attractor = attractor;
+  if (attractor >= 0) {
+    position = position - attractors_[attractor].position;
+    velocity = velocity - AttractorVelocity(attractor);
+  }
+  body.position = position;
+  body.velocity = velocity;
+}
+
+}  // namespace vstr
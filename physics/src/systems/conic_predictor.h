@@ -0,0 +1,139 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_CONIC_PREDICTOR
+#define VSTR_CONIC_PREDICTOR
+
+#include <absl/types/span.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "geometry/vector3.h"
+#include "systems/kepler.h"
+#include "types/entity.h"
+#include "types/flag_index.h"
+#include "types/kinematics.h"
+#include "types/optional_components.h"
+#include "types/required_components.h"
+
+namespace vstr {
+
+// Predicts where coasting bodies go, far ahead and much more cheaply than
+// simulating, using patched conics: at any time, only the attractor whose
+// sphere of influence (SOI) the body is in pulls on it, so the body follows a
+// conic section (ellipse, parabola or hyperbola) around that attractor. When
+// the body crosses into another SOI, it continues on a new conic around the
+// new attractor.
+//
+// An attractor's SOI has radius d × (m / M)^(2/5), where m is its active mass,
+// M is the active mass of its Orbit's parent and d is their distance. It's
+// further limited by the attractor's cutoff distance. Attractors without a
+// parent reach everywhere, up to their cutoff. If the SOIs of several
+// attractors contain the body, the smallest wins, then the strongest pull.
+//
+// Attractors on an Orbit move along it, computed by a KeplerSolver the same way
+// the pipeline does. Other attractors keep moving in a straight line. Bodies on
+// an Orbit follow it exactly, too. Input, rockets and collisions are ignored.
+//
+// SOI crossings are only checked at each Advance, so the steps should be short
+// compared to the time it takes to cross an SOI.
+class ConicPredictor {
+ public:
+  // Loads the attractors and the bodies from the frame at time t. dt is the
+  // frame time, which the pipeline uses to derive the velocity of orbiting
+  // bodies.
+  void Reset(float t, float dt, absl::Span<const Entity> bodies,
+             const std::vector<Transform> &transforms,
+             const std::vector<Motion> &motion, const std::vector<Mass> &mass,
+             const FlagIndex &flag_index, const SparseSet<Orbit> &orbits);
+
+  // Moves the bodies ahead to time t, which must not be before the last Reset
+  // or Advance.
+  void Advance(float t);
+
+  // State of the kth body passed to Reset, in world space, as of the last
+  // Reset or Advance. The velocity is in units per second. (It's not const,
+  // because the velocities of orbits are computed on demand.)
+  Vector3 position(size_t k) const;
+  Vector3 velocity(size_t k);
+
+  // The entity whose SOI the kth body is in, or Entity::Nil() for none.
+  Entity attractor(size_t k) const;
+
+  // How many times any body crossed into another SOI since the last Reset.
+  inline int transitions() const { return transitions_; }
+
+ private:
+  struct Attractor {
+    Entity id;
+    float mu;
+    float cutoff;
+    // Index into orbits_, or -1 if the attractor moves in a straight line.
+    int32_t orbit;
+    // Index into attractors_ of the Orbit's parent, or -1.
+    int32_t parent;
+    // (m / M)^(2/5), for the SOI.
+    float soi_scale;
+    // At the last Reset, for attractors moving in a straight line.
+    Vector3 initial_position;
+    // At the last Reset or Advance.
+    Vector3 position;
+    float soi;
+    // Only for attractors moving in a straight line.
+    Vector3 velocity;
+  };
+
+  struct Body {
+    Entity id;
+    // Index into orbits_ for bodies that follow an Orbit, or -1.
+    int32_t orbit;
+    // Index into attractors_ of the dominant attractor, or -1.
+    int32_t attractor;
+    // Relative to the dominant attractor, or to the origin without one.
+    Vector3 position;
+    Vector3 velocity;
+  };
+
+  // Adds the orbit and its parents to orbits_, returning its index.
+  int32_t AddOrbit(const SparseSet<Orbit> &orbits, const Orbit &orbit);
+  // Moves the attractors to t_, and recomputes their SOIs.
+  void UpdateAttractors();
+  Vector3 OrbitVelocity(int32_t orbit);
+  Vector3 AttractorVelocity(int32_t a);
+  // Index into attractors_ of the dominant attractor at position, not counting
+  // the attractor with the given id, or -1.
+  int32_t Dominant(const Vector3 &position, Entity id) const;
+  // Switches the body to the dominant attractor, if that changed.
+  void Rebase(Body &body);
+
+  float t_ = 0;
+  float dt_ = 0;
+  int transitions_ = 0;
+  std::vector<Attractor> attractors_;
+  std::vector<Body> bodies_;
+  // Orbits of attractors and bodies, and their parents, solved at t_ and (on
+  // demand) t_ - dt_.
+  std::vector<Orbit> orbits_;
+  KeplerSolver solver_;
+  KeplerSolver previous_solver_;
+  const Vector3Array *orbit_positions_ = nullptr;
+  const Vector3Array *previous_orbit_positions_ = nullptr;
+  // Time of the last Reset.
+  float t0_ = 0;
+};
+
+// Advances a two-body state by dt. Position and velocity are relative to an
+// attractor of active mass mu (which is also the gravitational parameter, since
+// G = 1). Uses the universal variable formulation, so it works for any conic,
+// and dt can be many orbits long. With mu = 0, the body moves in a straight
+// line.
+void PropagateConic(float mu, float dt, Vector3 &position, Vector3 &velocity);
+
+}  // namespace vstr
+
+#endif
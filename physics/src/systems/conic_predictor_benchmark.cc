@@ -0,0 +1,96 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+#include "conic_predictor.h"
+
+namespace vstr {
+namespace {
+
+constexpr float kDeltaTime = 1.0f / 60;
+
+struct Scene {
+  std::vector<Transform> transforms;
+  std::vector<Motion> motion;
+  std::vector<Mass> mass;
+  std::vector<Flags> flags;
+  FlagIndex flag_index;
+  SparseSet<Orbit> orbits;
+  std::vector<Entity> ships;
+};
+
+// A sun, 8 planets with 4 moons each, and ships scattered among them.
+Scene Generate(const int ships) {
+  std::mt19937 random_generator;
+  std::uniform_real_distribution<float> position_rg(-1e5, 1e5);
+  std::uniform_real_distribution<float> velocity_rg(-100, 100);
+
+  Scene scene;
+  const auto push = [&](const Vector3 &position, const Vector3 &velocity,
+                        const float active, const uint32_t flags) {
+    scene.transforms.push_back(Transform{.position = position});
+    scene.motion.push_back(Motion{.velocity = velocity});
+    scene.mass.push_back(Mass{.inertial = 1, .active = active});
+    scene.flags.push_back(Flags{.value = flags});
+    return Entity(scene.transforms.size() - 1);
+  };
+  const Entity sun = push({}, {}, 1e9, 0);
+  for (int i = 0; i < 8; ++i) {
+    const Entity planet = push({}, {}, 1e6, Flags::kOrbiting);
+    scene.orbits.GetOrInit(planet) = Orbit{
+        .id = planet,
+        .epoch{.semi_major_axis = 1e4f * (i + 1), .eccentricity = 0.05},
+        .delta{.mean_longitude_deg = 1.0f / (i + 1)},
+        .parent_id = sun,
+    };
+    for (int j = 0; j < 4; ++j) {
+      const Entity moon = push({}, {}, 1e3, Flags::kOrbiting);
+      scene.orbits.GetOrInit(moon) = Orbit{
+          .id = moon,
+          .epoch{.semi_major_axis = 200.0f * (j + 1),
+                 .mean_longitude_deg = 90.0f * j},
+          .delta{.mean_longitude_deg = 10},
+          .parent_id = planet,
+      };
+    }
+  }
+  for (int i = 0; i < ships; ++i) {
+    scene.ships.push_back(push(
+        {position_rg(random_generator), position_rg(random_generator), 0},
+        {velocity_rg(random_generator), velocity_rg(random_generator), 0}, 0,
+        0));
+  }
+  scene.flag_index.Rebuild(scene.flags);
+  return scene;
+}
+
+// A preview of 10 minutes ahead, sampled once a second.
+void BM_PredictConics(benchmark::State &state) {
+  Scene scene = Generate(state.range(0));
+  ConicPredictor predictor;
+  for (auto _ : state) {
+    predictor.Reset(0, kDeltaTime, scene.ships, scene.transforms, scene.motion,
+                    scene.mass, scene.flag_index, scene.orbits);
+    for (int i = 1; i <= 600; ++i) {
+      predictor.Advance(i);
+      benchmark::DoNotOptimize(predictor.position(0));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) * 600);
+}
+BENCHMARK(BM_PredictConics)
+    ->RangeMultiplier(4)
+    ->Range(1, 64)
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+}  // namespace vstr
+
+BENCHMARK_MAIN();
@@ -0,0 +1,161 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "conic_predictor.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+namespace vstr {
+namespace {
+
+float Energy(const float mu, const Vector3 &position, const Vector3 &velocity) {
+  return Vector3::SqrMagnitude(velocity) / 2 -
+         mu / Vector3::Magnitude(position);
+}
+
+TEST(PropagateConicTest, CircularPeriod) {
+  const float mu = 1000;
+  const float r = 100;
+  const float period = 2 * M_PI * std::sqrt(r * r * r / mu);
+  Vector3 position{r, 0, 0};
+  Vector3 velocity{0, std::sqrt(mu / r), 0};
+
+  // Half way around, then all the way, then ten more times in one step.
+  PropagateConic(mu, period / 2, position, velocity);
+  EXPECT_NEAR(position.x, -r, 1e-2);
+  EXPECT_NEAR(position.y, 0, 1e-2);
+  EXPECT_NEAR(velocity.y, -std::sqrt(mu / r), 1e-3);
+  PropagateConic(mu, period / 2, position, velocity);
+  EXPECT_NEAR(position.x, r, 1e-2);
+  EXPECT_NEAR(position.y, 0, 1e-2);
+  PropagateConic(mu, period * 10, position, velocity);
+  EXPECT_NEAR(position.x, r, 1e-1);
+  EXPECT_NEAR(position.y, 0, 1e-1);
+}
+
+TEST(PropagateConicTest, ConservesEnergyAndMomentum) {
+  const float mu = 1000;
+  for (const Vector3 initial_velocity :
+       {Vector3{1, 2, 0.5}, Vector3{0, 3, 1}, Vector3{-4, 4, 0}}) {
+    // Ellipse, parabola-ish and hyperbola.
+    Vector3 position{100, 20, -5};
+    Vector3 velocity = initial_velocity;
+    const float energy = Energy(mu, position, velocity);
+    const Vector3 momentum = Vector3::Cross(position, velocity);
+    for (int i = 0; i < 100; ++i) {
+      PropagateConic(mu, 1.5, position, velocity);
+      ASSERT_NEAR(Energy(mu, position, velocity), energy,
+                  1e-3 * (1 + std::abs(energy)))
+          << initial_velocity << " " << i;
+      ASSERT_LE(Vector3::Magnitude(Vector3::Cross(position, velocity) -
+                                   momentum),
+                1e-3 * Vector3::Magnitude(momentum))
+          << initial_velocity << " " << i;
+    }
+  }
+}
+
+TEST(PropagateConicTest, NoAttractor) {
+  Vector3 position{1, 2, 3};
+  Vector3 velocity{1, 0, -1};
+  PropagateConic(0, 2, position, velocity);
+  EXPECT_EQ(position, (Vector3{3, 2, 1}));
+  EXPECT_EQ(velocity, (Vector3{1, 0, -1}));
+}
+
+struct Scene {
+  std::vector<Transform> transforms;
+  std::vector<Motion> motion;
+  std::vector<Mass> mass;
+  std::vector<Flags> flags;
+  FlagIndex flag_index;
+  SparseSet<Orbit> orbits;
+
+  Entity Push(const Vector3 &position, const Vector3 &velocity,
+              const Mass &m = Mass{}, const uint32_t flag_bits = 0) {
+    transforms.push_back(Transform{.position = position});
+    motion.push_back(Motion{.velocity = velocity});
+    mass.push_back(m);
+    flags.push_back(Flags{.value = flag_bits});
+    flag_index.Rebuild(flags);
+    return Entity(transforms.size() - 1);
+  }
+};
+
+TEST(ConicPredictorTest, SphereOfInfluence) {
+  // A light moon with a short reach, next to a planet. The ship flies past the
+  // moon fast enough to go nearly straight.
+  Scene scene;
+  const Entity planet =
+      scene.Push({0, 0, 0}, {}, Mass{.inertial = 1, .active = 1000});
+  const Entity moon =
+      scene.Push({1000, 0, 0}, {},
+                 Mass{.inertial = 1, .active = 10, .cutoff_distance = 100});
+  const Entity ship = scene.Push({800, 10, 0}, {100, 0, 0});
+
+  ConicPredictor predictor;
+  predictor.Reset(0, 0.1, {ship}, scene.transforms, scene.motion, scene.mass,
+                  scene.flag_index, scene.orbits);
+  EXPECT_EQ(predictor.attractor(0), planet);
+  std::vector<Entity> attractors;
+  for (int i = 1; i <= 40; ++i) {
+    predictor.Advance(i * 0.1f);
+    if (attractors.empty() || attractors.back() != predictor.attractor(0)) {
+      attractors.push_back(predictor.attractor(0));
+    }
+  }
+  EXPECT_THAT(attractors, testing::ElementsAre(planet, moon, planet));
+  EXPECT_EQ(predictor.transitions(), 2);
+  EXPECT_NEAR(predictor.position(0).x, 1200, 5);
+}
+
+TEST(ConicPredictorTest, Orbits) {
+  // A moon orbits the planet, and a satellite orbits the moon. The moon's SOI
+  // radius is 1000 × 0.01^0.4 ≈ 158.
+  Scene scene;
+  const Entity planet =
+      scene.Push({0, 0, 0}, {}, Mass{.inertial = 1, .active = 1e6});
+  const Entity moon = scene.Push({}, {}, Mass{.inertial = 1, .active = 1e4},
+                                 Flags::kOrbiting);
+  const Entity satellite = scene.Push({}, {}, Mass{}, Flags::kOrbiting);
+  scene.orbits.GetOrInit(moon) =
+      Orbit{.id = moon,
+            .epoch{.semi_major_axis = 1000},
+            .delta{.mean_longitude_deg = 10},
+            .parent_id = planet};
+  scene.orbits.GetOrInit(satellite) =
+      Orbit{.id = satellite,
+            .epoch{.semi_major_axis = 50},
+            .delta{.mean_longitude_deg = 90},
+            .parent_id = moon};
+
+  KeplerSolver solver;
+  const Vector3 moon_position = solver.Solve(3, scene.orbits.dense()).Get(0);
+  scene.transforms[moon.value()].position = moon_position;
+  const Entity near = scene.Push(moon_position + Vector3{0, 0, 100}, {});
+  const Entity far = scene.Push(moon_position + Vector3{0, 0, 200}, {});
+
+  ConicPredictor predictor;
+  predictor.Reset(3, 0.1, {satellite, near, far}, scene.transforms,
+                  scene.motion, scene.mass, scene.flag_index, scene.orbits);
+  EXPECT_EQ(predictor.attractor(1), moon);
+  EXPECT_EQ(predictor.attractor(2), planet);
+
+  // The satellite follows its orbit, exactly as the pipeline computes it.
+  for (const float t : {3.0f, 4.0f, 10.0f}) {
+    predictor.Advance(t);
+    const Vector3Array &expected = solver.Solve(t, scene.orbits.dense());
+    EXPECT_EQ(predictor.position(0), expected.Get(1)) << t;
+    EXPECT_EQ(predictor.attractor(0), Entity::Nil());
+  }
+}
+
+}  // namespace
+}  // namespace vstr
@@ -8,14 +8,124 @@
 #ifndef VSTR_SYSTEMS_EVENT_EFFECTS
 #define VSTR_SYSTEMS_EVENT_EFFECTS
 
+#include <cassert>
+
 #include "absl/types/span.h"
+#include "systems/object_pool.h"
+#include "systems/rocket.h"
 #include "types/events.h"
 #include "types/frame.h"
 
 namespace vstr {
 
-void ApplyEventEffects(absl::Span<Event> events, Frame &frame);
+// Applies the effects of events to the frame. Works with any BasicFrame: events
+// that need an optional component the frame type leaves out do nothing, as if
+// no object had that component.
+template <typename FrameType>
+void ApplyEventEffects(absl::Span<Event> events, FrameType &frame);
+
+// Instantiated once, in event_effects.cc.
+extern template void ApplyEventEffects(absl::Span<Event> events, Frame &frame);
+
+namespace event_effects_internal {
+
+template <typename FrameType>
+inline bool IsDestroyed(const Entity id, const FrameType &frame) {
+  return id.Get(frame.flags).value & Flags::kDestroyed;
+}
+
+template <typename FrameType>
+void HandleDestroy(Entity id, FrameType &frame) {
+  if (IsDestroyed(id, frame)) return;
+  id.Get(frame.flags).value |= Flags::kDestroyed;
+  frame.flag_index.Set(id, id.Get(frame.flags));
+  if constexpr (FrameType::template kHas<ReusePool> &&
+                FrameType::template kHas<ReuseTag>) {
+    if (id.Get(frame.flags).value & Flags::kReusable)
+      ReleaseObject(id, frame.flags, frame.reuse_pools, frame.reuse_tags);
+  }
+}
+
+template <typename FrameType>
+void HandleDamage(const Event &event, FrameType &frame) {
+  if constexpr (FrameType::template kHas<Durability>) {
+    if (IsDestroyed(event.id, frame)) return;
+    Durability *durability = event.id.Get(frame.durability);
+    if (durability != nullptr) {
+      durability->value -= event.damage.value;
+      if (durability->value <= 0) HandleDestroy(event.id, frame);
+    }
+  }
+}
 
+}  // namespace event_effects_internal
+
+template <typename FrameType>
+void ApplyEventEffects(absl::Span<Event> events, FrameType &frame) {
+  using namespace event_effects_internal;
+
+  for (const auto &event : events) {
+    switch (event.type) {
+      case Event::kDestruction:
+        HandleDestroy(event.id, frame);
+        break;
+      case Event::kStick:
+        if (event.stick.parent_id != Entity::Nil()) {
+          event.id.Get(frame.flags).value |= Flags::kGlued;
+          event.id.Get(frame.glue).parent_id = event.stick.parent_id;
+        } else {
+          event.id.Get(frame.flags).value &= ~Flags::kGlued;
+          event.id.Get(frame.glue).parent_id = Entity::Nil();
+        }
+        frame.flag_index.Set(event.id, event.id.Get(frame.flags));
+        break;
+      case Event::kDamage: {
+        HandleDamage(event, frame);
+        break;
+      }
+      case Event::kAcceleration:
+        // Nothing to do, acceleration was already used for motion integration.
+        break;
+      case Event::kCollision:
+        // Nothing to do here - collisions effects are already included as other
+        // events.
+        break;
+      case Event::kTeleportation:
+        event.id.Get(frame.transforms).position =
+            event.teleportation.new_position;
+        event.id.Get(frame.motion).new_position =
+            event.teleportation.new_position;
+        event.id.Get(frame.motion).velocity = event.teleportation.new_velocity;
+        event.id.Get(frame.motion).spin = event.teleportation.new_spin;
+        break;
+      case Event::kRocketBurn:
+        assert("RocketBurn should be converted to acceleration by this stage");
+        break;
+      case Event::kRocketRefuel: {
+        if constexpr (FrameType::template kHas<Rocket>) {
+          auto status = ApplyRocketRefuel(event, frame.mass, frame.rockets);
+          assert(status.ok());
+        }
+        break;
+      }
+      case Event::kSpawnAttempt:
+        assert("SpawnAttempt should be converted to Spawn by this stage");
+        break;
+      case Event::kSpawn: {
+        SpawnObject(event, frame);
+        break;
+      }
+      case Event::kTimeTravel:
+        // Needs access to past key frames, so must be handled at the timeline
+        // level.
+        break;
+      default:
+        assert("not reachable");
+        break;
+    }
+  }
 }
 
+}  // namespace vstr
+
 #endif
@@ -11,17 +11,15 @@ namespace vstr {
 
 void GlueSystem::UpdateGluedMotion(const std::vector<Transform> &positions,
                                    const std::vector<Glue> &glue,
-                                   const std::vector<Flags> &flags,
+                                   const FlagIndex &flag_index,
                                    std::vector<Motion> &motion) {
-  const int count = positions.size();
-  for (size_t i = 0; i < count; ++i) {
+  flag_index.ForEach(Flags::kGlued, 0, [&](const size_t i) {
     const Entity parent_id = glue[i].parent_id;
-    if ((flags[i].value & Flags::kGlued) == 0) continue;
     motion[i].velocity = parent_id.Get(motion).velocity;
     motion[i].new_position =
         parent_id.Get(motion).new_position +
         (positions[i].position - parent_id.Get(positions).position);
-  }
+  });
 }
 
 }  // namespace vstr
@@ -8,6 +8,7 @@
 #ifndef VSTR_GLUE_SYSTEM
 #define VSTR_GLUE_SYSTEM
 
+#include "types/flag_index.h"
 #include "types/required_components.h"
 
 namespace vstr {
@@ -16,7 +17,7 @@ class GlueSystem {
  public:
   void UpdateGluedMotion(const std::vector<Transform> &positions,
                          const std::vector<Glue> &glue,
-                         const std::vector<Flags> &flags,
+                         const FlagIndex &flag_index,
                          std::vector<Motion> &motion);
 
  private:
@@ -0,0 +1,99 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "islands.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace vstr {
+
+void Islands::Rebuild(const Vector3Array &positions,
+                      const Attractors &attractors,
+                      const FlagIndex &flag_index,
+                      const NeighborLists *neighbors) {
+  sets_.Reset(positions.size());
+
+  moving_.clear();
+  flag_index.ForEach(0, Flags::kDestroyed | Flags::kGlued | Flags::kOrbiting,
+                     [&](const size_t i) { moving_.push_back(i); });
+
+  // The same test as in AccumulateGravity, which already visits the same pairs
+  // of attractor and moving object, so this costs less than integration.
+  const size_t count = moving_.size();
+  const int32_t *id = moving_.data();
+  const auto in_range = [&](const size_t a, const int32_t id) {
+    const float dx = attractors.position.x[a] - positions.x[id];
+    const float dy = attractors.position.y[a] - positions.y[id];
+    const float dz = attractors.position.z[a] - positions.z[id];
+    const float r_square = dx * dx + dy * dy + dz * dz;
+    return id != attractors.id[a] && r_square > 0 &&
+           r_square <= attractors.cutoff_sqr[a];
+  };
+  if (neighbors != nullptr && neighbors->valid()) {
+    for (size_t i = 0; i < count; ++i) {
+      for (const int32_t a : neighbors->Of(id[i])) {
+        if (in_range(a, id[i])) sets_.Union(attractors.id[a], id[i]);
+      }
+    }
+    return;
+  }
+  for (size_t a = 0; a < attractors.size(); ++a) {
+    for (size_t i = 0; i < count; ++i) {
+      if (in_range(a, id[i])) sets_.Union(attractors.id[a], id[i]);
+    }
+  }
+}
+
+void Islands::Split(const FlagIndex &flag_index, const int tasks,
+                    std::vector<uint8_t> &out, IslandStats &stats) {
+  assert(tasks > 0 && tasks <= 256);
+  roots_.clear();
+  flag_index.ForEach(0, Flags::kDestroyed, [&](const size_t i) {
+    if (sets_.Find(i) == static_cast<int32_t>(i)) roots_.push_back(i);
+  });
+  // Largest first, then by root, so the split is deterministic.
+  std::sort(roots_.begin(), roots_.end(), [this](const int32_t a, int32_t b) {
+    const int32_t size_a = sets_.SetSize(a);
+    const int32_t size_b = sets_.SetSize(b);
+    return size_a > size_b || (size_a == size_b && a < b);
+  });
+
+  task_load_.assign(tasks, 0);
+  root_task_.resize(sets_.size());
+  for (const int32_t root : roots_) {
+    const int task =
+        std::min_element(task_load_.begin(), task_load_.end()) -
+        task_load_.begin();
+    root_task_[root] = task;
+    task_load_[task] += sets_.SetSize(root);
+  }
+
+  out.resize(sets_.size());
+  std::fill(out.begin(), out.end(), 0);
+  flag_index.ForEach(0, Flags::kDestroyed, [&](const size_t i) {
+    out[i] = root_task_[sets_.Find(i)];
+  });
+
+  stats.tasks = tasks;
+  stats.largest_task = *std::max_element(task_load_.begin(), task_load_.end());
+}
+
+void Islands::Count(const FlagIndex &flag_index, IslandStats &stats) {
+  stats.islands = 0;
+  stats.largest = 0;
+  stats.singletons = 0;
+  flag_index.ForEach(0, Flags::kDestroyed, [&](const size_t i) {
+    if (sets_.Find(i) != static_cast<int32_t>(i)) return;
+    const int32_t size = sets_.SetSize(i);
+    ++stats.islands;
+    stats.largest = std::max(stats.largest, size);
+    if (size == 1) ++stats.singletons;
+  });
+}
+
+}  // namespace vstr
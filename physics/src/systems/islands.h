@@ -0,0 +1,84 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_ISLANDS
+#define VSTR_ISLANDS
+
+#include <cstdint>
+#include <vector>
+
+#include "dsa/union_find.h"
+#include "systems/motion.h"
+#include "systems/neighbor_lists.h"
+#include "types/flag_index.h"
+#include "types/kinematics.h"
+
+namespace vstr {
+
+// What the islands looked like in the last frame, for tuning.
+struct IslandStats {
+  // Islands of objects that aren't destroyed, joined by gravity and by
+  // broadphase pairs. An island of one object is a singleton.
+  int islands;
+  int largest;
+  int singletons;
+  // The number of tasks the islands were split between, and the number of
+  // objects in the busiest task. (Broadphase pairs aren't known yet when
+  // islands are split, so they don't count here.)
+  int tasks;
+  int largest_task;
+  // Time spent finding and splitting islands.
+  uint64_t nanos;
+};
+
+// Groups objects into interaction islands: sets of objects that affect each
+// other's motion, directly or indirectly. An attractor and every moving object
+// within its cutoff distance are in the same island, so the motion of an
+// island only depends on the attractors in it, and islands can be integrated
+// independently (see MotionRegion::local_attractors).
+//
+// Reuses its storage between frames.
+class Islands {
+ public:
+  // Puts every object in an island of its own, then joins each attractor with
+  // the moving objects it pulls on. Uses the same test as the motion system, so
+  // the result is exact. With valid neighbor lists, only tests the attractors
+  // on them (and they must hold the same attractors).
+  void Rebuild(const Vector3Array &positions, const Attractors &attractors,
+               const FlagIndex &flag_index,
+               const NeighborLists *neighbors = nullptr);
+
+  // Joins the islands of a and b. The pipeline uses this for broadphase pairs.
+  inline void Join(const Entity a, const Entity b) {
+    sets_.Union(a.value(), b.value());
+  }
+
+  // Returns the same value for objects in the same island.
+  inline int32_t Find(const Entity id) { return sets_.Find(id.value()); }
+
+  // Assigns each island to one of the tasks, largest islands first, each to
+  // the task with the fewest objects so far. Writes the task of each object to
+  // out (destroyed objects go in task 0), and updates stats.tasks and
+  // stats.largest_task. At most 256 tasks.
+  void Split(const FlagIndex &flag_index, int tasks, std::vector<uint8_t> &out,
+             IslandStats &stats);
+
+  // Updates stats.islands, stats.largest and stats.singletons.
+  void Count(const FlagIndex &flag_index, IslandStats &stats);
+
+ private:
+  UnionFind sets_;
+  std::vector<int32_t> moving_;
+  // Roots of islands, and the task of each root.
+  std::vector<int32_t> roots_;
+  std::vector<uint8_t> root_task_;
+  std::vector<int> task_load_;
+};
+
+}  // namespace vstr
+
+#endif
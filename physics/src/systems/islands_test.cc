@@ -0,0 +1,147 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "islands.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <random>
+
+namespace vstr {
+namespace {
+
+TEST(IslandsTest, Basic) {
+  // Two stars with a cutoff, each with a rock in reach. Rock 4 is out of
+  // everyone's reach, and object 5 is destroyed.
+  std::vector<Transform> transforms{
+      Transform{Vector3{0, 0, 0}},   Transform{Vector3{5, 0, 0}},
+      Transform{Vector3{100, 0, 0}}, Transform{Vector3{100, 5, 0}},
+      Transform{Vector3{50, 0, 0}},  Transform{Vector3{1, 0, 0}},
+  };
+  std::vector<Motion> motion(transforms.size());
+  std::vector<Mass> mass{
+      Mass{.inertial = 1, .active = 100, .cutoff_distance = 10},
+      Mass{.inertial = 1},
+      Mass{.inertial = 1, .active = 100, .cutoff_distance = 10},
+      Mass{.inertial = 1},
+      Mass{.inertial = 1},
+      Mass{.inertial = 1},
+  };
+  std::vector<Flags> flags(transforms.size());
+  flags[5].value = Flags::kDestroyed;
+
+  Kinematics kinematics;
+  kinematics.Load(transforms, motion);
+  FlagIndex flag_index;
+  flag_index.Rebuild(flags);
+  Attractors attractors;
+  attractors.Rebuild(kinematics.position, mass, flag_index);
+
+  Islands islands;
+  islands.Rebuild(kinematics.position, attractors, flag_index);
+  EXPECT_EQ(islands.Find(Entity(0)), islands.Find(Entity(1)));
+  EXPECT_EQ(islands.Find(Entity(2)), islands.Find(Entity(3)));
+  EXPECT_NE(islands.Find(Entity(0)), islands.Find(Entity(2)));
+  EXPECT_NE(islands.Find(Entity(4)), islands.Find(Entity(0)));
+  EXPECT_NE(islands.Find(Entity(5)), islands.Find(Entity(0)));
+
+  // The two pairs go to different tasks, and the lone rock joins the first.
+  IslandStats stats{};
+  std::vector<uint8_t> tasks;
+  islands.Split(flag_index, 2, tasks, stats);
+  EXPECT_THAT(tasks, testing::ElementsAre(0, 0, 1, 1, 0, 0));
+  EXPECT_EQ(stats.tasks, 2);
+  EXPECT_EQ(stats.largest_task, 3);
+
+  islands.Count(flag_index, stats);
+  EXPECT_EQ(stats.islands, 3);
+  EXPECT_EQ(stats.largest, 2);
+  EXPECT_EQ(stats.singletons, 1);
+
+  // Joining a broadphase pair merges the islands.
+  islands.Join(Entity(4), Entity(3));
+  islands.Count(flag_index, stats);
+  EXPECT_EQ(stats.islands, 2);
+  EXPECT_EQ(stats.largest, 3);
+  EXPECT_EQ(stats.singletons, 0);
+}
+
+// Integrating each task separately, with only the attractors in it, must give
+// exactly the same result as integrating everything at once. Yoshida isn't
+// covered: the pipeline doesn't split it into islands.
+TEST(IslandsTest, TasksMatchWholeScene) {
+  std::mt19937 random_generator;
+  std::uniform_real_distribution<float> position_rg(-1000, 1000);
+  std::uniform_real_distribution<float> velocity_rg(-10, 10);
+  std::uniform_real_distribution<float> mass_rg(0, 1000);
+
+  std::vector<Transform> transforms;
+  std::vector<Motion> motion;
+  std::vector<Mass> mass;
+  std::vector<Flags> flags;
+  for (int i = 0; i < 500; ++i) {
+    transforms.push_back(Transform{Vector3{position_rg(random_generator),
+                                           position_rg(random_generator),
+                                           position_rg(random_generator)}});
+    const Vector3 velocity{velocity_rg(random_generator),
+                           velocity_rg(random_generator),
+                           velocity_rg(random_generator)};
+    motion.push_back(Motion{.velocity = velocity});
+    // Every tenth object pulls on things within 200 units.
+    mass.push_back(Mass{.inertial = 1,
+                        .active = (i % 10) ? 0 : mass_rg(random_generator),
+                        .cutoff_distance = 200});
+    flags.push_back(Flags{i % 7 == 0 ? Flags::kOrbiting : 0u});
+  }
+  std::vector<Event> input{
+      Event(Entity(3), Vector3{}, Acceleration{Vector3{1, 0, 0}}),
+  };
+
+  FlagIndex flag_index;
+  flag_index.Rebuild(flags);
+
+  for (const IntegrationMethod integrator :
+       {kFirstOrderEuler, kVelocityVerlet}) {
+    std::vector<Motion> expected = motion;
+    MotionBuffers buffers;
+    buffers.kinematics.Load(transforms, expected);
+    IntegrateMotion(integrator, 0.1, absl::MakeSpan(input), mass, flag_index,
+                    buffers, expected);
+
+    std::vector<Motion> got = motion;
+    Kinematics kinematics;
+    kinematics.Load(transforms, got);
+    Attractors attractors;
+    attractors.Rebuild(kinematics.position, mass, flag_index);
+    Islands islands;
+    islands.Rebuild(kinematics.position, attractors, flag_index);
+    IslandStats stats{};
+    std::vector<uint8_t> tasks;
+    islands.Split(flag_index, 4, tasks, stats);
+    islands.Count(flag_index, stats);
+    EXPECT_GT(stats.islands, 4);
+
+    MotionBuffers scratch;
+    for (int task = 0; task < 4; ++task) {
+      IntegrateMotion(integrator, 0.1, absl::MakeSpan(input), mass, flag_index,
+                      MotionRegion{.regions = &tasks,
+                                   .region = static_cast<uint8_t>(task),
+                                   .local_attractors = true},
+                      kinematics, scratch, got);
+    }
+
+    for (size_t i = 0; i < motion.size(); ++i) {
+      EXPECT_EQ(got[i].velocity, expected[i].velocity) << i;
+      EXPECT_EQ(got[i].new_position, expected[i].new_position) << i;
+      EXPECT_EQ(got[i].acceleration, expected[i].acceleration) << i;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace vstr
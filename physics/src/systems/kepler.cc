@@ -7,7 +7,107 @@
 
 #include "kepler.h"
 
+#include <limits>
+
 namespace vstr {
+namespace {
+
+constexpr float kRadiansPerDeg = 0.0174532924;
+constexpr float kTwoPi = 360 * kRadiansPerDeg;
+
+// Fixed number of Halley iterations in KeplerSolver. Starting from Danby's
+// guess, four are enough to reach float precision for e <= 0.99.
+constexpr int kHalleyIterations = 4;
+constexpr float kHalleyMaxEccentricity = 0.99;
+// More eccentric orbits iterate until the step is this small, or up to the
+// cap. Same as EllipticalPosition.
+constexpr float kKeplerTolerance = 1e-6;
+constexpr int kKeplerMaxIterations = 100;
+
+// Rounds half away from zero. Unlike std::round, this is not a library call.
+inline int RoundToInt(const float x) {
+  return static_cast<int>(x + (x < 0 ? -0.5f : 0.5f));
+}
+
+// Sine and cosine of x, to within about 6e-8 for small x. Unlike std::sinf and
+// std::cosf, this has no branches or calls, so loops over it vectorize. Uses
+// the Cephes polynomials, after reducing x to [-π/4, π/4] by multiples of π/2.
+inline void SinCos(const float x, float &sin_x, float &cos_x) {
+  const int quadrant = RoundToInt(x * 0.636619772f);
+  const float n = quadrant;
+  // π/2 split into three parts, so that the reduction stays exact.
+  const float r = ((x - n * 1.5703125f) - n * 4.837512969970703125e-4f) -
+                  n * 7.54978995489188216e-8f;
+  const float z = r * r;
+  const float s =
+      r + r * z *
+              (-1.6666654611e-1f +
+               z * (8.3321608736e-3f + z * -1.9515295891e-4f));
+  const float c =
+      1.0f - 0.5f * z +
+      z * z *
+          (4.166664568298827e-2f +
+           z * (-1.388731625493765e-3f + z * 2.443315711809948e-5f));
+  const int j = quadrant & 3;
+  sin_x = j == 0 ? s : j == 1 ? c : j == 2 ? -s : -c;
+  cos_x = j == 0 ? c : j == 1 ? -s : j == 2 ? -c : s;
+}
+
+// out = focus + p × plane_x + q × plane_y, for one axis.
+void Rotate(const size_t count, const float *focus, const float *p,
+            const float *q, const float *plane_x, const float *plane_y,
+            float *out) {
+  for (size_t k = 0; k < count; ++k) {
+    out[k] = focus[k] + p[k] * plane_x[k] + q[k] * plane_y[k];
+  }
+}
+
+inline float Snap(const float degrees, const float tolerance) {
+  return tolerance > 0 ? std::round(degrees / tolerance) * tolerance : degrees;
+}
+
+// Sets parent[k] to the index of orbit k's parent, or -1, and lists the orbits
+// that have a parent in order, each after its parent. Walks up from each orbit
+// until an ancestor that's already in order, then adds the chain top-down.
+// Running into the chain itself means a cycle, which is broken at the top. The
+// other vectors are scratch space.
+void OrderHierarchy(absl::Span<const Orbit> orbits,
+                    std::vector<int32_t> &parent, std::vector<int32_t> &order,
+                    std::vector<int32_t> &index, std::vector<uint8_t> &visited,
+                    std::vector<int32_t> &chain) {
+  const size_t count = orbits.size();
+  index.clear();
+  for (size_t k = 0; k < count; ++k) {
+    const int32_t id = orbits[k].id.value();
+    if (id < 0) continue;
+    if (id >= static_cast<int32_t>(index.size())) index.resize(id + 1, -1);
+    index[id] = k;
+  }
+  parent.resize(count);
+  for (size_t k = 0; k < count; ++k) {
+    const int32_t id = orbits[k].parent_id.value();
+    parent[k] =
+        id >= 0 && id < static_cast<int32_t>(index.size()) ? index[id] : -1;
+  }
+
+  order.clear();
+  visited.assign(count, 0);
+  for (size_t k = 0; k < count; ++k) {
+    chain.clear();
+    int32_t j = k;
+    for (; j >= 0 && visited[j] == 0; j = parent[j]) {
+      visited[j] = 1;
+      chain.push_back(j);
+    }
+    if (j >= 0 && visited[j] == 1) parent[chain.back()] = -1;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+      visited[*it] = 2;
+      if (parent[*it] >= 0) order.push_back(*it);
+    }
+  }
+}
+
+}  // namespace
 
 Vector3 EllipticalPosition(const Orbit::Kepler &kepler) {
   // It's called elliptical position. We don't take kindly to no parabolas or
@@ -18,7 +118,6 @@ Vector3 EllipticalPosition(const Orbit::Kepler &kepler) {
 
   // For explanation, see: https://ssd.jpl.nasa.gov/txt/aprx_pos_planets.pdf
 
-  constexpr float kRadiansPerDeg = 0.0174532924;
   // Everything should be in radians for simplicity. These symbols are chosen to
   // match with literature on Kepler orbits (such as the link above).
   const float a = kepler.semi_major_axis;
@@ -53,7 +152,8 @@ Vector3 EllipticalPosition(const Orbit::Kepler &kepler) {
   float x_ = a * (std::cosf(E) - e);
   float y_ = a * std::sqrtf(1 - e * e) * std::sinf(E);
 
-  // Now rotate to the inclined orbital plane.
+  // Now rotate to the inclined orbital plane. (KeplerSolver::UpdateBasis must
+  // match this.)
   float x = (std::cosf(ω) * std::cosf(Ω) -
              std::sinf(ω) * std::sinf(Ω) * std::cosf(I)) *
                 x_ +
@@ -73,15 +173,196 @@ Vector3 EllipticalPosition(const Orbit::Kepler &kepler) {
 
 void UpdateOrbitalMotion(const float t,
                          const std::vector<Transform> &transforms,
-                         const std::vector<Orbit> &orbits,
+                         const SparseSet<Orbit> &orbits,
                          std::vector<Motion> &motion) {
+  std::vector<Vector3> positions;
+  positions.reserve(orbits.size());
   for (const auto &orbit : orbits) {
     const Orbit::Kepler current = orbit.epoch + orbit.delta * t;
-    orbit.id.Get(motion).new_position =
-        orbit.focus + EllipticalPosition(current);
+    positions.push_back(orbit.focus + EllipticalPosition(current));
+  }
+
+  // Parents come first, so their positions are already final. Cycles are
+  // broken the same way as in KeplerSolver.
+  std::vector<int32_t> parent;
+  std::vector<int32_t> order;
+  std::vector<int32_t> index;
+  std::vector<uint8_t> visited;
+  std::vector<int32_t> chain;
+  OrderHierarchy(orbits.dense(), parent, order, index, visited, chain);
+  for (const int32_t k : order) positions[k] += positions[parent[k]];
+
+  size_t k = 0;
+  for (const auto &orbit : orbits) {
+    orbit.id.Get(motion).new_position = positions[k++];
     orbit.id.Get(motion).velocity =
         orbit.id.Get(motion).new_position - orbit.id.Get(transforms).position;
   }
 }
 
+const Vector3Array &KeplerSolver::Solve(const float t,
+                                        absl::Span<const Orbit> orbits) {
+  const size_t count = orbits.size();
+  semi_major_axis_.resize(count);
+  semi_minor_axis_.resize(count);
+  eccentricity_.resize(count);
+  mean_anomaly_.resize(count);
+  plane_x_.resize(count);
+  plane_y_.resize(count);
+  focus_.resize(count);
+  p_.resize(count);
+  q_.resize(count);
+  positions_.resize(count);
+  // NaN never compares equal, so new orbits get a basis.
+  constexpr float kNaN = std::numeric_limits<float>::quiet_NaN();
+  basis_key_.resize(count, BasisKey{kNaN, kNaN, kNaN});
+
+  // Advance the elements to t and copy them into columns. Orbits that aren't
+  // elliptical get zero axes, which puts them at the focus, same as
+  // EllipticalPosition.
+  high_eccentricity_.clear();
+  for (size_t k = 0; k < count; ++k) {
+    const Orbit &orbit = orbits[k];
+    const Orbit::Kepler current = orbit.epoch + orbit.delta * t;
+    const float e = current.eccentricity;
+    const bool elliptical = e < 1 && e >= 0;
+    semi_major_axis_[k] = elliptical ? current.semi_major_axis : 0;
+    semi_minor_axis_[k] =
+        elliptical ? current.semi_major_axis * std::sqrt(1 - e * e) : 0;
+    eccentricity_[k] = elliptical ? e : 0;
+    if (elliptical && e > kHalleyMaxEccentricity) {
+      high_eccentricity_.push_back(k);
+    }
+    // Unlike EllipticalPosition, this defers reducing the mean anomaly to
+    // [-π, π] to the solver loop. Kepler's equation has a period of 2π in
+    // both anomalies, so the position is the same.
+    mean_anomaly_[k] = current.mean_longitude_deg * kRadiansPerDeg -
+                       current.longitude_of_perihelion_deg * kRadiansPerDeg -
+                       kTwoPi / 2;
+    focus_.Set(k, orbit.focus);
+
+    const BasisKey key{
+        Snap(current.longitude_of_perihelion_deg, basis_tolerance_),
+        Snap(current.longitude_of_ascending_node_deg, basis_tolerance_),
+        Snap(current.inclination_deg, basis_tolerance_),
+    };
+    if (!(key == basis_key_[k])) UpdateBasis(k, key);
+  }
+
+  // Solve M = E - e × sin(E) for E, to get the position in the orbital plane.
+  const float *semi_major_axis = semi_major_axis_.data();
+  const float *semi_minor_axis = semi_minor_axis_.data();
+  const float *eccentricity = eccentricity_.data();
+  const float *mean_anomaly = mean_anomaly_.data();
+  float *plane_x = plane_x_.data();
+  float *plane_y = plane_y_.data();
+  for (size_t k = 0; k < count; ++k) {
+    const float e = eccentricity[k];
+    const float M = mean_anomaly[k] -
+                    RoundToInt(mean_anomaly[k] * (1 / kTwoPi)) * kTwoPi;
+    float E = M + (M < 0 ? -0.85f : 0.85f) * e;
+    float sin_E;
+    float cos_E;
+    for (int i = 0; i < kHalleyIterations; ++i) {
+      SinCos(E, sin_E, cos_E);
+      const float f = E - e * sin_E - M;
+      const float df = 1 - e * cos_E;
+      E -= f * df / (df * df - 0.5f * f * e * sin_E);
+    }
+    SinCos(E, sin_E, cos_E);
+    plane_x[k] = semi_major_axis[k] * (cos_E - e);
+    plane_y[k] = semi_minor_axis[k] * sin_E;
+  }
+
+  // Close to e = 1, the fixed iterations aren't enough near the periapsis, so
+  // the few orbits that eccentric start over and iterate until converged.
+  for (const int32_t k : high_eccentricity_) {
+    const float e = eccentricity[k];
+    const float M = mean_anomaly[k] -
+                    RoundToInt(mean_anomaly[k] * (1 / kTwoPi)) * kTwoPi;
+    float E = M + (M < 0 ? -0.85f : 0.85f) * e;
+    float sin_E;
+    float cos_E;
+    for (int i = 0; i < kKeplerMaxIterations; ++i) {
+      SinCos(E, sin_E, cos_E);
+      const float f = E - e * sin_E - M;
+      const float df = 1 - e * cos_E;
+      const float dE = f * df / (df * df - 0.5f * f * e * sin_E);
+      E -= dE;
+      if (std::abs(dE) < kKeplerTolerance) break;
+    }
+    SinCos(E, sin_E, cos_E);
+    plane_x[k] = semi_major_axis[k] * (cos_E - e);
+    plane_y[k] = semi_minor_axis[k] * sin_E;
+  }
+
+  // Rotate by the basis, one axis at a time. (With all three in one loop, the
+  // compiler gives up on proving the columns don't overlap.)
+  Rotate(count, focus_.x.data(), p_.x.data(), q_.x.data(), plane_x, plane_y,
+         positions_.x.data());
+  Rotate(count, focus_.y.data(), p_.y.data(), q_.y.data(), plane_x, plane_y,
+         positions_.y.data());
+  Rotate(count, focus_.z.data(), p_.z.data(), q_.z.data(), plane_x, plane_y,
+         positions_.z.data());
+
+  // Parents come first, so their positions are already final.
+  UpdateHierarchy(orbits);
+  for (const int32_t k : order_) {
+    const int32_t parent = parent_[k];
+    positions_.x[k] += positions_.x[parent];
+    positions_.y[k] += positions_.y[parent];
+    positions_.z[k] += positions_.z[parent];
+  }
+  return positions_;
+}
+
+void KeplerSolver::UpdateHierarchy(absl::Span<const Orbit> orbits) {
+  const size_t count = orbits.size();
+  bool changed = hierarchy_key_.size() != count;
+  hierarchy_key_.resize(count);
+  for (size_t k = 0; k < count; ++k) {
+    const std::pair<Entity, Entity> key{orbits[k].id, orbits[k].parent_id};
+    if (key == hierarchy_key_[k]) continue;
+    hierarchy_key_[k] = key;
+    changed = true;
+  }
+  if (!changed) return;
+  OrderHierarchy(orbits, parent_, order_, index_, visited_, chain_);
+}
+
+void KeplerSolver::UpdateBasis(const size_t k, const BasisKey &key) {
+  ++basis_updates_;
+  basis_key_[k] = key;
+
+  // Same as in EllipticalPosition.
+  const float perihelion = key.longitude_of_perihelion_deg * kRadiansPerDeg;
+  const float node = key.longitude_of_ascending_node_deg * kRadiansPerDeg;
+  const float inclination = key.inclination_deg * kRadiansPerDeg;
+  const float argument = perihelion - node;
+
+  const float cos_w = std::cos(argument);
+  const float sin_w = std::sin(argument);
+  const float cos_o = std::cos(node);
+  const float sin_o = std::sin(node);
+  const float cos_i = std::cos(inclination);
+  const float sin_i = std::sin(inclination);
+  p_.Set(k, Vector3{cos_w * cos_o - sin_w * sin_o * cos_i,
+                    cos_w * sin_o - sin_w * cos_o * cos_i, sin_w * sin_i});
+  q_.Set(k, Vector3{-sin_w * cos_o - cos_w * sin_o * cos_i,
+                    -sin_w * sin_o - cos_w * cos_o * cos_i, cos_w * sin_i});
+}
+
+void UpdateOrbitalMotion(KeplerSolver &solver, const float t,
+                         const std::vector<Transform> &transforms,
+                         const SparseSet<Orbit> &orbits,
+                         std::vector<Motion> &motion) {
+  const Vector3Array &positions = solver.Solve(t, orbits.dense());
+  size_t k = 0;
+  for (const auto &orbit : orbits) {
+    Motion &m = orbit.id.Get(motion);
+    m.new_position = positions.Get(k++);
+    m.velocity = m.new_position - orbit.id.Get(transforms).position;
+  }
+}
+
 }  // namespace vstr
\ No newline at end of file
@@ -10,11 +10,15 @@
 #ifndef VSTR_ORBIT
 #define VSTR_ORBIT
 
+#include <absl/types/span.h>
 #include <assert.h>
 
 #include <cmath>
+#include <utility>
+#include <vector>
 
 #include "geometry/vector3.h"
+#include "types/kinematics.h"
 #include "types/optional_components.h"
 #include "types/required_components.h"
 
@@ -23,11 +27,100 @@ namespace vstr {
 // Solve the Kepler equations to return the object's position.
 Vector3 EllipticalPosition(const Orbit::Kepler &kepler);
 
+// Solves the Kepler equations for many orbits at once. The results agree with
+// EllipticalPosition to within float precision, but it's a lot faster:
+//
+// - The elements are copied into SoA columns and solved in loops without
+//   branches or library calls, which the compiler can vectorize.
+// - Instead of Newton's method with a convergence test, it runs a fixed number
+//   of Halley iterations, starting from Danby's guess. That converges for
+//   eccentricities up to 0.99. More eccentric orbits are solved again in a
+//   second pass, which iterates until converged.
+// - The rotation into the inclined orbital plane (the basis) only depends on
+//   three angles. It's cached per orbit, and only recomputed when they change.
+// - Moons are placed relative to their parent in topological order, which is
+//   cached until the hierarchy changes.
+//
+// The results only depend on the orbits and t, not on what was solved before.
+class KeplerSolver {
+ public:
+  // Returns the position of each orbit at time t, including the focus and the
+  // parent's position, in the same order. Only parents that are among the
+  // orbits count. The result stays valid until the next call.
+  const Vector3Array &Solve(float t, absl::Span<const Orbit> orbits);
+
+  // Rounds the angles that determine the basis to multiples of this many
+  // degrees, so that it needs to be recomputed less often when the delta moves
+  // them. The position can then be off by up to half the tolerance, in
+  // radians, times the semi-major axis. With zero (the default), the angles
+  // are used as they are, and the basis is only recomputed when they change.
+  inline void set_basis_tolerance(const float degrees) {
+    assert(degrees >= 0);
+    basis_tolerance_ = degrees;
+    basis_key_.clear();
+  }
+  inline float basis_tolerance() const { return basis_tolerance_; }
+
+  // How many times a basis was computed, for tuning the tolerance.
+  inline int basis_updates() const { return basis_updates_; }
+
+ private:
+  // The angles a basis was computed for, in degrees.
+  struct BasisKey {
+    float longitude_of_perihelion_deg;
+    float longitude_of_ascending_node_deg;
+    float inclination_deg;
+
+    bool operator==(const BasisKey &) const = default;
+  };
+
+  void UpdateBasis(size_t k, const BasisKey &key);
+  void UpdateHierarchy(absl::Span<const Orbit> orbits);
+
+  float basis_tolerance_ = 0;
+  int basis_updates_ = 0;
+
+  // Per orbit, in the order of the last Solve.
+  std::vector<float> semi_major_axis_;
+  std::vector<float> semi_minor_axis_;
+  std::vector<float> eccentricity_;
+  std::vector<float> mean_anomaly_;
+  // Orbits with e > 0.99, for the second pass.
+  std::vector<int32_t> high_eccentricity_;
+  // Position in the orbital plane, relative to the focus.
+  std::vector<float> plane_x_;
+  std::vector<float> plane_y_;
+  Vector3Array focus_;
+  // The basis: positions in the orbital plane are rotated by x' × p + y' × q.
+  Vector3Array p_;
+  Vector3Array q_;
+  std::vector<BasisKey> basis_key_;
+  Vector3Array positions_;
+
+  // Each orbit's id and parent_id, as of the last UpdateHierarchy.
+  std::vector<std::pair<Entity, Entity>> hierarchy_key_;
+  // Index of each orbit's parent, or -1.
+  std::vector<int32_t> parent_;
+  // Orbits that have a parent, after their parent.
+  std::vector<int32_t> order_;
+  // Scratch space for UpdateHierarchy.
+  std::vector<int32_t> index_;
+  std::vector<uint8_t> visited_;
+  std::vector<int32_t> chain_;
+};
+
 // Compute the orbital position at time 't' for each object in orbit, and store
 // the results in Motion.next_position. (See UpdatePositions for the pipeline
-// step that works with next_position.)
+// step that works with next_position.) Moons are placed relative to where their
+// parent is at 't' on its own orbit.
 void UpdateOrbitalMotion(float t, const std::vector<Transform> &positions,
-                         const std::vector<Orbit> &orbits,
+                         const SparseSet<Orbit> &orbits,
+                         std::vector<Motion> &motion);
+
+// Same as above, but solves all the orbits at once with the solver.
+void UpdateOrbitalMotion(KeplerSolver &solver, float t,
+                         const std::vector<Transform> &positions,
+                         const SparseSet<Orbit> &orbits,
                          std::vector<Motion> &motion);
 
 }  // namespace vstr
@@ -0,0 +1,84 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+#include "kepler.h"
+
+namespace vstr {
+namespace {
+
+constexpr float kDeltaTime = 1.0f / 60;
+
+struct Scene {
+  std::vector<Transform> transforms;
+  std::vector<Motion> motion;
+  SparseSet<Orbit> orbits;
+};
+
+// Every object orbits, on a random ellipse.
+Scene Generate(const int size) {
+  std::mt19937 random_generator;
+  std::uniform_real_distribution<float> axis_rg(1, 1e4);
+  std::uniform_real_distribution<float> e_rg(0, 0.9);
+  std::uniform_real_distribution<float> angle_rg(0, 360);
+
+  Scene scene;
+  scene.transforms.resize(size);
+  scene.motion.resize(size);
+  for (int i = 0; i < size; ++i) {
+    Orbit &orbit = scene.orbits.GetOrInit(Entity(i));
+    orbit.epoch = Orbit::Kepler{
+        .semi_major_axis = axis_rg(random_generator),
+        .eccentricity = e_rg(random_generator),
+        .mean_longitude_deg = angle_rg(random_generator),
+        .longitude_of_perihelion_deg = angle_rg(random_generator),
+        .longitude_of_ascending_node_deg = angle_rg(random_generator),
+        .inclination_deg = angle_rg(random_generator),
+    };
+    orbit.delta.mean_longitude_deg = 1;
+  }
+  return scene;
+}
+
+void BM_UpdateOrbitalMotionScalar(benchmark::State &state) {
+  Scene scene = Generate(state.range(0));
+  int frame_no = 0;
+  for (auto _ : state) {
+    UpdateOrbitalMotion(kDeltaTime * ++frame_no, scene.transforms,
+                        scene.orbits, scene.motion);
+    benchmark::DoNotOptimize(scene.motion.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UpdateOrbitalMotionScalar)
+    ->RangeMultiplier(10)
+    ->Range(1000, 100000)
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_UpdateOrbitalMotionBatch(benchmark::State &state) {
+  Scene scene = Generate(state.range(0));
+  KeplerSolver solver;
+  int frame_no = 0;
+  for (auto _ : state) {
+    UpdateOrbitalMotion(solver, kDeltaTime * ++frame_no, scene.transforms,
+                        scene.orbits, scene.motion);
+    benchmark::DoNotOptimize(scene.motion.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UpdateOrbitalMotionBatch)
+    ->RangeMultiplier(10)
+    ->Range(1000, 100000)
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+}  // namespace vstr
+
+BENCHMARK_MAIN();
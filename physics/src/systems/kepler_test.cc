@@ -0,0 +1,245 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "kepler.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace vstr {
+namespace {
+
+std::vector<Orbit> GenerateOrbits(const int count, const float max_e) {
+  std::mt19937 random_generator;
+  std::uniform_real_distribution<float> axis_rg(1, 1e4);
+  std::uniform_real_distribution<float> e_rg(0, max_e);
+  std::uniform_real_distribution<float> angle_rg(-360, 360);
+  std::uniform_real_distribution<float> speed_rg(-10, 10);
+
+  std::vector<Orbit> orbits;
+  for (int i = 0; i < count; ++i) {
+    orbits.push_back(Orbit{
+        .id = Entity(i),
+        .focus = Vector3{axis_rg(random_generator), 0, 0},
+        .epoch =
+            Orbit::Kepler{
+                .semi_major_axis = axis_rg(random_generator),
+                .eccentricity = e_rg(random_generator),
+                .mean_longitude_deg = angle_rg(random_generator),
+                .longitude_of_perihelion_deg = angle_rg(random_generator),
+                .longitude_of_ascending_node_deg = angle_rg(random_generator),
+                .inclination_deg = angle_rg(random_generator),
+            },
+        .delta =
+            Orbit::Kepler{.mean_longitude_deg = speed_rg(random_generator)},
+    });
+  }
+  return orbits;
+}
+
+// How far the batch solver may be from the scalar one. Both reduce the mean
+// anomaly differently, so they can disagree by a few ulp of the mean longitude,
+// on top of the scalar solver's convergence test (1e-6 radians). Near the
+// periapsis, an error in the mean anomaly moves the position by up to 2a / (1 -
+// e) times as much. Finally, the position itself is only a float.
+float Tolerance(const Orbit &orbit, const float t) {
+  const Orbit::Kepler current = orbit.epoch + orbit.delta * t;
+  const float a = current.semi_major_axis;
+  const float e = current.eccentricity;
+  const float mean_anomaly = std::abs(current.mean_longitude_deg -
+                                      current.longitude_of_perihelion_deg) *
+                             0.0174532924;
+  const float angle_error =
+      2e-6 + 4 * std::numeric_limits<float>::epsilon() * mean_anomaly;
+  return angle_error * 2 * a / (1 - e) +
+         1e-5 * (a + Vector3::Magnitude(orbit.focus));
+}
+
+TEST(KeplerSolverTest, MatchesScalar) {
+  const std::vector<Orbit> orbits = GenerateOrbits(1000, 0.9);
+  KeplerSolver solver;
+  for (const float t : {0.0f, 1.0f, 17.5f, 1000.0f}) {
+    const Vector3Array &got = solver.Solve(t, orbits);
+    ASSERT_EQ(got.size(), orbits.size());
+    for (size_t k = 0; k < orbits.size(); ++k) {
+      const Orbit &orbit = orbits[k];
+      const Vector3 expected =
+          orbit.focus + EllipticalPosition(orbit.epoch + orbit.delta * t);
+      const float error = Vector3::Magnitude(got.Get(k) - expected);
+      ASSERT_LE(error, Tolerance(orbit, t))
+          << t << " " << k << " " << orbit.epoch;
+    }
+  }
+
+  // Only the mean longitude moves, so each basis was only computed once.
+  EXPECT_EQ(solver.basis_updates(), static_cast<int>(orbits.size()));
+}
+
+TEST(KeplerSolverTest, HighEccentricity) {
+  // Past e = 0.99, the fixed iterations stop short close to the periapsis.
+  // Positions there are too sensitive to compare against EllipticalPosition,
+  // so this recovers the eccentric anomaly from the position instead (with all
+  // angles zero, it's in the xy plane, with y mirrored), and checks that it
+  // solves Kepler's equation.
+  std::vector<Orbit> orbits;
+  for (const float e : {0.991f, 0.995f, 0.999f, 0.9999f}) {
+    for (int i = -1000; i <= 1000; ++i) {
+      orbits.push_back(Orbit{.epoch{.semi_major_axis = 1000,
+                                    .eccentricity = e,
+                                    .mean_longitude_deg = 180 + i * 1e-5f}});
+    }
+  }
+  KeplerSolver solver;
+  const Vector3Array &got = solver.Solve(0, orbits);
+  for (size_t k = 0; k < orbits.size(); ++k) {
+    const Orbit::Kepler &kepler = orbits[k].epoch;
+    const double e = kepler.eccentricity;
+    const double a = kepler.semi_major_axis;
+    const double b = a * std::sqrt(1 - e * e);
+    const Vector3 position = got.Get(k);
+    const double E = std::atan2(-position.y / b, position.x / a + e);
+    const double M = (kepler.mean_longitude_deg - 180.0) * 0.0174532924f;
+    ASSERT_NEAR(E - e * std::sin(E), M, 1e-6) << k << " " << kepler;
+  }
+}
+
+TEST(KeplerSolverTest, NotElliptical) {
+  const std::vector<Orbit> orbits{
+      Orbit{.focus = Vector3{1, 2, 3}, .epoch{.eccentricity = 1}},
+      Orbit{.focus = Vector3{1, 2, 3}, .epoch{.eccentricity = -0.5}},
+  };
+  KeplerSolver solver;
+  const Vector3Array &got = solver.Solve(0, orbits);
+  EXPECT_EQ(got.Get(0), (Vector3{1, 2, 3}));
+  EXPECT_EQ(got.Get(1), (Vector3{1, 2, 3}));
+}
+
+TEST(KeplerSolverTest, BasisTolerance) {
+  std::vector<Orbit> orbits = GenerateOrbits(100, 0.5);
+  for (Orbit &orbit : orbits) {
+    orbit.delta.longitude_of_ascending_node_deg = 0.01;
+  }
+
+  KeplerSolver solver;
+  solver.set_basis_tolerance(0.1);
+  KeplerSolver fresh;
+  fresh.set_basis_tolerance(0.1);
+  for (int frame_no = 0; frame_no < 100; ++frame_no) {
+    const float t = frame_no;
+    const Vector3Array &got = solver.Solve(t, orbits);
+    for (size_t k = 0; k < orbits.size(); ++k) {
+      const Orbit &orbit = orbits[k];
+      const Vector3 expected =
+          orbit.focus + EllipticalPosition(orbit.epoch + orbit.delta * t);
+      // Each of the three angles is off by up to 0.05°, so the basis is off
+      // by at most 0.2°, which moves the position by that much (in radians)
+      // times its distance from the focus.
+      const float apoapsis =
+          orbit.epoch.semi_major_axis * (1 + orbit.epoch.eccentricity);
+      const float bound = 0.2 * 0.0174532924 * apoapsis + Tolerance(orbit, t);
+      ASSERT_LE(Vector3::Magnitude(got.Get(k) - expected), bound)
+          << frame_no << " " << k;
+    }
+
+    // The result doesn't depend on which bases were cached.
+    if (frame_no % 10 == 7) {
+      const Vector3Array &fresh_got = fresh.Solve(t, orbits);
+      EXPECT_EQ(fresh_got.x, got.x);
+      EXPECT_EQ(fresh_got.y, got.y);
+      EXPECT_EQ(fresh_got.z, got.z);
+    }
+  }
+
+  // The node moved by a degree, so each basis was updated about 10 times,
+  // rather than every frame.
+  const int count = orbits.size();
+  EXPECT_LT(solver.basis_updates(), count * 15);
+  EXPECT_GT(solver.basis_updates(), count * 5);
+}
+
+TEST(KeplerSolverTest, Hierarchy) {
+  // A sun, a planet, and a moon of the planet, listed before the planet. The
+  // last orbit's parent isn't among the orbits, so it's ignored.
+  SparseSet<Orbit> orbits;
+  const Orbit::Kepler kepler{.semi_major_axis = 10, .eccentricity = 0.1};
+  orbits.GetOrInit(Entity(0)) = Orbit{.id = Entity(0), .epoch = kepler};
+  orbits.GetOrInit(Entity(1)) = Orbit{.id = Entity(1),
+                                      .focus{0, 0, 1},
+                                      .epoch = kepler,
+                                      .delta{.mean_longitude_deg = 30},
+                                      .parent_id = Entity(2)};
+  orbits.GetOrInit(Entity(2)) = Orbit{.id = Entity(2),
+                                      .epoch = kepler,
+                                      .delta{.mean_longitude_deg = 3},
+                                      .parent_id = Entity(0)};
+  orbits.GetOrInit(Entity(3)) =
+      Orbit{.id = Entity(3), .epoch = kepler, .parent_id = Entity(4)};
+
+  const std::vector<Transform> transforms(5);
+  std::vector<Motion> expected(5);
+  std::vector<Motion> got(5);
+  KeplerSolver solver;
+  for (const float t : {0.0f, 1.0f, 17.5f}) {
+    UpdateOrbitalMotion(t, transforms, orbits, expected);
+    UpdateOrbitalMotion(solver, t, transforms, orbits, got);
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_LE(Vector3::Magnitude(got[i].new_position -
+                                   expected[i].new_position),
+                1e-3)
+          << t << " " << i;
+    }
+    // The moon circles the planet.
+    EXPECT_NEAR(Vector3::Magnitude(got[1].new_position - got[2].new_position -
+                                   Vector3{0, 0, 1}),
+                10, 1.1)
+        << t;
+  }
+  EXPECT_EQ(got[3].new_position, got[0].new_position);
+}
+
+TEST(KeplerSolverTest, HierarchyCycle) {
+  // Parents must not form a cycle, but if they do, the solver still returns.
+  const std::vector<Orbit> orbits{
+      Orbit{.id = Entity(0), .focus{1, 0, 0}, .parent_id = Entity(1)},
+      Orbit{.id = Entity(1), .focus{0, 1, 0}, .parent_id = Entity(0)},
+  };
+  KeplerSolver solver;
+  const Vector3Array &got = solver.Solve(0, orbits);
+  EXPECT_EQ(got.Get(0) + got.Get(1), (Vector3{1, 2, 0}));
+}
+
+TEST(KeplerSolverTest, HierarchyCycleMatchesScalar) {
+  // Both break the cycle in the same place: 2 loses its parent, 1 follows 2 and
+  // 0 follows 1.
+  SparseSet<Orbit> orbits;
+  orbits.GetOrInit(Entity(0)) =
+      Orbit{.id = Entity(0), .focus{1, 0, 0}, .parent_id = Entity(1)};
+  orbits.GetOrInit(Entity(1)) =
+      Orbit{.id = Entity(1), .focus{0, 1, 0}, .parent_id = Entity(2)};
+  orbits.GetOrInit(Entity(2)) =
+      Orbit{.id = Entity(2), .focus{0, 0, 1}, .parent_id = Entity(0)};
+
+  const std::vector<Transform> transforms(3);
+  std::vector<Motion> expected(3);
+  std::vector<Motion> got(3);
+  KeplerSolver solver;
+  UpdateOrbitalMotion(0, transforms, orbits, expected);
+  UpdateOrbitalMotion(solver, 0, transforms, orbits, got);
+  EXPECT_EQ(expected[0].new_position, (Vector3{1, 1, 1}));
+  EXPECT_EQ(expected[1].new_position, (Vector3{0, 1, 1}));
+  EXPECT_EQ(expected[2].new_position, (Vector3{0, 0, 1}));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(got[i].new_position, expected[i].new_position) << i;
+  }
+}
+
+}  // namespace
+}  // namespace vstr
@@ -7,6 +7,11 @@
 
 #include "motion.h"
 
+#include <algorithm>
+#include <limits>
+
+#include "systems/neighbor_lists.h"
+
 namespace vstr {
 namespace {
 
@@ -59,11 +64,11 @@ Vector3 GravityAt(const std::vector<Transform> &positions,
   return result;
 }
 
-void ComputeForces(const std::vector<Transform> &positions,
-                   const std::vector<Mass> &mass,
-                   const std::vector<Flags> &flags, const Entity id,
-                   absl::Span<Event> &input, Vector3 &out_linear_acceleration,
-                   Vector3 &out_impulse, Quaternion &out_angular) {
+// Sums up input acceleration and impulse for object id, advancing input past
+// its events.
+void ComputeInput(const std::vector<Mass> &mass, const Entity id,
+                  absl::Span<Event> &input, Vector3 &out_linear_acceleration,
+                  Vector3 &out_impulse, Quaternion &out_angular) {
   while (input.size() != 0 && input[0].id < id) {
     input = input.subspan(1);
   }
@@ -86,82 +91,617 @@ void ComputeForces(const std::vector<Transform> &positions,
     }
     input = input.subspan(1);
   }
+}
+
+constexpr uint32_t kNotMoving =
+    Flags::kDestroyed | Flags::kGlued | Flags::kOrbiting;
+
+// Fills buffers.moving with the objects in the region and gathers their
+// positions.
+void CollectMovingObjects(const FlagIndex &flag_index,
+                          const MotionRegion &region, const Kinematics &k,
+                          MotionBuffers &buffers) {
+  buffers.moving.clear();
+  if (region.regions == nullptr) {
+    flag_index.ForEach(0, kNotMoving,
+                       [&](const size_t i) { buffers.moving.push_back(i); });
+  } else {
+    const std::vector<uint8_t> &regions = *region.regions;
+    flag_index.ForEach(0, kNotMoving, [&](const size_t i) {
+      if (regions[i] == region.region) buffers.moving.push_back(i);
+    });
+  }
 
-  out_linear_acceleration += GravityAt(positions, mass, flags, id, nullptr);
+  const size_t count = buffers.moving.size();
+  buffers.moving_position.resize(count);
+  for (size_t j = 0; j < count; ++j) {
+    buffers.moving_position.Set(j, k.position.Get(buffers.moving[j]));
+  }
 }
 
-}  // namespace
+// Gathers the attractors that act on the region.
+const Attractors &RebuildAttractors(const Kinematics &k,
+                                    const std::vector<Mass> &mass,
+                                    const FlagIndex &flag_index,
+                                    const MotionRegion &region,
+                                    Attractors &attractors) {
+  attractors.Rebuild(k.position, mass, flag_index);
+  if (region.local_attractors && region.regions != nullptr) {
+    attractors.KeepRegion(*region.regions, region.region);
+  }
+  if (region.max_attractors >= 0) {
+    attractors.KeepHeaviest(region.max_attractors);
+  }
+  return attractors;
+}
 
-void IntegrateFirstOrderEuler(const float dt, absl::Span<Event> input,
-                              const std::vector<Transform> &positions,
-                              const std::vector<Mass> &mass,
-                              const std::vector<Flags> &flags,
-                              std::vector<Motion> &motion) {
-  const size_t count = positions.size();
+// The neighbor lists to use for the region, or null.
+const NeighborLists *UsableNeighbors(const MotionRegion &region) {
+  if (region.neighbors == nullptr || !region.neighbors->valid() ||
+      region.max_attractors >= 0) {
+    return nullptr;
+  }
+  return region.neighbors;
+}
+
+// Moves objects that no force acts on from buffers.moving to buffers.ballistic.
+// Marking an object as forced is always safe (it only costs the full
+// computation), so this errs on that side.
+void SplitBallistic(absl::Span<const Event> input, const Kinematics &k,
+                    const Attractors &attractors,
+                    const NeighborLists *neighbors, MotionBuffers &buffers) {
+  buffers.ballistic.clear();
+
+  // An attractor of unlimited reach pulls at every object but itself, so there
+  // is at most one ballistic object. Scenes like that are common, and not
+  // worth the work below.
+  if (std::find(attractors.cutoff_sqr.begin(), attractors.cutoff_sqr.end(),
+                std::numeric_limits<float>::infinity()) !=
+      attractors.cutoff_sqr.end()) {
+    return;
+  }
+
+  const size_t count = buffers.moving.size();
+  const int32_t *id = buffers.moving.data();
+  buffers.forced.resize(count);
+  uint8_t *forced = buffers.forced.data();
+
+  for (size_t j = 0; j < count; ++j) {
+    forced[j] = k.acceleration.Get(id[j]) != Vector3::Zero();
+  }
+
+  // Both input and moving are sorted by ID.
+  size_t j = 0;
+  for (const Event &event : input) {
+    if (event.type != Event::kAcceleration) continue;
+    while (j < count && id[j] < event.id.value()) ++j;
+    if (j < count && id[j] == event.id.value()) forced[j] = 1;
+  }
+
+  // Same test as in AccumulateGravity.
+  const float *px = buffers.moving_position.x.data();
+  const float *py = buffers.moving_position.y.data();
+  const float *pz = buffers.moving_position.z.data();
+  if (neighbors != nullptr) {
+    for (size_t i = 0; i < count; ++i) {
+      for (const int32_t a : neighbors->Of(id[i])) {
+        const float dx = attractors.position.x[a] - px[i];
+        const float dy = attractors.position.y[a] - py[i];
+        const float dz = attractors.position.z[a] - pz[i];
+        const float r_square = dx * dx + dy * dy + dz * dz;
+        forced[i] |= id[i] != attractors.id[a] && r_square > 0 &&
+                     r_square <= attractors.cutoff_sqr[a];
+      }
+    }
+  } else {
+    for (size_t a = 0; a < attractors.size(); ++a) {
+      const int32_t self = attractors.id[a];
+      const float cutoff_sqr = attractors.cutoff_sqr[a];
+      const float ax = attractors.position.x[a];
+      const float ay = attractors.position.y[a];
+      const float az = attractors.position.z[a];
+      for (size_t i = 0; i < count; ++i) {
+        const float dx = ax - px[i];
+        const float dy = ay - py[i];
+        const float dz = az - pz[i];
+        const float r_square = dx * dx + dy * dy + dz * dz;
+        forced[i] |= id[i] != self && r_square > 0 && r_square <= cutoff_sqr;
+      }
+    }
+  }
+
+  size_t kept = 0;
   for (size_t i = 0; i < count; ++i) {
-    if (flags[i].value & (Flags::kDestroyed | Flags::kGlued | Flags::kOrbiting))
+    if (!forced[i]) {
+      buffers.ballistic.push_back(id[i]);
       continue;
+    }
+    buffers.moving[kept] = id[i];
+    buffers.moving_position.Set(kept, buffers.moving_position.Get(i));
+    ++kept;
+  }
+  buffers.moving.resize(kept);
+  buffers.moving_position.resize(kept);
+}
+
+// With no acceleration and no impulse, both integrators reduce to this.
+void AdvanceBallistic(const float dt, const MotionBuffers &buffers,
+                      Kinematics &k, std::vector<Motion> &motion) {
+  for (const int32_t i : buffers.ballistic) {
+    k.new_position.Set(i, k.position.Get(i) + k.velocity.Get(i) * dt);
+  }
+  k.Store(buffers.ballistic, motion);
+}
 
+// Computes gravity acting on every object and stores it in out. The outer loop
+// goes over attractors and the inner loop over objects, so that each lane only
+// ever adds to its own accumulator. That keeps the inner loop free of
+// dependencies (the compiler can vectorize it) and sums the contributions in
+// the same order as GravityAt.
+//
+// With neighbor lists, each object only visits the attractors on its list,
+// still in ascending order. The attractors left out would have added zero, so
+// the sums come out exactly the same.
+//
+// Positions and out are indexed by offset into ids.
+void AccumulateGravity(const Attractors &attractors,
+                       const NeighborLists *neighbors,
+                       const std::vector<int32_t> &ids,
+                       const Vector3Array &positions, Vector3Array &out) {
+  const size_t count = positions.size();
+  out.resize(count);
+  std::fill(out.x.begin(), out.x.end(), 0);
+  std::fill(out.y.begin(), out.y.end(), 0);
+  std::fill(out.z.begin(), out.z.end(), 0);
+
+  const int32_t *id = ids.data();
+  const float *px = positions.x.data();
+  const float *py = positions.y.data();
+  const float *pz = positions.z.data();
+  float *gx = out.x.data();
+  float *gy = out.y.data();
+  float *gz = out.z.data();
+
+  if (neighbors != nullptr) {
+    for (size_t i = 0; i < count; ++i) {
+      for (const int32_t j : neighbors->Of(id[i])) {
+        const float dx = attractors.position.x[j] - px[i];
+        const float dy = attractors.position.y[j] - py[i];
+        const float dz = attractors.position.z[j] - pz[i];
+        const float r_square = dx * dx + dy * dy + dz * dz;
+        const bool in_range = id[i] != attractors.id[j] && r_square > 0 &&
+                              r_square <= attractors.cutoff_sqr[j];
+        if (!in_range) continue;
+        const float m = 1.0f / std::sqrt(r_square);
+        const float s = attractors.active[j] / r_square;
+        gx[i] += (dx * m) * s;
+        gy[i] += (dy * m) * s;
+        gz[i] += (dz * m) * s;
+      }
+    }
+    return;
+  }
+
+  for (size_t j = 0; j < attractors.size(); ++j) {
+    const int32_t self = attractors.id[j];
+    const float ax = attractors.position.x[j];
+    const float ay = attractors.position.y[j];
+    const float az = attractors.position.z[j];
+    const float active = attractors.active[j];
+    const float cutoff_sqr = attractors.cutoff_sqr[j];
+
+    for (size_t i = 0; i < count; ++i) {
+      // See GravityContributionFrom for the formula.
+      const float dx = ax - px[i];
+      const float dy = ay - py[i];
+      const float dz = az - pz[i];
+      const float r_square = dx * dx + dy * dy + dz * dz;
+      const bool in_range =
+          id[i] != self && r_square > 0 && r_square <= cutoff_sqr;
+      // Masked-out lanes still do the arithmetic. Dividing by 1 instead of 0
+      // keeps them from producing NaNs, which trap with float exceptions on.
+      const float r_square_safe = in_range ? r_square : 1.0f;
+      const float m = 1.0f / std::sqrt(r_square_safe);
+      const float s = active / r_square_safe;
+      gx[i] += in_range ? (dx * m) * s : 0.0f;
+      gy[i] += in_range ? (dy * m) * s : 0.0f;
+      gz[i] += in_range ? (dz * m) * s : 0.0f;
+    }
+  }
+}
+
+// Adds input acceleration to buffers.acceleration and records impulses in
+// buffers.impulse. Angular acceleration is rare, and it's applied to
+// Motion.spin directly.
+//
+// Both input and buffers.moving are sorted by ID, so they're walked in step.
+void ApplyInput(const float dt, absl::Span<Event> input,
+                const std::vector<Mass> &mass, MotionBuffers &buffers,
+                std::vector<Motion> &motion) {
+  const size_t count = buffers.moving.size();
+  buffers.impulse.resize(count);
+  std::fill(buffers.impulse.x.begin(), buffers.impulse.x.end(), 0);
+  std::fill(buffers.impulse.y.begin(), buffers.impulse.y.end(), 0);
+  std::fill(buffers.impulse.z.begin(), buffers.impulse.z.end(), 0);
+
+  size_t j = 0;
+  while (!input.empty()) {
+    const Entity id = input[0].id;
+    while (j < count && buffers.moving[j] < id.value()) ++j;
+    if (j == count || buffers.moving[j] != id.value()) {
+      input = input.subspan(1);
+      continue;
+    }
+
+    Vector3 linear_acceleration;
     Vector3 impulse;
     Quaternion angular_acceleration;
-    ComputeForces(positions, mass, flags, Entity(i), input,
-                  motion[i].acceleration, impulse, angular_acceleration);
-    motion[i].velocity += impulse + motion[i].acceleration * dt;
-    motion[i].new_position = positions[i].position + motion[i].velocity * dt;
+    ComputeInput(mass, id, input, linear_acceleration, impulse,
+                 angular_acceleration);
+    buffers.acceleration.Set(j,
+                             linear_acceleration + buffers.acceleration.Get(j));
+    buffers.impulse.Set(j, impulse);
     if (angular_acceleration != Quaternion::Identity()) {
-      motion[i].spin *= Quaternion::Interpolate(Quaternion::Identity(),
-                                                angular_acceleration, dt);
+      id.Get(motion).spin *= Quaternion::Interpolate(
+          Quaternion::Identity(), angular_acceleration, dt);
     }
   }
 }
 
+// Yoshida's coefficients: with w1 = 1 / (2 - 2^(1/3)) and w0 = -2^(1/3) × w1,
+// the drifts are w1/2, (w0 + w1)/2, (w0 + w1)/2, w1/2 and the kicks in between
+// are w1, w0, w1. They compose three Verlet steps of w1, w0 and w1 × dt.
+constexpr float kYoshidaDrift[] = {0.6756035959798289f, -0.1756035959798288f,
+                                   -0.1756035959798288f, 0.6756035959798289f};
+constexpr float kYoshidaKick[] = {1.3512071919596578f, -1.7024143839193153f,
+                                  1.3512071919596578f};
+
+// Copies the attractors to buffers.stage_attractors, and finds which of them
+// move during the step. Attractors and both ID lists are in ascending order.
+void PrepareStages(const Attractors &attractors, const Kinematics &k,
+                   MotionBuffers &buffers) {
+  Attractors &stage = buffers.stage_attractors;
+  stage.id = attractors.id;
+  stage.position = attractors.position;
+  stage.active = attractors.active;
+  stage.cutoff_sqr = attractors.cutoff_sqr;
+
+  const size_t count = attractors.size();
+  buffers.stage_source.resize(count);
+  buffers.stage_velocity.resize(count);
+  const std::vector<int32_t> &moving = buffers.moving;
+  const std::vector<int32_t> &ballistic = buffers.ballistic;
+  for (size_t a = 0; a < count; ++a) {
+    const int32_t id = attractors.id[a];
+    const auto j = std::lower_bound(moving.begin(), moving.end(), id);
+    const bool is_moving = j != moving.end() && *j == id;
+    buffers.stage_source[a] = is_moving ? j - moving.begin() : -1;
+    const bool is_ballistic =
+        std::binary_search(ballistic.begin(), ballistic.end(), id);
+    buffers.stage_velocity.Set(
+        a, is_ballistic ? k.velocity.Get(id) : Vector3::Zero());
+  }
+}
+
+// Moves the objects and the stage attractors by velocity × dt.
+void Drift(const float dt, MotionBuffers &buffers) {
+  const size_t count = buffers.moving.size();
+  float *px = buffers.moving_position.x.data();
+  float *py = buffers.moving_position.y.data();
+  float *pz = buffers.moving_position.z.data();
+  const float *vx = buffers.moving_velocity.x.data();
+  const float *vy = buffers.moving_velocity.y.data();
+  const float *vz = buffers.moving_velocity.z.data();
+  for (size_t j = 0; j < count; ++j) {
+    px[j] += vx[j] * dt;
+    py[j] += vy[j] * dt;
+    pz[j] += vz[j] * dt;
+  }
+
+  // Attractors that are integrated here take the same position as the object,
+  // so the result doesn't depend on how the scene is split into regions.
+  Vector3Array &stage = buffers.stage_attractors.position;
+  for (size_t a = 0; a < stage.size(); ++a) {
+    const int32_t j = buffers.stage_source[a];
+    stage.Set(a, j >= 0 ? buffers.moving_position.Get(j)
+                        : stage.Get(a) + buffers.stage_velocity.Get(a) * dt);
+  }
+}
+
+// Adds (gravity + input) × dt to the velocity of the objects.
+void Kick(const float dt, MotionBuffers &buffers) {
+  const size_t count = buffers.moving.size();
+  const float *gx = buffers.acceleration.x.data();
+  const float *gy = buffers.acceleration.y.data();
+  const float *gz = buffers.acceleration.z.data();
+  const float *ix = buffers.input_acceleration.x.data();
+  const float *iy = buffers.input_acceleration.y.data();
+  const float *iz = buffers.input_acceleration.z.data();
+  float *vx = buffers.moving_velocity.x.data();
+  float *vy = buffers.moving_velocity.y.data();
+  float *vz = buffers.moving_velocity.z.data();
+  for (size_t j = 0; j < count; ++j) {
+    vx[j] += (gx[j] + ix[j]) * dt;
+    vy[j] += (gy[j] + iy[j]) * dt;
+    vz[j] += (gz[j] + iz[j]) * dt;
+  }
+}
+
+}  // namespace
+
+void Attractors::Rebuild(const Vector3Array &positions,
+                         const std::vector<Mass> &mass,
+                         const FlagIndex &flag_index) {
+  id.clear();
+  position.resize(0);
+  active.clear();
+  cutoff_sqr.clear();
+
+  flag_index.ForEach(0, Flags::kDestroyed | Flags::kGlued, [&](const size_t i) {
+    if (mass[i].active == 0) return;
+    id.push_back(i);
+    position.x.push_back(positions.x[i]);
+    position.y.push_back(positions.y[i]);
+    position.z.push_back(positions.z[i]);
+    active.push_back(mass[i].active);
+    cutoff_sqr.push_back(mass[i].cutoff_distance == 0
+                             ? std::numeric_limits<float>::infinity()
+                             : mass[i].cutoff_distance *
+                                   mass[i].cutoff_distance);
+  });
+}
+
+void Attractors::KeepHeaviest(const size_t n) {
+  if (n >= size()) return;
+  if (n == 0) {
+    id.clear();
+    position.resize(0);
+    active.clear();
+    cutoff_sqr.clear();
+    return;
+  }
+
+  // Find the nth heaviest by repeatedly finding the heaviest attractor lighter
+  // than the last one found. This is O(n×size()), but n is tiny in practice,
+  // and it needs no scratch space.
+  const auto heavier = [this](const size_t a, const size_t b) {
+    return active[a] > active[b] || (active[a] == active[b] && id[a] < id[b]);
+  };
+  size_t last = 0;
+  for (size_t k = 0; k < n; ++k) {
+    size_t best = size();
+    for (size_t j = 0; j < size(); ++j) {
+      if (k != 0 && !heavier(last, j)) continue;
+      if (best == size() || heavier(j, best)) best = j;
+    }
+    last = best;
+  }
+
+  // Everything at least as heavy as the nth stays.
+  size_t kept = 0;
+  for (size_t j = 0; j < size(); ++j) {
+    if (j != last && !heavier(j, last)) continue;
+    id[kept] = id[j];
+    position.Set(kept, position.Get(j));
+    active[kept] = active[j];
+    cutoff_sqr[kept] = cutoff_sqr[j];
+    ++kept;
+  }
+  id.resize(kept);
+  position.resize(kept);
+  active.resize(kept);
+  cutoff_sqr.resize(kept);
+}
+
+void Attractors::KeepRegion(const std::vector<uint8_t> &regions,
+                            const uint8_t region) {
+  size_t kept = 0;
+  for (size_t j = 0; j < size(); ++j) {
+    if (regions[id[j]] != region) continue;
+    id[kept] = id[j];
+    position.Set(kept, position.Get(j));
+    active[kept] = active[j];
+    cutoff_sqr[kept] = cutoff_sqr[j];
+    ++kept;
+  }
+  id.resize(kept);
+  position.resize(kept);
+  active.resize(kept);
+  cutoff_sqr.resize(kept);
+}
+
+void IntegrateFirstOrderEuler(const float dt, absl::Span<Event> input,
+                              const std::vector<Mass> &mass,
+                              const FlagIndex &flag_index,
+                              MotionBuffers &buffers,
+                              std::vector<Motion> &motion) {
+  IntegrateFirstOrderEuler(dt, input, mass, flag_index, MotionRegion{},
+                           buffers.kinematics, buffers, motion);
+}
+
+void IntegrateFirstOrderEuler(const float dt, absl::Span<Event> input,
+                              const std::vector<Mass> &mass,
+                              const FlagIndex &flag_index,
+                              const MotionRegion &region, Kinematics &k,
+                              MotionBuffers &buffers,
+                              std::vector<Motion> &motion) {
+  const NeighborLists *neighbors = UsableNeighbors(region);
+  const Attractors &attractors =
+      neighbors != nullptr
+          ? neighbors->attractors()
+          : RebuildAttractors(k, mass, flag_index, region, buffers.attractors);
+  CollectMovingObjects(flag_index, region, k, buffers);
+  SplitBallistic(input, k, attractors, neighbors, buffers);
+  AccumulateGravity(attractors, neighbors, buffers.moving,
+                    buffers.moving_position, buffers.acceleration);
+  ApplyInput(dt, input, mass, buffers, motion);
+
+  const size_t count = buffers.moving.size();
+  for (size_t j = 0; j < count; ++j) {
+    const size_t i = buffers.moving[j];
+    const Vector3 acceleration = buffers.acceleration.Get(j);
+    const Vector3 velocity = k.velocity.Get(i) + (buffers.impulse.Get(j) +
+                                                  acceleration * dt);
+    k.acceleration.Set(i, acceleration);
+    k.velocity.Set(i, velocity);
+    k.new_position.Set(i, k.position.Get(i) + velocity * dt);
+  }
+
+  // Only moving objects changed.
+  k.Store(buffers.moving, motion);
+  AdvanceBallistic(dt, buffers, k, motion);
+}
+
 void IntegrateVelocityVerlet(const float dt, absl::Span<Event> input,
-                             const std::vector<Transform> &positions,
                              const std::vector<Mass> &mass,
-                             const std::vector<Flags> &flags,
+                             const FlagIndex &flag_index,
+                             MotionBuffers &buffers,
+                             std::vector<Motion> &motion) {
+  IntegrateVelocityVerlet(dt, input, mass, flag_index, MotionRegion{},
+                          buffers.kinematics, buffers, motion);
+}
+
+void IntegrateVelocityVerlet(const float dt, absl::Span<Event> input,
+                             const std::vector<Mass> &mass,
+                             const FlagIndex &flag_index,
+                             const MotionRegion &region, Kinematics &k,
+                             MotionBuffers &buffers,
                              std::vector<Motion> &motion) {
-  const size_t count = positions.size();
   const float half_dt = dt * 0.5;
-  for (size_t i = 0; i < count; ++i) {
-    if (flags[i].value & (Flags::kDestroyed | Flags::kGlued | Flags::kOrbiting))
-      continue;
+  const NeighborLists *neighbors = UsableNeighbors(region);
+  const Attractors &attractors =
+      neighbors != nullptr
+          ? neighbors->attractors()
+          : RebuildAttractors(k, mass, flag_index, region, buffers.attractors);
+  CollectMovingObjects(flag_index, region, k, buffers);
+  SplitBallistic(input, k, attractors, neighbors, buffers);
+  AccumulateGravity(attractors, neighbors, buffers.moving,
+                    buffers.moving_position, buffers.acceleration);
+  ApplyInput(dt, input, mass, buffers, motion);
 
-    motion[i].new_position = positions[i].position + motion[i].velocity * dt +
-                             motion[i].acceleration * (dt * half_dt);
+  const size_t count = buffers.moving.size();
+  for (size_t j = 0; j < count; ++j) {
+    const size_t i = buffers.moving[j];
+    const Vector3 acceleration = k.acceleration.Get(i);
+    const Vector3 new_acceleration = buffers.acceleration.Get(j);
+    k.new_position.Set(i, k.position.Get(i) + k.velocity.Get(i) * dt +
+                              acceleration * (dt * half_dt));
+    k.velocity.Set(i, k.velocity.Get(i) +
+                          ((new_acceleration + acceleration) * half_dt +
+                           buffers.impulse.Get(j)));
+    k.acceleration.Set(i, new_acceleration);
+  }
 
-    Vector3 new_acceleration;
-    Vector3 impulse;
-    Quaternion angular_acceleration;
-    ComputeForces(positions, mass, flags, Entity(i), input, new_acceleration,
-                  impulse, angular_acceleration);
-    motion[i].velocity +=
-        (new_acceleration + motion[i].acceleration) * half_dt + impulse;
-    motion[i].acceleration = new_acceleration;
-    if (angular_acceleration != Quaternion::Identity()) {
-      motion[i].spin *= Quaternion::Interpolate(Quaternion::Identity(),
-                                                angular_acceleration, dt);
-    }
+  // Only moving objects changed.
+  k.Store(buffers.moving, motion);
+  AdvanceBallistic(dt, buffers, k, motion);
+}
+
+void IntegrateFourthOrderYoshida(const float dt, absl::Span<Event> input,
+                                 const std::vector<Mass> &mass,
+                                 const FlagIndex &flag_index,
+                                 MotionBuffers &buffers,
+                                 std::vector<Motion> &motion) {
+  IntegrateFourthOrderYoshida(dt, input, mass, flag_index, MotionRegion{},
+                              buffers.kinematics, buffers, motion);
+}
+
+void IntegrateFourthOrderYoshida(const float dt, absl::Span<Event> input,
+                                 const std::vector<Mass> &mass,
+                                 const FlagIndex &flag_index,
+                                 const MotionRegion &region, Kinematics &k,
+                                 MotionBuffers &buffers,
+                                 std::vector<Motion> &motion) {
+  // Gravity is evaluated where the objects are during the step, but neighbor
+  // lists and the ballistic split only look at where they start: a fast
+  // attractor could come into range mid-step without either noticing. So every
+  // object in the region is integrated against every attractor.
+  const Attractors &attractors =
+      RebuildAttractors(k, mass, flag_index, region, buffers.attractors);
+  CollectMovingObjects(flag_index, region, k, buffers);
+  buffers.ballistic.clear();
+
+  // Input is constant over the step, so it's only gathered once.
+  const size_t count = buffers.moving.size();
+  buffers.acceleration.resize(count);
+  std::fill(buffers.acceleration.x.begin(), buffers.acceleration.x.end(), 0);
+  std::fill(buffers.acceleration.y.begin(), buffers.acceleration.y.end(), 0);
+  std::fill(buffers.acceleration.z.begin(), buffers.acceleration.z.end(), 0);
+  ApplyInput(dt, input, mass, buffers, motion);
+  std::swap(buffers.acceleration, buffers.input_acceleration);
+
+  buffers.moving_velocity.resize(count);
+  for (size_t j = 0; j < count; ++j) {
+    buffers.moving_velocity.Set(j, k.velocity.Get(buffers.moving[j]));
+  }
+  PrepareStages(attractors, k, buffers);
+
+  for (int stage = 0; stage < 3; ++stage) {
+    Drift(kYoshidaDrift[stage] * dt, buffers);
+    AccumulateGravity(buffers.stage_attractors, nullptr, buffers.moving,
+                      buffers.moving_position, buffers.acceleration);
+    Kick(kYoshidaKick[stage] * dt, buffers);
+  }
+  Drift(kYoshidaDrift[3] * dt, buffers);
+
+  // As with Verlet, the impulse shows up in the position on the next frame.
+  for (size_t j = 0; j < count; ++j) {
+    const size_t i = buffers.moving[j];
+    k.new_position.Set(i, buffers.moving_position.Get(j));
+    k.velocity.Set(i, buffers.moving_velocity.Get(j) + buffers.impulse.Get(j));
+    k.acceleration.Set(i, buffers.acceleration.Get(j) +
+                              buffers.input_acceleration.Get(j));
   }
+
+  // Only moving objects changed.
+  k.Store(buffers.moving, motion);
+  AdvanceBallistic(dt, buffers, k, motion);
 }
 
 void IntegrateMotion(IntegrationMethod integrator, const float dt,
-                     absl::Span<Event> input,
-                     const std::vector<Transform> &positions,
-                     const std::vector<Mass> &mass,
-                     const std::vector<Flags> &flags,
+                     absl::Span<Event> input, const std::vector<Mass> &mass,
+                     const FlagIndex &flag_index, MotionBuffers &buffers,
+                     std::vector<Motion> &motion) {
+  IntegrateMotion(integrator, dt, input, mass, flag_index, MotionRegion{},
+                  buffers.kinematics, buffers, motion);
+}
+
+void IntegrateMotion(IntegrationMethod integrator, const float dt,
+                     absl::Span<Event> input, const std::vector<Mass> &mass,
+                     const FlagIndex &flag_index, const MotionRegion &region,
+                     Kinematics &kinematics, MotionBuffers &scratch,
                      std::vector<Motion> &motion) {
   switch (integrator) {
     case kFirstOrderEuler:
-      IntegrateFirstOrderEuler(dt, input, positions, mass, flags, motion);
+      IntegrateFirstOrderEuler(dt, input, mass, flag_index, region, kinematics,
+                               scratch, motion);
       break;
     case kVelocityVerlet:
-      IntegrateVelocityVerlet(dt, input, positions, mass, flags, motion);
+      IntegrateVelocityVerlet(dt, input, mass, flag_index, region, kinematics,
+                              scratch, motion);
+      break;
+    case kFourthOrderYoshida:
+      IntegrateFourthOrderYoshida(dt, input, mass, flag_index, region,
+                                  kinematics, scratch, motion);
       break;
     default:
       assert("invalid integrator");
   }
 }
 
+void IntegrateMotion(IntegrationMethod integrator, const float dt,
+                     absl::Span<Event> input,
+                     const std::vector<Transform> &positions,
+                     const std::vector<Mass> &mass,
+                     const std::vector<Flags> &flags,
+                     std::vector<Motion> &motion) {
+  MotionBuffers buffers;
+  buffers.kinematics.Load(positions, motion);
+  FlagIndex flag_index;
+  flag_index.Rebuild(flags);
+  IntegrateMotion(integrator, dt, input, mass, flag_index, buffers, motion);
+}
+
 void UpdatePositions(const float dt, const std::vector<Motion> &motion,
                      const std::vector<Flags> &flags,
                      std::vector<Transform> &transforms) {
@@ -176,6 +716,18 @@ void UpdatePositions(const float dt, const std::vector<Motion> &motion,
   }
 }
 
+void UpdatePositions(const float dt, const std::vector<Motion> &motion,
+                     const FlagIndex &flag_index,
+                     std::vector<Transform> &transforms) {
+  flag_index.ForEach(0, Flags::kDestroyed, [&](const size_t i) {
+    transforms[i].position = motion[i].new_position;
+    if (motion[i].spin != Quaternion::Identity()) {
+      transforms[i].rotation *=
+          Quaternion::Interpolate(Quaternion::Identity(), motion[i].spin, dt);
+    }
+  });
+}
+
 Vector3 GravityForceOn(const std::vector<Transform> &positions,
                        const std::vector<Mass> &mass,
                        const std::vector<Flags> &flags, Entity object_id) {
@@ -12,6 +12,8 @@
 
 #include <iostream>
 
+#include "types/flag_index.h"
+#include "types/kinematics.h"
 #include "types/required_components.h"
 
 namespace vstr {
@@ -19,6 +21,90 @@ namespace vstr {
 enum IntegrationMethod {
   kFirstOrderEuler = 0,
   kVelocityVerlet = 1,
+  // Yoshida's 4th-order symplectic integrator (the same as Forest-Ruth). It
+  // evaluates gravity three times per step, but its error shrinks with dt^4,
+  // so it can take much longer steps for the same accuracy.
+  kFourthOrderYoshida = 2,
+};
+
+// Objects that exert gravity, in the same structure-of-arrays layout as
+// Kinematics. Rebuilt every frame, because masses and flags can change.
+struct Attractors {
+  std::vector<int32_t> id;
+  Vector3Array position;
+  std::vector<float> active;
+  // Square of Mass::cutoff_distance, or infinity if there is no cutoff.
+  std::vector<float> cutoff_sqr;
+
+  inline size_t size() const { return id.size(); }
+
+  void Rebuild(const Vector3Array &positions, const std::vector<Mass> &mass,
+               const FlagIndex &flag_index);
+
+  // Drops all but the n attractors with the largest active mass. Ties go to the
+  // lower ID. The rest stay in ascending order of ID.
+  void KeepHeaviest(size_t n);
+
+  // Drops attractors whose entry in regions isn't region.
+  void KeepRegion(const std::vector<uint8_t> &regions, uint8_t region);
+};
+
+class NeighborLists;
+
+// Restricts an integrator to part of the scene. The pipeline uses this for
+// spatial LOD, to integrate objects far from any point of interest separately
+// and with fewer attractors, and to integrate interaction islands in parallel.
+struct MotionRegion {
+  // Per object: the region it's in. If null, every object is in region 0.
+  const std::vector<uint8_t> *regions = nullptr;
+  uint8_t region = 0;
+  // Only this many of the most massive attractors act on the region. If
+  // negative, all of them do. With zero, objects drift in straight lines.
+  int max_attractors = -1;
+  // Only attractors in the region act on it. This gives the same result as
+  // using all of them if no attractor outside the region has an object inside
+  // it within reach (see Islands).
+  bool local_attractors = false;
+  // If set and valid, gravity only visits the attractors on each object's
+  // neighbor list. The lists already leave out attractors that are out of
+  // reach, so they make local_attractors unnecessary. Ignored when
+  // max_attractors is set.
+  const NeighborLists *neighbors = nullptr;
+};
+
+// Working set of the motion system. The pipeline keeps one between frames, so
+// the buffers only get reallocated when the scene grows.
+struct MotionBuffers {
+  Kinematics kinematics;
+  Attractors attractors;
+  // IDs of objects that move freely (not kDestroyed, kGlued or kOrbiting), in
+  // ascending order, except those in ballistic. The arrays below are indexed by
+  // offset into this list, not by entity ID.
+  std::vector<int32_t> moving;
+  Vector3Array moving_position;
+  // Acceleration due to gravity, and later also input.
+  Vector3Array acceleration;
+  Vector3Array impulse;
+  // IDs of freely moving objects that no force acts on, in ascending order.
+  // These have no input, no acceleration left over from the previous frame and
+  // no attractor in range. The integrators move them in a straight line, which
+  // gives the same result as the full computation, with none of the work.
+  std::vector<int32_t> ballistic;
+  // Per object in moving, before ballistic objects are split off: whether a
+  // force might act on it.
+  std::vector<uint8_t> forced;
+
+  // Only used by IntegrateFourthOrderYoshida, which evaluates gravity at
+  // intermediate positions during the step. Velocity and input acceleration
+  // are indexed like moving. The stage attractors are a copy of the
+  // attractors, which move along with the objects: stage_source is each
+  // attractor's offset into moving, or -1 if it's not integrated by the call.
+  // Those drift at stage_velocity, which is zero unless they're ballistic.
+  Vector3Array moving_velocity;
+  Vector3Array input_acceleration;
+  Attractors stage_attractors;
+  std::vector<int32_t> stage_source;
+  Vector3Array stage_velocity;
 };
 
 // Updates the Motion and Acceleration components, except where kGlued,
@@ -34,11 +120,37 @@ void IntegrateMotion(IntegrationMethod integrator, float dt,
                      const std::vector<Flags> &flags,
                      std::vector<Motion> &motion);
 
+// Same as above, but runs on the SoA copy in buffers.kinematics, which the
+// caller must have loaded from positions and motion. Results are written to
+// both buffers.kinematics and motion, so the kinematics remain valid for
+// subsequent systems, such as collision detection. Only visits objects that
+// flag_index says move freely.
+void IntegrateMotion(IntegrationMethod integrator, float dt,
+                     absl::Span<Event> input, const std::vector<Mass> &mass,
+                     const FlagIndex &flag_index, MotionBuffers &buffers,
+                     std::vector<Motion> &motion);
+
+// Same as above, but only integrates objects in the region. Objects outside it
+// are left alone, so the integrator can be called once per region.
+//
+// The kinematics are passed separately (scratch.kinematics is unused), and
+// only the entries of objects in the region are written. Calls for different
+// regions can therefore run concurrently, if each has its own scratch buffers.
+void IntegrateMotion(IntegrationMethod integrator, float dt,
+                     absl::Span<Event> input, const std::vector<Mass> &mass,
+                     const FlagIndex &flag_index, const MotionRegion &region,
+                     Kinematics &kinematics, MotionBuffers &scratch,
+                     std::vector<Motion> &motion);
+
 // Copies Motion.next_position to Position.value.
 void UpdatePositions(float dt, const std::vector<Motion> &motion,
                      const std::vector<Flags> &flags,
                      std::vector<Transform> &positions);
 
+void UpdatePositions(float dt, const std::vector<Motion> &motion,
+                     const FlagIndex &flag_index,
+                     std::vector<Transform> &positions);
+
 Vector3 GravityForceOn(const std::vector<Transform> &positions,
                        const std::vector<Mass> &mass,
                        const std::vector<Flags> &flags, Entity object_id);
@@ -49,17 +161,50 @@ Vector3 GravityForceOn(const std::vector<Transform> &positions,
                        std::vector<std::pair<Entity, Vector3>> &contributions);
 
 void IntegrateFirstOrderEuler(float dt, absl::Span<Event> input,
-                              const std::vector<Transform> &positions,
                               const std::vector<Mass> &mass,
-                              const std::vector<Flags> &flags,
+                              const FlagIndex &flag_index,
+                              MotionBuffers &buffers,
+                              std::vector<Motion> &motion);
+
+void IntegrateFirstOrderEuler(float dt, absl::Span<Event> input,
+                              const std::vector<Mass> &mass,
+                              const FlagIndex &flag_index,
+                              const MotionRegion &region,
+                              Kinematics &kinematics, MotionBuffers &scratch,
                               std::vector<Motion> &motion);
 
 void IntegrateVelocityVerlet(float dt, absl::Span<Event> input,
-                             const std::vector<Transform> &positions,
                              const std::vector<Mass> &mass,
-                             const std::vector<Flags> &flags,
+                             const FlagIndex &flag_index,
+                             MotionBuffers &buffers,
+                             std::vector<Motion> &motion);
+
+void IntegrateVelocityVerlet(float dt, absl::Span<Event> input,
+                             const std::vector<Mass> &mass,
+                             const FlagIndex &flag_index,
+                             const MotionRegion &region,
+                             Kinematics &kinematics, MotionBuffers &scratch,
                              std::vector<Motion> &motion);
 
+// Attractors that aren't integrated by the same call (for example, because
+// they're in another region) are held where they were at the start of the
+// step, like the other integrators do. Neighbor lists are ignored, and no
+// object is treated as ballistic, because both are only valid for the
+// positions at the start of the step.
+void IntegrateFourthOrderYoshida(float dt, absl::Span<Event> input,
+                                 const std::vector<Mass> &mass,
+                                 const FlagIndex &flag_index,
+                                 MotionBuffers &buffers,
+                                 std::vector<Motion> &motion);
+
+void IntegrateFourthOrderYoshida(float dt, absl::Span<Event> input,
+                                 const std::vector<Mass> &mass,
+                                 const FlagIndex &flag_index,
+                                 const MotionRegion &region,
+                                 Kinematics &kinematics,
+                                 MotionBuffers &scratch,
+                                 std::vector<Motion> &motion);
+
 }  // namespace vstr
 
 #endif
@@ -0,0 +1,286 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <random>
+
+#include "motion.h"
+#include "neighbor_lists.h"
+
+namespace vstr {
+namespace {
+
+constexpr float kDeltaTime = 1.0f / 60;
+
+struct Scene {
+  std::vector<Transform> transforms;
+  std::vector<Mass> mass;
+  std::vector<Motion> motion;
+  FlagIndex flag_index;
+};
+
+// Objects scattered around a single attractor. destroyed_percent of them are
+// destroyed, like the reserves of an object pool.
+Scene Generate(const int size, const int destroyed_percent) {
+  std::mt19937 random_generator;
+  std::uniform_real_distribution<float> position_rg(-1e6, 1e6);
+  std::uniform_int_distribution<int> percent_rg(0, 99);
+
+  Scene scene;
+  std::vector<Flags> flags;
+  for (int i = 0; i < size; ++i) {
+    const Vector3 position{position_rg(random_generator),
+                           position_rg(random_generator),
+                           position_rg(random_generator)};
+    scene.transforms.push_back(Transform{.position = position});
+    scene.mass.push_back(Mass{.inertial = 1, .active = i == 0 ? 1e9f : 0});
+    scene.motion.push_back(
+        Motion::FromPositionAndVelocity(position, Vector3{1, 0, 0}));
+    const bool destroyed = i != 0 && percent_rg(random_generator) <
+                                         destroyed_percent;
+    flags.push_back(Flags{destroyed ? Flags::kDestroyed : 0});
+  }
+  scene.flag_index.Rebuild(flags);
+  return scene;
+}
+
+// Reports the time per object in the scene, destroyed or not, so runs with
+// different sizes and destroyed shares can be compared directly.
+void ReportTimePerEntity(benchmark::State &state, const Scene &scene) {
+  state.counters["time_per_entity"] = benchmark::Counter(
+      scene.transforms.size(),
+      benchmark::Counter::kIsIterationInvariantRate |
+          benchmark::Counter::kInvert);
+  state.SetItemsProcessed(state.iterations() * scene.transforms.size());
+}
+
+// Reports the bytes of component data touched per object in the scene, as a
+// rough proxy for cache traffic. The caller counts them from the access
+// pattern: bytes for every object, plus live_bytes for each one that isn't
+// destroyed.
+void ReportBytesTouched(benchmark::State &state, const Scene &scene,
+                        const double bytes, const double live_bytes) {
+  size_t live = 0;
+  scene.flag_index.ForEach(0, Flags::kDestroyed, [&](size_t) { ++live; });
+  state.counters["bytes_per_entity"] =
+      bytes + live_bytes * live / scene.transforms.size();
+}
+
+void BM_IntegrateVelocityVerlet(benchmark::State &state) {
+  Scene scene = Generate(state.range(0), state.range(1));
+  MotionBuffers buffers;
+  for (auto _ : state) {
+    buffers.kinematics.Load(scene.transforms, scene.motion);
+    IntegrateVelocityVerlet(kDeltaTime, {}, scene.mass, scene.flag_index,
+                            buffers, scene.motion);
+    benchmark::DoNotOptimize(scene.motion.data());
+  }
+  ReportTimePerEntity(state, scene);
+
+  // Load reads every Transform and Motion in full, and writes four Vector3
+  // columns. The integration loop reads and writes three columns for each
+  // moving object, plus acceleration and impulse. Store writes back Motion for
+  // each moving object.
+  ReportBytesTouched(state, scene,
+                     sizeof(Transform) + sizeof(Motion) + 4 * sizeof(Vector3),
+                     8 * sizeof(Vector3) + sizeof(Motion));
+}
+BENCHMARK(BM_IntegrateVelocityVerlet)
+    ->ArgsProduct({
+        // size
+        {10000, 100000},
+        // destroyed_percent
+        {0, 50, 90},
+    })
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_UpdatePositions(benchmark::State &state) {
+  Scene scene = Generate(state.range(0), state.range(1));
+  for (auto _ : state) {
+    UpdatePositions(kDeltaTime, scene.motion, scene.flag_index,
+                    scene.transforms);
+    benchmark::DoNotOptimize(scene.transforms.data());
+  }
+  ReportTimePerEntity(state, scene);
+
+  // Live objects read Motion (new_position and spin) and write Transform.
+  ReportBytesTouched(state, scene, 0, sizeof(Motion) + sizeof(Transform));
+}
+BENCHMARK(BM_UpdatePositions)
+    ->ArgsProduct({
+        // size
+        {10000, 100000},
+        // destroyed_percent
+        {0, 50, 90},
+    })
+    ->Unit(benchmark::kMicrosecond);
+
+// A thousand attractors with a short cutoff distance, among size objects,
+// moving slowly enough that the neighbor lists rarely need rebuilding.
+Scene GenerateShortRange(const int size) {
+  std::mt19937 random_generator;
+  std::uniform_real_distribution<float> position_rg(-1e5, 1e5);
+  std::uniform_real_distribution<float> velocity_rg(-10, 10);
+
+  Scene scene;
+  for (int i = 0; i < size; ++i) {
+    const Vector3 position{position_rg(random_generator),
+                           position_rg(random_generator),
+                           position_rg(random_generator)};
+    const Vector3 velocity{velocity_rg(random_generator),
+                           velocity_rg(random_generator),
+                           velocity_rg(random_generator)};
+    scene.transforms.push_back(Transform{.position = position});
+    scene.mass.push_back(Mass{.inertial = 1,
+                              .active = i < 1000 ? 1e6f : 0,
+                              .cutoff_distance = 5e3});
+    scene.motion.push_back(Motion::FromPositionAndVelocity(position, velocity));
+  }
+  scene.flag_index.Rebuild(std::vector<Flags>(size));
+  return scene;
+}
+
+// Gravity with and without neighbor lists (skin of 0 turns them off).
+void BM_IntegrateShortRange(benchmark::State &state) {
+  Scene scene = GenerateShortRange(state.range(0));
+  NeighborLists lists;
+  lists.set_skin(state.range(1) / 100.0f);
+  MotionBuffers buffers;
+  for (auto _ : state) {
+    buffers.kinematics.Load(scene.transforms, scene.motion);
+    lists.Update(buffers.kinematics.position, scene.mass, scene.flag_index);
+    IntegrateVelocityVerlet(kDeltaTime, {}, scene.mass, scene.flag_index,
+                            MotionRegion{.neighbors = &lists},
+                            buffers.kinematics, buffers, scene.motion);
+    UpdatePositions(kDeltaTime, scene.motion, scene.flag_index,
+                    scene.transforms);
+  }
+
+  state.counters["rebuilds"] = lists.rebuilds();
+  state.SetItemsProcessed(state.iterations() * scene.transforms.size());
+}
+BENCHMARK(BM_IntegrateShortRange)
+    ->ArgsProduct({
+        // size
+        {10000, 100000},
+        // skin_percent
+        {0, 10},
+    })
+    ->Unit(benchmark::kMillisecond);
+
+// Two equal masses on a circular orbit around each other, 100 apart, with a
+// period of about 199 seconds.
+Scene GenerateBinary() {
+  const float m = 500;
+  const float speed = std::sqrt(2 * m / 100) / 2;
+  Scene scene;
+  for (const float side : {-1.0f, 1.0f}) {
+    const Vector3 position{50 * side, 0, 0};
+    scene.transforms.push_back(Transform{.position = position});
+    scene.mass.push_back(Mass{.inertial = m, .active = m});
+    scene.motion.push_back(
+        Motion::FromPositionAndVelocity(position, Vector3{0, speed * side, 0}));
+  }
+  scene.flag_index.Rebuild(std::vector<Flags>(2));
+  return scene;
+}
+
+// A heavy core and 31 light bodies on roughly circular orbits around it, at
+// radii between 50 and 200, in random planes. All of them pull on each other.
+// The innermost orbits take about 22 seconds.
+Scene GenerateCluster() {
+  std::mt19937 random_generator;
+  std::uniform_real_distribution<float> direction_rg(-1, 1);
+  std::uniform_real_distribution<float> radius_rg(50, 200);
+  const float core = 1e4;
+  Scene scene;
+  scene.transforms.push_back(Transform{});
+  scene.mass.push_back(Mass{.inertial = core, .active = core});
+  scene.motion.push_back(Motion{});
+  while (scene.transforms.size() < 32) {
+    const Vector3 direction{direction_rg(random_generator),
+                            direction_rg(random_generator),
+                            direction_rg(random_generator)};
+    const Vector3 axis{direction_rg(random_generator),
+                       direction_rg(random_generator),
+                       direction_rg(random_generator)};
+    const Vector3 tangent = Vector3::Cross(direction, axis);
+    if (Vector3::Magnitude(direction) > 1) continue;
+    if (Vector3::Magnitude(tangent) < 0.1) continue;
+    const float r = radius_rg(random_generator);
+    const Vector3 position = Vector3::Normalize(direction) * r;
+    const Vector3 velocity =
+        Vector3::Normalize(tangent) * std::sqrt(core / r);
+    scene.transforms.push_back(Transform{.position = position});
+    scene.mass.push_back(Mass{.inertial = 1, .active = 1});
+    scene.motion.push_back(Motion::FromPositionAndVelocity(position, velocity));
+  }
+  scene.flag_index.Rebuild(std::vector<Flags>(32));
+  return scene;
+}
+
+// Kinetic plus potential energy. Only correct if the inertial and active
+// masses are the same.
+double Energy(const Scene &scene) {
+  double energy = 0;
+  for (size_t i = 0; i < scene.transforms.size(); ++i) {
+    const Vector3 velocity = scene.motion[i].velocity;
+    energy += scene.mass[i].inertial * Vector3::SqrMagnitude(velocity) / 2;
+    for (size_t j = i + 1; j < scene.transforms.size(); ++j) {
+      energy -= scene.mass[i].active * scene.mass[j].active /
+                Vector3::Magnitude(scene.transforms[i].position -
+                                   scene.transforms[j].position);
+    }
+  }
+  return energy;
+}
+
+// Accuracy versus cost of the integrators: each iteration simulates the same
+// stretch of time (10 orbits of the binary, or 200 seconds of the cluster) in
+// the given number of steps, and reports how far the total energy drifted.
+// Compare the time of runs with similar drift.
+void BM_EnergyDrift(benchmark::State &state) {
+  const IntegrationMethod integrator =
+      static_cast<IntegrationMethod>(state.range(0));
+  const bool binary = state.range(1) == 0;
+  const Scene scene = binary ? GenerateBinary() : GenerateCluster();
+  const float duration = binary ? 10 * 2 * M_PI * std::sqrt(1e3f) : 200;
+  const int steps = state.range(2);
+  const float dt = duration / steps;
+  const double energy = Energy(scene);
+  double drift = 0;
+  for (auto _ : state) {
+    Scene run = scene;
+    MotionBuffers buffers;
+    for (int i = 0; i < steps; ++i) {
+      buffers.kinematics.Load(run.transforms, run.motion);
+      IntegrateMotion(integrator, dt, {}, run.mass, run.flag_index, buffers,
+                      run.motion);
+      UpdatePositions(dt, run.motion, run.flag_index, run.transforms);
+    }
+    drift = std::abs(Energy(run) / energy - 1);
+  }
+  state.counters["energy_drift"] = drift;
+  state.SetItemsProcessed(state.iterations() * steps);
+}
+BENCHMARK(BM_EnergyDrift)
+    ->ArgsProduct({
+        // integrator
+        {kFirstOrderEuler, kVelocityVerlet, kFourthOrderYoshida},
+        // scene (0 is the binary, 1 the cluster)
+        {0, 1},
+        // steps
+        {250, 1000, 4000},
+    })
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace vstr
+
+BENCHMARK_MAIN();
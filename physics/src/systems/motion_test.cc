@@ -49,6 +49,124 @@ TEST(MotionTest, GravityForceOn) {
                   Entity(1), Vector3{0, -100.0f / (100 * 100), 0})));
 }
 
+// Tests that the batched gravity used by the integrators agrees with
+// GravityForceOn, which evaluates one object at a time.
+TEST(MotionTest, IntegratedGravityMatchesGravityForceOn) {
+  std::mt19937 random_generator;
+  std::uniform_real_distribution<float> position_rg(-100, 100);
+  std::uniform_real_distribution<float> mass_rg(0, 10);
+  std::uniform_int_distribution<int> flags_rg(0, 7);
+
+  std::vector<Transform> positions;
+  std::vector<Mass> mass;
+  std::vector<Motion> motion;
+  std::vector<Flags> flags;
+  for (int i = 0; i < 64; ++i) {
+    positions.push_back(Transform{Vector3{position_rg(random_generator),
+                                          position_rg(random_generator),
+                                          position_rg(random_generator)}});
+    // Every other object has no active mass, and every third has a cutoff.
+    mass.push_back(Mass{.inertial = 1,
+                        .active = (i % 2) ? mass_rg(random_generator) : 0,
+                        .cutoff_distance = (i % 3) ? 0.0f : 100.0f});
+    motion.push_back(Motion{});
+    // Destroyed objects neither attract, nor get integrated.
+    flags.push_back(Flags{flags_rg(random_generator) == 0 ? Flags::kDestroyed
+                                                          : 0});
+  }
+
+  MotionBuffers buffers;
+  buffers.kinematics.Load(positions, motion);
+  FlagIndex flag_index;
+  flag_index.Rebuild(flags);
+  IntegrateMotion(kFirstOrderEuler, 1.0f / 60, {}, mass, flag_index, buffers,
+                  motion);
+
+  for (size_t i = 0; i < positions.size(); ++i) {
+    if (flags[i].value & Flags::kDestroyed) continue;
+    EXPECT_THAT(motion[i].acceleration,
+                Vector3ApproxEq(
+                    GravityForceOn(positions, mass, flags, Entity(i)), 1e-6))
+        << "object " << i;
+    EXPECT_EQ(motion[i].acceleration, buffers.kinematics.acceleration.Get(i));
+  }
+}
+
+TEST(MotionTest, KeepHeaviestAttractors) {
+  std::vector<Mass> mass{
+      Mass{.active = 5}, Mass{.active = 9}, Mass{},
+      Mass{.active = 9}, Mass{.active = 1}, Mass{.active = 7},
+  };
+  Vector3Array positions;
+  positions.resize(mass.size());
+  std::vector<Flags> flags(mass.size(), Flags{});
+  FlagIndex flag_index;
+  flag_index.Rebuild(flags);
+
+  Attractors attractors;
+  attractors.Rebuild(positions, mass, flag_index);
+  ASSERT_EQ(attractors.size(), 5);
+  attractors.KeepHeaviest(3);
+  // Ties go to the lower ID, and the order stays ascending.
+  EXPECT_THAT(attractors.id, testing::ElementsAre(1, 3, 5));
+  EXPECT_THAT(attractors.active, testing::ElementsAre(9, 9, 7));
+
+  attractors.KeepHeaviest(1);
+  EXPECT_THAT(attractors.id, testing::ElementsAre(1));
+  attractors.KeepHeaviest(0);
+  EXPECT_EQ(attractors.size(), 0);
+}
+
+TEST(MotionTest, BallisticObjects) {
+  std::vector<Transform> positions{
+      // An attractor with a short reach.
+      Transform{Vector3{0, 0, 0}},
+      // Out of reach, drifting.
+      Transform{Vector3{100, 0, 0}},
+      // Within reach.
+      Transform{Vector3{5, 0, 0}},
+      // Out of reach, but with input.
+      Transform{Vector3{0, 100, 0}},
+  };
+  std::vector<Mass> mass{
+      Mass{.inertial = 1, .active = 100, .cutoff_distance = 10},
+      Mass{.inertial = 1},
+      Mass{.inertial = 1},
+      Mass{.inertial = 1},
+  };
+  std::vector<Motion> motion(4, Motion{.velocity{1, 0, 0}});
+  std::vector<Flags> flags(4, Flags{});
+  std::vector<Event> input{
+      Event(Entity(3), {}, Acceleration{Vector3{0, 1, 0}}),
+  };
+
+  MotionBuffers buffers;
+  buffers.kinematics.Load(positions, motion);
+  FlagIndex flag_index;
+  flag_index.Rebuild(flags);
+  const float dt = 0.5;
+  IntegrateMotion(kVelocityVerlet, dt, absl::MakeSpan(input), mass, flag_index,
+                  buffers, motion);
+
+  // The attractor itself has nothing else pulling at it.
+  EXPECT_THAT(buffers.ballistic, testing::ElementsAre(0, 1));
+  EXPECT_THAT(buffers.moving, testing::ElementsAre(2, 3));
+  EXPECT_EQ(motion[1].new_position, (Vector3{100.5, 0, 0}));
+  EXPECT_EQ(motion[1].velocity, (Vector3{1, 0, 0}));
+  EXPECT_EQ(motion[1].acceleration, Vector3::Zero());
+  EXPECT_NE(motion[2].acceleration, Vector3::Zero());
+  EXPECT_NE(motion[3].acceleration, Vector3::Zero());
+
+  // Leftover acceleration from the last frame counts as a force, so object 3
+  // isn't ballistic until the frame after next.
+  buffers.kinematics.Load(positions, motion);
+  IntegrateMotion(kVelocityVerlet, dt, {}, mass, flag_index, buffers, motion);
+  EXPECT_THAT(buffers.ballistic, testing::ElementsAre(0, 1));
+  buffers.kinematics.Load(positions, motion);
+  IntegrateMotion(kVelocityVerlet, dt, {}, mass, flag_index, buffers, motion);
+  EXPECT_THAT(buffers.ballistic, testing::ElementsAre(0, 1, 3));
+}
+
 // Tests that the Verlet velocity integrator takes velocity input.
 TEST(MotionTest, ObjectStaysInMotion) {
   const float dt = 1.0f / 60;
@@ -141,6 +259,64 @@ TEST(MotionTest, FallingPointMass) {
   EXPECT_GT(positions[0].position.y, 0);
 }
 
+// Total energy of a light object on a circular orbit around a heavy one.
+float OrbitEnergy(const std::vector<Transform> &positions,
+                  const std::vector<Motion> &motion, const float mu) {
+  return Vector3::SqrMagnitude(motion[0].velocity) / 2 -
+         mu / Vector3::Magnitude(positions[0].position -
+                                 positions[1].position);
+}
+
+TEST(MotionTest, FourthOrderOrbit) {
+  // With 40 or 80 steps per orbit, Verlet's energy is off by tens of percent
+  // after ten orbits, while Yoshida's error is down to float rounding. Halving
+  // the step cuts Yoshida's error in position about 16-fold.
+  const float mu = 1000;
+  const float r = 100;
+  const float period = 2 * M_PI * std::sqrt(r * r * r / mu);
+  const float energy = -mu / (2 * r);
+
+  float position_error[2];
+  for (const int steps : {40, 80}) {
+    const float dt = period / steps;
+    for (const IntegrationMethod integrator :
+         {kVelocityVerlet, kFourthOrderYoshida}) {
+      std::vector<Transform> positions{
+          Transform{Vector3{r, 0, 0}},
+          Transform{Vector3{0, 0, 0}},
+      };
+      std::vector<Mass> mass{
+          Mass{},
+          Mass{.inertial = mu, .active = mu},
+      };
+      std::vector<Motion> motion{
+          Motion{Vector3{0, std::sqrt(mu / r), 0}},
+          Motion{},
+      };
+      std::vector<Flags> flags{
+          Flags{},
+          Flags{},
+      };
+
+      float worst = 0;
+      for (int i = 0; i < 10 * steps; ++i) {
+        IntegrateMotion(integrator, dt, {}, positions, mass, flags, motion);
+        UpdatePositions(dt, motion, flags, positions);
+        worst = std::max(
+            worst, std::abs(OrbitEnergy(positions, motion, mu) / energy - 1));
+      }
+      if (integrator == kVelocityVerlet) {
+        EXPECT_GT(worst, 0.1) << steps;
+        continue;
+      }
+      EXPECT_LT(worst, 1e-4) << steps;
+      position_error[steps == 80] = Vector3::Magnitude(
+          positions[0].position - Vector3{r, 0, 0});
+    }
+  }
+  EXPECT_GT(position_error[0] / position_error[1], 10);
+}
+
 TEST(MotionTest, PointMassHover) {
   // Point particle 0 of neglibile mass is hovering 100 meters over point
   // particle 1 which has 100 kg of mass. Input each frame sets acceleration of
@@ -0,0 +1,99 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "neighbor_lists.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace vstr {
+
+void NeighborLists::Update(const Vector3Array &positions,
+                           const std::vector<Mass> &mass,
+                           const FlagIndex &flag_index) {
+  attractors_.Rebuild(positions, mass, flag_index);
+  valid_ = skin_ > 0 &&
+           std::find(attractors_.cutoff_sqr.begin(),
+                     attractors_.cutoff_sqr.end(),
+                     std::numeric_limits<float>::infinity()) ==
+               attractors_.cutoff_sqr.end();
+  if (!valid_) {
+    built_ = false;
+    return;
+  }
+  if (NeedsRebuild(positions)) Rebuild(positions);
+}
+
+bool NeighborLists::NeedsRebuild(const Vector3Array &positions) const {
+  if (!built_ || positions.size() != built_position_.size() ||
+      attractors_.id != built_id_ ||
+      attractors_.cutoff_sqr != built_cutoff_sqr_) {
+    return true;
+  }
+
+  // Attractors are objects too, so this covers them. If neither an object nor
+  // an attractor moved by more than half the margin, the distance between
+  // them didn't shrink by more than the margin.
+  const size_t count = positions.size();
+  bool drifted = false;
+  for (size_t i = 0; i < count; ++i) {
+    const float dx = positions.x[i] - built_position_.x[i];
+    const float dy = positions.y[i] - built_position_.y[i];
+    const float dz = positions.z[i] - built_position_.z[i];
+    drifted |= dx * dx + dy * dy + dz * dz > max_drift_sqr_;
+  }
+  return drifted;
+}
+
+void NeighborLists::Rebuild(const Vector3Array &positions) {
+  ++rebuilds_;
+  built_ = true;
+  built_position_ = positions;
+  built_id_ = attractors_.id;
+  built_cutoff_sqr_ = attractors_.cutoff_sqr;
+
+  const size_t attractor_count = attractors_.size();
+  float min_margin = std::numeric_limits<float>::infinity();
+  reach_sqr_.resize(attractor_count);
+  kvs_.clear();
+  for (size_t j = 0; j < attractor_count; ++j) {
+    const float cutoff = std::sqrt(attractors_.cutoff_sqr[j]);
+    const float margin = cutoff * skin_;
+    const float reach = cutoff + margin;
+    min_margin = std::min(min_margin, margin);
+    reach_sqr_[j] = reach * reach;
+    const Vector3 center = attractors_.position.Get(j);
+    const Vector3 extent{reach, reach, reach};
+    kvs_.push_back(BVH::KV(AABB(center - extent, center + extent), j));
+  }
+  max_drift_sqr_ = (min_margin / 2) * (min_margin / 2);
+  if (!kvs_.empty()) bvh_.Rebuild(kvs_);
+
+  const size_t count = positions.size();
+  begin_.resize(count + 1);
+  list_.clear();
+  for (size_t i = 0; i < count; ++i) {
+    begin_[i] = list_.size();
+    if (kvs_.empty()) continue;
+    const Vector3 p = positions.Get(i);
+    hits_.clear();
+    bvh_.Overlap(AABB(p, p), hits_);
+    for (const auto &kv : hits_) {
+      const int32_t j = kv.value;
+      const float dx = attractors_.position.x[j] - p.x;
+      const float dy = attractors_.position.y[j] - p.y;
+      const float dz = attractors_.position.z[j] - p.z;
+      if (dx * dx + dy * dy + dz * dz <= reach_sqr_[j]) list_.push_back(j);
+    }
+    // Gravity must be summed in the same order as without the lists.
+    std::sort(list_.begin() + begin_[i], list_.end());
+  }
+  begin_[count] = list_.size();
+}
+
+}  // namespace vstr
@@ -0,0 +1,97 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_NEIGHBOR_LISTS
+#define VSTR_NEIGHBOR_LISTS
+
+#include <absl/types/span.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "geometry/bvh.h"
+#include "systems/motion.h"
+#include "types/flag_index.h"
+#include "types/kinematics.h"
+
+namespace vstr {
+
+// Verlet neighbor lists for short-range gravity: for each object, the
+// attractors within their cutoff distance plus a margin (the skin). As long as
+// no object has moved by more than half the smallest margin since the lists
+// were built, every attractor in reach of an object is on its list, and
+// gravity only needs to visit the lists. The lists are rebuilt (using a BVH)
+// when that's no longer true, or when the set of attractors changes.
+//
+// The lists can only help if every attractor has a cutoff. When one doesn't,
+// they're not valid, and the integrators fall back to visiting every
+// attractor.
+class NeighborLists {
+ public:
+  // Brings the attractors and the lists up to date with the frame. Call once
+  // per frame, before integrating.
+  void Update(const Vector3Array &positions, const std::vector<Mass> &mass,
+              const FlagIndex &flag_index);
+
+  // Whether the lists may be used this frame.
+  inline bool valid() const { return valid_; }
+
+  // The attractors at the last Update. The lists hold offsets into these.
+  inline const Attractors &attractors() const { return attractors_; }
+
+  // Offsets into attractors() of those that might be in reach of the object,
+  // in ascending order. Only meaningful if valid().
+  inline absl::Span<const int32_t> Of(const int32_t id) const {
+    return absl::MakeConstSpan(list_.data() + begin_[id],
+                               begin_[id + 1] - begin_[id]);
+  }
+
+  // The margin, as a fraction of each attractor's cutoff distance. With zero,
+  // the lists are never valid. A wider skin means fewer rebuilds, but longer
+  // lists.
+  inline void set_skin(const float skin) {
+    skin_ = skin;
+    built_ = false;
+  }
+  inline float skin() const { return skin_; }
+
+  // How many times the lists were built, for tuning the skin.
+  inline int rebuilds() const { return rebuilds_; }
+
+ private:
+  bool NeedsRebuild(const Vector3Array &positions) const;
+  void Rebuild(const Vector3Array &positions);
+
+  using BVH = BoundingVolumeHierarchy<int32_t>;
+
+  float skin_ = 0.1;
+  bool valid_ = false;
+  bool built_ = false;
+  int rebuilds_ = 0;
+
+  Attractors attractors_;
+  // The lists, one after another. The list of object i starts at begin_[i]
+  // and ends at begin_[i + 1].
+  std::vector<int32_t> begin_;
+  std::vector<int32_t> list_;
+
+  // The state the lists were built for.
+  Vector3Array built_position_;
+  std::vector<int32_t> built_id_;
+  std::vector<float> built_cutoff_sqr_;
+  // Half the smallest margin, squared.
+  float max_drift_sqr_;
+
+  BVH bvh_;
+  std::vector<BVH::KV> kvs_;
+  std::vector<BVH::KV> hits_;
+  std::vector<float> reach_sqr_;
+};
+
+}  // namespace vstr
+
+#endif
@@ -0,0 +1,184 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "neighbor_lists.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <random>
+
+namespace vstr {
+namespace {
+
+TEST(NeighborListsTest, Basic) {
+  std::vector<Vector3> points{
+      Vector3{0, 0, 0}, Vector3{0, 15, 0}, Vector3{0, 105, 0},
+      Vector3{0, 100, 0}, Vector3{0, 50, 0},
+  };
+  Vector3Array positions;
+  for (const Vector3 &p : points) {
+    positions.x.push_back(p.x);
+    positions.y.push_back(p.y);
+    positions.z.push_back(p.z);
+  }
+  std::vector<Mass> mass{
+      Mass{.active = 1, .cutoff_distance = 10},
+      Mass{},
+      Mass{},
+      Mass{.active = 1, .cutoff_distance = 10},
+      Mass{},
+  };
+  FlagIndex flag_index;
+  flag_index.Rebuild(std::vector<Flags>(points.size()));
+
+  // Object 1 is just outside the reach of attractor 0, but within the margin.
+  NeighborLists lists;
+  lists.set_skin(0.6);
+  lists.Update(positions, mass, flag_index);
+  ASSERT_TRUE(lists.valid());
+  EXPECT_EQ(lists.rebuilds(), 1);
+  EXPECT_THAT(lists.attractors().id, testing::ElementsAre(0, 3));
+  EXPECT_THAT(lists.Of(0), testing::ElementsAre(0));
+  EXPECT_THAT(lists.Of(1), testing::ElementsAre(0));
+  EXPECT_THAT(lists.Of(2), testing::ElementsAre(1));
+  EXPECT_THAT(lists.Of(3), testing::ElementsAre(1));
+  EXPECT_THAT(lists.Of(4), testing::IsEmpty());
+
+  // Moving by less than half the margin (3) keeps the lists.
+  positions.y[4] = 52;
+  lists.Update(positions, mass, flag_index);
+  EXPECT_EQ(lists.rebuilds(), 1);
+  positions.y[4] = 54;
+  lists.Update(positions, mass, flag_index);
+  EXPECT_EQ(lists.rebuilds(), 2);
+
+  // Changing an attractor's mass keeps them too, but changing its cutoff
+  // doesn't.
+  mass[0].active = 2;
+  lists.Update(positions, mass, flag_index);
+  EXPECT_EQ(lists.rebuilds(), 2);
+  mass[0].cutoff_distance = 20;
+  lists.Update(positions, mass, flag_index);
+  EXPECT_EQ(lists.rebuilds(), 3);
+
+  // An attractor without a cutoff makes the lists useless.
+  mass[4].active = 1;
+  lists.Update(positions, mass, flag_index);
+  EXPECT_FALSE(lists.valid());
+}
+
+// Integrating with neighbor lists must give exactly the same result as without,
+// frame after frame, as the lists go stale and get rebuilt.
+TEST(NeighborListsTest, IntegrationMatchesWithout) {
+  std::mt19937 random_generator;
+  std::uniform_real_distribution<float> position_rg(-500, 500);
+  std::uniform_real_distribution<float> velocity_rg(-5, 5);
+
+  std::vector<Transform> transforms;
+  std::vector<Motion> motion;
+  std::vector<Mass> mass;
+  std::vector<Flags> flags;
+  for (int i = 0; i < 400; ++i) {
+    const Vector3 position{position_rg(random_generator),
+                           position_rg(random_generator),
+                           position_rg(random_generator)};
+    const Vector3 velocity{velocity_rg(random_generator),
+                           velocity_rg(random_generator),
+                           velocity_rg(random_generator)};
+    transforms.push_back(Transform{.position = position});
+    motion.push_back(Motion::FromPositionAndVelocity(position, velocity));
+    mass.push_back(Mass{.inertial = 1,
+                        .active = i % 8 ? 0.0f : 1e3f,
+                        .cutoff_distance = 100});
+    flags.push_back(Flags{});
+  }
+  FlagIndex flag_index;
+  flag_index.Rebuild(flags);
+
+  for (const IntegrationMethod integrator :
+       {kFirstOrderEuler, kVelocityVerlet, kFourthOrderYoshida}) {
+    std::vector<Transform> expected_transforms = transforms;
+    std::vector<Motion> expected = motion;
+    std::vector<Transform> got_transforms = transforms;
+    std::vector<Motion> got = motion;
+    MotionBuffers expected_buffers;
+    MotionBuffers got_buffers;
+    NeighborLists lists;
+
+    for (int frame_no = 0; frame_no < 60; ++frame_no) {
+      expected_buffers.kinematics.Load(expected_transforms, expected);
+      IntegrateMotion(integrator, 0.1, {}, mass, flag_index, expected_buffers,
+                      expected);
+      UpdatePositions(0.1, expected, flag_index, expected_transforms);
+
+      got_buffers.kinematics.Load(got_transforms, got);
+      lists.Update(got_buffers.kinematics.position, mass, flag_index);
+      ASSERT_TRUE(lists.valid());
+      IntegrateMotion(integrator, 0.1, {}, mass, flag_index,
+                      MotionRegion{.neighbors = &lists},
+                      got_buffers.kinematics, got_buffers, got);
+      UpdatePositions(0.1, got, flag_index, got_transforms);
+
+      for (size_t i = 0; i < motion.size(); ++i) {
+        ASSERT_EQ(got[i].velocity, expected[i].velocity)
+            << frame_no << " " << i;
+        ASSERT_EQ(got[i].new_position, expected[i].new_position)
+            << frame_no << " " << i;
+      }
+    }
+
+    // The lists went stale, but not every frame.
+    EXPECT_GT(lists.rebuilds(), 1);
+    EXPECT_LT(lists.rebuilds(), 60);
+  }
+}
+
+// Yoshida evaluates gravity mid-step. An attractor that starts out of range,
+// but passes by the object during the step, must still pull on it, even though
+// the neighbor lists only saw where it started.
+TEST(NeighborListsTest, FastFlyByWithYoshida) {
+  std::vector<Transform> transforms{
+      Transform{.position{0, 0, 0}},
+      Transform{.position{15, 1, 0}},
+  };
+  std::vector<Mass> mass{
+      Mass{.inertial = 1},
+      Mass{.inertial = 1e3, .active = 1e3, .cutoff_distance = 10},
+  };
+  std::vector<Motion> motion{
+      Motion{},
+      Motion{.velocity{-200, 0, 0}},
+  };
+  std::vector<Flags> flags{Flags{}, Flags{}};
+  FlagIndex flag_index;
+  flag_index.Rebuild(flags);
+
+  std::vector<Motion> expected = motion;
+  MotionBuffers expected_buffers;
+  expected_buffers.kinematics.Load(transforms, expected);
+  IntegrateMotion(kFourthOrderYoshida, 0.1, {}, mass, flag_index,
+                  expected_buffers, expected);
+
+  std::vector<Motion> got = motion;
+  MotionBuffers got_buffers;
+  got_buffers.kinematics.Load(transforms, got);
+  NeighborLists lists;
+  lists.Update(got_buffers.kinematics.position, mass, flag_index);
+  ASSERT_TRUE(lists.valid());
+  EXPECT_TRUE(lists.Of(0).empty());
+  IntegrateMotion(kFourthOrderYoshida, 0.1, {}, mass, flag_index,
+                  MotionRegion{.neighbors = &lists}, got_buffers.kinematics,
+                  got_buffers, got);
+
+  EXPECT_NE(expected[0].velocity, Vector3::Zero());
+  EXPECT_EQ(got[0].velocity, expected[0].velocity);
+  EXPECT_EQ(got[0].new_position, expected[0].new_position);
+}
+
+}  // namespace
+}  // namespace vstr
@@ -10,13 +10,13 @@
 namespace vstr {
 namespace {
 
-Entity ClaimFromPool(ReusePool &pool, std::vector<ReuseTag> &reuse_tags) {
+Entity ClaimFromPool(ReusePool &pool, SparseSet<ReuseTag> &reuse_tags) {
   Entity id = pool.first_id;
   if (id != Entity::Nil()) {
-    ssize_t idx = FindOptionalComponent(reuse_tags, id);
-    assert(idx >= 0);
-    pool.first_id = reuse_tags[idx].next_id;
-    reuse_tags[idx].next_id = Entity::Nil();
+    ReuseTag *tag = id.Get(reuse_tags);
+    assert(tag != nullptr);
+    pool.first_id = tag->next_id;
+    tag->next_id = Entity::Nil();
     --pool.free_count;
     ++pool.in_use_count;
   }
@@ -24,19 +24,20 @@ Entity ClaimFromPool(ReusePool &pool, std::vector<ReuseTag> &reuse_tags) {
   return id;
 }
 
-void CopyObject(const Entity dst, const Entity src, Frame &frame) {
-  dst.Set(frame.mass, src.Get(frame.mass));
-  dst.Set(frame.colliders, src.Get(frame.colliders));
-  dst.Set(frame.glue, src.Get(frame.glue));
-  dst.Set(frame.flags, src.Get(frame.flags));
-  dst.Set(frame.transforms, src.Get(frame.transforms));
-  dst.Set(frame.motion, src.Get(frame.motion));
-
-  CopyOptionalComponent(dst, src, frame.orbits);
-  CopyOptionalComponent(dst, src, frame.durability);
-  CopyOptionalComponent(dst, src, frame.rockets);
-  CopyOptionalComponent(dst, src, frame.triggers);
-  CopyOptionalComponent(dst, src, frame.reuse_tags);
+// Claims an object from the pool with the given ID. Returns Entity::Nil if
+// there's no such pool, or if it has no free objects.
+Entity ClaimFromPool(const Entity pool_id, SparseSet<ReusePool> &reuse_pools,
+                     SparseSet<ReuseTag> &reuse_tags) {
+  ReusePool *pool = pool_id.Get(reuse_pools);
+  if (pool == nullptr) return Entity::Nil();
+  return ClaimFromPool(*pool, reuse_tags);
+}
+
+Event SpawnEvent(const Entity id, const Entity pool_id, const Vector3 &position,
+                 const Quaternion &rotation, const Vector3 &velocity) {
+  return Event(
+      id, position,
+      Spawn{.pool_id = pool_id, .rotation = rotation, .velocity = velocity});
 }
 
 void ReturnToPool(const Entity id, ReuseTag &tag, ReusePool &pool) {
@@ -62,10 +63,11 @@ int32_t InitializePool(const Entity pool_id, const Entity prototype_id,
                    ReuseTag{.next_id = Entity::Nil(), .pool_id = pool_id});
 
   prototype_id.Get(frame.flags).value |= Flags::kReusable | Flags::kDestroyed;
+  frame.flag_index.Set(prototype_id, prototype_id.Get(frame.flags));
 
   for (int i = 0; i < capacity - 1; ++i) {
     Entity id = frame.Push();
-    CopyObject(id, prototype_id, frame);
+    frame.CopyObject(id, prototype_id);
     ReleaseObject(id, frame.flags, frame.reuse_pools, frame.reuse_tags);
   }
   // The dereference of Get's return value is safe because we created the
@@ -83,8 +85,8 @@ int32_t InitializePool(const Entity pool_id, const Entity prototype_id,
 }
 
 void ReleaseObject(const Entity id, const std::vector<Flags> &flags,
-                   std::vector<ReusePool> &reuse_pools,
-                   std::vector<ReuseTag> &reuse_tags) {
+                   SparseSet<ReusePool> &reuse_pools,
+                   SparseSet<ReuseTag> &reuse_tags) {
   assert(id.Get(flags).value & Flags::kReusable);
 
   ReuseTag *tag = id.Get(reuse_tags);
@@ -97,13 +99,18 @@ void ReleaseObject(const Entity id, const std::vector<Flags> &flags,
 }
 
 void ConvertSpawnAttempts(absl::Span<Event> in_events,
-                          std::vector<Event> &out_events, Frame &frame) {
+                          std::vector<Event> &out_events,
+                          SparseSet<ReusePool> &reuse_pools,
+                          SparseSet<ReuseTag> &reuse_tags) {
   for (const Event &event : in_events) {
     if (event.type != Event::kSpawnAttempt) continue;
-    auto spawn_event = SpawnEventFromPool(event.id, event.position,
-                                          event.spawn_attempt.rotation,
-                                          event.spawn_attempt.velocity, frame);
-    if (spawn_event.ok()) out_events.push_back(spawn_event.value());
+    // Failed attempts are routine (the pool runs dry), so this skips the
+    // absl::Status that SpawnEventFromPool would allocate to explain them.
+    const Entity id = ClaimFromPool(event.id, reuse_pools, reuse_tags);
+    if (id == Entity::Nil()) continue;
+    out_events.push_back(SpawnEvent(id, event.id, event.position,
+                                    event.spawn_attempt.rotation,
+                                    event.spawn_attempt.velocity));
   }
 }
 
@@ -122,25 +129,7 @@ absl::StatusOr<Event> SpawnEventFromPool(const Entity pool_id,
         "no free objects available in the pool");
   }
 
-  return Event(
-      tag_id, position,
-      Spawn{.pool_id = pool_id, .rotation = rotation, .velocity = velocity});
-}
-
-void SpawnObject(const Event &spawn_event, Frame &frame) {
-  const Entity id = spawn_event.id;
-  id.Get(frame.flags).value &= ~Flags::kDestroyed;
-  id.Get(frame.transforms).position = spawn_event.position;
-  id.Get(frame.transforms).rotation = spawn_event.spawn.rotation;
-  id.Get(frame.motion) = Motion::FromPositionAndVelocity(
-      spawn_event.position, spawn_event.spawn.velocity);
-
-  // When spawning objects that have a durability component, heal them to their
-  // max hit points.
-  Durability *durability = id.Get(frame.durability);
-  if (durability != nullptr) {
-    durability->value = durability->max;
-  }
+  return SpawnEvent(tag_id, pool_id, position, rotation, velocity);
 }
 
 }  // namespace vstr
@@ -17,7 +17,18 @@
 namespace vstr {
 
 void ConvertSpawnAttempts(absl::Span<Event> in_events,
-                          std::vector<Event> &out_events, Frame &frame);
+                          std::vector<Event> &out_events,
+                          SparseSet<ReusePool> &reuse_pools,
+                          SparseSet<ReuseTag> &reuse_tags);
+
+// Same as above, for any BasicFrame with reuse pools.
+template <typename FrameType>
+inline void ConvertSpawnAttempts(absl::Span<Event> in_events,
+                                 std::vector<Event> &out_events,
+                                 FrameType &frame) {
+  ConvertSpawnAttempts(in_events, out_events, frame.reuse_pools,
+                       frame.reuse_tags);
+}
 
 // Claims a free object from the pool and returns an event that will spawn it.
 // Fails if there are no free objects.
@@ -27,14 +38,33 @@ absl::StatusOr<Event> SpawnEventFromPool(Entity pool_id,
                                          const Vector3 &velocity, Frame &frame);
 
 // Spawns the object from the event generated by SpawnEventFromPool.
-void SpawnObject(const Event &spawn_event, Frame &frame);
+// Works with any BasicFrame.
+template <typename FrameType>
+void SpawnObject(const Event &spawn_event, FrameType &frame) {
+  const Entity id = spawn_event.id;
+  id.Get(frame.flags).value &= ~Flags::kDestroyed;
+  frame.flag_index.Set(id, id.Get(frame.flags));
+  id.Get(frame.transforms).position = spawn_event.position;
+  id.Get(frame.transforms).rotation = spawn_event.spawn.rotation;
+  id.Get(frame.motion) = Motion::FromPositionAndVelocity(
+      spawn_event.position, spawn_event.spawn.velocity);
+
+  // When spawning objects that have a durability component, heal them to their
+  // max hit points.
+  if constexpr (FrameType::template kHas<Durability>) {
+    Durability *durability = id.Get(frame.durability);
+    if (durability != nullptr) {
+      durability->value = durability->max;
+    }
+  }
+}
 
 // Releases the object back into its pool for future reuse. Does nothing if the
 // object is not reusable. DOES NOT DESTROY THE OBJECT - the caller must do
 // that, if desired.
 void ReleaseObject(Entity id, const std::vector<Flags> &flags,
-                   std::vector<ReusePool> &reuse_pools,
-                   std::vector<ReuseTag> &reuse_tags);
+                   SparseSet<ReusePool> &reuse_pools,
+                   SparseSet<ReuseTag> &reuse_tags);
 
 // Initializes the pool by copying the prototype up to capacity. The prototype
 // will become one of the reusable objects and be set to destroyed in the
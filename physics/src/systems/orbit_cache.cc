@@ -0,0 +1,72 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "orbit_cache.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace vstr {
+
+void OrbitCache::Fill(const float dt, const int first_frame_no,
+                      const int frames, const SparseSet<Orbit> &orbits) {
+  dt_ = dt;
+  first_frame_no_ = first_frame_no;
+  frames_ = 0;
+  orbits_.assign(orbits.begin(), orbits.end());
+  positions_.resize(0);
+  Compute(first_frame_no, frames);
+}
+
+void OrbitCache::Extend(const int frames, const int capacity) {
+  Compute(end_frame_no(), frames);
+  if (frames_ <= capacity) return;
+
+  const int dropped = frames_ - capacity;
+  const size_t n = dropped * orbits_.size();
+  positions_.x.erase(positions_.x.begin(), positions_.x.begin() + n);
+  positions_.y.erase(positions_.y.begin(), positions_.y.begin() + n);
+  positions_.z.erase(positions_.z.begin(), positions_.z.begin() + n);
+  first_frame_no_ += dropped;
+  frames_ = capacity;
+}
+
+bool OrbitCache::Matches(const float dt, const SparseSet<Orbit> &orbits) const {
+  return dt == dt_ && orbits.size() == orbits_.size() &&
+         std::equal(orbits.begin(), orbits.end(), orbits_.begin());
+}
+
+void OrbitCache::Compute(const int first_frame_no, const int frames) {
+  assert(first_frame_no == end_frame_no());
+  size_t i = positions_.size();
+  positions_.resize(i + frames * orbits_.size());
+  for (int frame_no = first_frame_no; frame_no < first_frame_no + frames;
+       ++frame_no) {
+    // Same as in UpdateOrbitalMotion.
+    const Vector3Array &row = solver_.Solve(dt_ * frame_no, orbits_);
+    std::copy(row.x.begin(), row.x.end(), positions_.x.begin() + i);
+    std::copy(row.y.begin(), row.y.end(), positions_.y.begin() + i);
+    std::copy(row.z.begin(), row.z.end(), positions_.z.begin() + i);
+    i += orbits_.size();
+  }
+  frames_ += frames;
+}
+
+void UpdateOrbitalMotion(const OrbitCache &cache, const int frame_no,
+                         const std::vector<Transform> &transforms,
+                         const SparseSet<Orbit> &orbits,
+                         std::vector<Motion> &motion) {
+  assert(frame_no >= cache.first_frame_no() && frame_no < cache.end_frame_no());
+  size_t k = 0;
+  for (const auto &orbit : orbits) {
+    Motion &m = orbit.id.Get(motion);
+    m.new_position = cache.Get(frame_no, k++);
+    m.velocity = m.new_position - orbit.id.Get(transforms).position;
+  }
+}
+
+}  // namespace vstr
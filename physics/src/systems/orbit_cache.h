@@ -0,0 +1,86 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_ORBIT_CACHE
+#define VSTR_ORBIT_CACHE
+
+#include <limits>
+#include <vector>
+
+#include "systems/kepler.h"
+#include "types/kinematics.h"
+#include "types/optional_components.h"
+#include "types/required_components.h"
+
+namespace vstr {
+
+// Positions of orbiting objects over a window of frames, computed ahead of
+// time. Orbits are closed-form, so the position at a frame only depends on the
+// Orbit components (the body's and its parents') and the time, dt × frame_no.
+// The cache computes them with a KeplerSolver, the same way UpdateOrbitalMotion
+// does, so reading them back gives the same result, bit for bit.
+//
+// Positions are stored in SoA layout, one row of orbits per frame, in the order
+// of the SparseSet.
+class OrbitCache {
+ public:
+  // Discards the cache, then computes positions for frames [first_frame_no,
+  // first_frame_no + frames).
+  void Fill(float dt, int first_frame_no, int frames,
+            const SparseSet<Orbit> &orbits);
+
+  // Computes positions for the frames after the last one cached, then drops
+  // the oldest frames, so that at most capacity frames stay cached.
+  void Extend(int frames, int capacity);
+
+  // Whether the cache was filled with the same dt and orbits.
+  bool Matches(float dt, const SparseSet<Orbit> &orbits) const;
+
+  // Discards the cache, so that the next Matches fails.
+  inline void Clear() {
+    dt_ = std::numeric_limits<float>::quiet_NaN();
+    frames_ = 0;
+  }
+
+  // See KeplerSolver::set_basis_tolerance. Clears the cache.
+  inline void set_basis_tolerance(const float degrees) {
+    solver_.set_basis_tolerance(degrees);
+    Clear();
+  }
+
+  // The cache holds frames [first_frame_no, end_frame_no).
+  inline int first_frame_no() const { return first_frame_no_; }
+  inline int end_frame_no() const { return first_frame_no_ + frames_; }
+
+  // Position of the kth orbit at frame_no, which must be cached.
+  inline Vector3 Get(const int frame_no, const size_t k) const {
+    return positions_.Get((frame_no - first_frame_no_) * orbits_.size() + k);
+  }
+
+ private:
+  void Compute(int first_frame_no, int frames);
+
+  float dt_ = std::numeric_limits<float>::quiet_NaN();
+  int first_frame_no_ = 0;
+  int frames_ = 0;
+  // Copies of the orbits the cache was filled for.
+  std::vector<Orbit> orbits_;
+  Vector3Array positions_;
+  KeplerSolver solver_;
+};
+
+// Same as UpdateOrbitalMotion with a KeplerSolver and t = dt × frame_no, but
+// reads the positions from the cache, which must match the orbits and cover
+// frame_no.
+void UpdateOrbitalMotion(const OrbitCache &cache, int frame_no,
+                         const std::vector<Transform> &transforms,
+                         const SparseSet<Orbit> &orbits,
+                         std::vector<Motion> &motion);
+
+}  // namespace vstr
+
+#endif
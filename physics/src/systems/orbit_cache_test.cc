@@ -0,0 +1,81 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "orbit_cache.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "systems/kepler.h"
+
+namespace vstr {
+namespace {
+
+SparseSet<Orbit> GenerateOrbits(const int count) {
+  SparseSet<Orbit> orbits;
+  for (int i = 0; i < count; ++i) {
+    Orbit &orbit = orbits.GetOrInit(Entity(i * 2));
+    orbit.focus = Vector3{static_cast<float>(i), 0, 0};
+    orbit.epoch.semi_major_axis = 10 + i;
+    orbit.epoch.eccentricity = 0.05 * i;
+    orbit.epoch.inclination_deg = 3 * i;
+    orbit.delta.mean_longitude_deg = 1 + i;
+  }
+  return orbits;
+}
+
+TEST(OrbitCacheTest, MatchesDirect) {
+  const float dt = 1.0f / 60;
+  const SparseSet<Orbit> orbits = GenerateOrbits(8);
+  std::vector<Transform> transforms(16);
+  std::vector<Motion> expected(16);
+  std::vector<Motion> got(16);
+
+  KeplerSolver solver;
+  OrbitCache cache;
+  cache.Fill(dt, 100, 10, orbits);
+  ASSERT_TRUE(cache.Matches(dt, orbits));
+  for (int frame_no = 100; frame_no < 200; ++frame_no) {
+    if (frame_no == cache.end_frame_no()) cache.Extend(10, 30);
+    UpdateOrbitalMotion(solver, dt * frame_no, transforms, orbits, expected);
+    UpdateOrbitalMotion(cache, frame_no, transforms, orbits, got);
+    for (int i = 0; i < 16; ++i) {
+      ASSERT_EQ(got[i].new_position, expected[i].new_position)
+          << frame_no << " " << i;
+      ASSERT_EQ(got[i].velocity, expected[i].velocity) << frame_no << " " << i;
+    }
+    for (int i = 0; i < 16; ++i) {
+      transforms[i].position = expected[i].new_position;
+    }
+  }
+
+  // Old frames were dropped to keep the cache within capacity.
+  EXPECT_EQ(cache.first_frame_no(), 170);
+  EXPECT_EQ(cache.end_frame_no(), 200);
+}
+
+TEST(OrbitCacheTest, Matches) {
+  const float dt = 1.0f / 60;
+  SparseSet<Orbit> orbits = GenerateOrbits(4);
+  OrbitCache cache;
+  cache.Fill(dt, 0, 10, orbits);
+  EXPECT_TRUE(cache.Matches(dt, orbits));
+  EXPECT_FALSE(cache.Matches(dt * 2, orbits));
+
+  orbits.Find(Entity(2))->delta.mean_longitude_deg = 5;
+  EXPECT_FALSE(cache.Matches(dt, orbits));
+  orbits = GenerateOrbits(5);
+  EXPECT_FALSE(cache.Matches(dt, orbits));
+
+  cache.Fill(dt, 0, 10, orbits);
+  EXPECT_TRUE(cache.Matches(dt, orbits));
+  cache.Clear();
+  EXPECT_FALSE(cache.Matches(dt, orbits));
+}
+
+}  // namespace
+}  // namespace vstr
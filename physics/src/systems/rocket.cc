@@ -18,11 +18,9 @@ namespace {
 
 absl::StatusOr<Event> ApplyRocketBurn(const float dt, const Event &event,
                                       std::vector<Mass> &mass,
-                                      std::vector<Rocket> &rockets) {
-  auto it = std::lower_bound(
-      rockets.begin(), rockets.end(), Rocket{.id = event.id},
-      [](const Rocket &a, const Rocket &b) { return a.id < b.id; });
-  if (it == rockets.end() || it->id != event.id) {
+                                      SparseSet<Rocket> &rockets) {
+  Rocket *rocket = event.id.Get(rockets);
+  if (rocket == nullptr) {
     // Invalid state - the burn event targets an object with no rocket
     // component.
     return absl::NotFoundError("object has no Rocket component");
@@ -31,17 +29,18 @@ absl::StatusOr<Event> ApplyRocketBurn(const float dt, const Event &event,
   if (event.rocket_burn.fuel_tank >= Rocket::kMaxFuelTanks) {
     return absl::OutOfRangeError("no such fuel tank");
   }
-  if (it->fuel_tanks[event.rocket_burn.fuel_tank].fuel <= 0) {
+  if (rocket->fuel_tanks[event.rocket_burn.fuel_tank].fuel <= 0) {
     return absl::ResourceExhaustedError("fuel tank empty");
   }
   const float throttle = Vector3::Magnitude(event.rocket_burn.thrust);
   const Vector3 thrust = event.rocket_burn.thrust *
-                         it->fuel_tanks[event.rocket_burn.fuel_tank].thrust;
+                         rocket->fuel_tanks[event.rocket_burn.fuel_tank].thrust;
   const float fuel_used = throttle * dt;
   const float fuel_mass_used =
-      it->fuel_tanks[event.rocket_burn.fuel_tank].mass_flow_rate * fuel_used;
+      rocket->fuel_tanks[event.rocket_burn.fuel_tank].mass_flow_rate *
+      fuel_used;
 
-  it->fuel_tanks[event.rocket_burn.fuel_tank].fuel -= fuel_used;
+  rocket->fuel_tanks[event.rocket_burn.fuel_tank].fuel -= fuel_used;
   event.id.Get(mass).inertial -= fuel_mass_used;
 
   return Event(event.id, event.position,
@@ -54,13 +53,11 @@ absl::StatusOr<Event> ApplyRocketBurn(const float dt, const Event &event,
 }  // namespace
 
 absl::Status ApplyRocketRefuel(const Event &event, std::vector<Mass> &mass,
-                               std::vector<Rocket> &rockets) {
+                               SparseSet<Rocket> &rockets) {
   assert(event.type == Event::kRocketRefuel);
 
-  auto it = std::lower_bound(
-      rockets.begin(), rockets.end(), Rocket{.id = event.id},
-      [](const Rocket &a, const Rocket &b) { return a.id < b.id; });
-  if (it == rockets.end() || it->id != event.id) {
+  Rocket *rocket = event.id.Get(rockets);
+  if (rocket == nullptr) {
     // Invalid state - the burn event targets an object with no rocket
     // component.
     return absl::NotFoundError("object has no Rocket component");
@@ -69,8 +66,8 @@ absl::Status ApplyRocketRefuel(const Event &event, std::vector<Mass> &mass,
   int fuel_tank = event.rocket_refuel.fuel_tank_no;
   if (fuel_tank < 0) {
     // Find the first empty tank or abort.
-    for (int i = 0; i < it->fuel_tank_count; ++i) {
-      if (it->fuel_tanks[i].fuel <= 0) {
+    for (int i = 0; i < rocket->fuel_tank_count; ++i) {
+      if (rocket->fuel_tanks[i].fuel <= 0) {
         fuel_tank = i;
         break;
       }
@@ -82,9 +79,9 @@ absl::Status ApplyRocketRefuel(const Event &event, std::vector<Mass> &mass,
     return absl::OutOfRangeError("fuel tank out of allowed range");
   }
 
-  event.id.Get(mass).inertial -=
-      it->fuel_tanks[fuel_tank].mass_flow_rate * it->fuel_tanks[fuel_tank].fuel;
-  it->fuel_tanks[fuel_tank] = event.rocket_refuel.fuel_tank;
+  event.id.Get(mass).inertial -= rocket->fuel_tanks[fuel_tank].mass_flow_rate *
+                                 rocket->fuel_tanks[fuel_tank].fuel;
+  rocket->fuel_tanks[fuel_tank] = event.rocket_refuel.fuel_tank;
   event.id.Get(mass).inertial += event.rocket_refuel.fuel_tank.fuel *
                                  event.rocket_refuel.fuel_tank.mass_flow_rate;
   return absl::OkStatus();
@@ -93,7 +90,7 @@ absl::Status ApplyRocketRefuel(const Event &event, std::vector<Mass> &mass,
 absl::Status ConvertRocketBurnToAcceleration(const float dt,
                                              absl::Span<Event> input,
                                              std::vector<Mass> &mass,
-                                             std::vector<Rocket> &rockets) {
+                                             SparseSet<Rocket> &rockets) {
   for (Event &event : input) {
     if (event.type != Event::kRocketBurn) continue;
     auto converted_event = ApplyRocketBurn(dt, event, mass, rockets);
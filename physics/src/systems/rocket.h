@@ -12,6 +12,7 @@
 #include <absl/status/statusor.h>
 #include <absl/types/span.h>
 
+#include "types/optional_components.h"
 #include "types/required_components.h"
 
 namespace vstr {
@@ -19,10 +20,10 @@ namespace vstr {
 absl::Status ConvertRocketBurnToAcceleration(const float dt,
                                              absl::Span<Event> input,
                                              std::vector<Mass> &mass,
-                                             std::vector<Rocket> &rockets);
+                                             SparseSet<Rocket> &rockets);
 
 absl::Status ApplyRocketRefuel(const Event &event, std::vector<Mass> &mass,
-                               std::vector<Rocket> &rockets);
+                               SparseSet<Rocket> &rockets);
 
 }  // namespace vstr
 
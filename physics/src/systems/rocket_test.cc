@@ -30,7 +30,7 @@ class ApplyRocketRefuelTest : public testing::TestWithParam<TestCase> {};
 
 TEST_P(ApplyRocketRefuelTest, ApplyRocketRefuelTest) {
   std::vector<Mass> mass = GetParam().mass;
-  std::vector<Rocket> rockets = GetParam().rockets;
+  SparseSet<Rocket> rockets(GetParam().rockets);
   absl::Status status = ApplyRocketRefuel(GetParam().event, mass, rockets);
 
   EXPECT_EQ(status.code(), GetParam().status_code) << status;
@@ -0,0 +1,126 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "task_graph.h"
+
+#include <cassert>
+
+namespace vstr {
+
+int TaskGraph::Add(const uint32_t reads, const uint32_t writes, Task task,
+                   const uint32_t partitioned) {
+  assert((partitioned & ~writes) == 0);
+  if (count_ == static_cast<int>(nodes_.size())) nodes_.emplace_back();
+  Node &node = nodes_[count_];
+  node.reads = reads;
+  node.writes = writes;
+  node.partitioned = partitioned;
+  node.task = std::move(task);
+  node.dependencies.clear();
+  node.dependents.clear();
+
+  for (int i = 0; i < count_; ++i) {
+    Node &earlier = nodes_[i];
+    const uint32_t conflicts =
+        ((earlier.writes & (reads | writes)) | (earlier.reads & writes)) &
+        ~(earlier.partitioned & partitioned);
+    if (conflicts != 0) {
+      node.dependencies.push_back(i);
+      earlier.dependents.push_back(count_);
+    }
+  }
+  return count_++;
+}
+
+void TaskGraph::Clear() {
+  for (int i = 0; i < count_; ++i) {
+    // Drop whatever the tasks captured.
+    nodes_[i].task = nullptr;
+  }
+  count_ = 0;
+}
+
+void TaskGraph::RunSerial() {
+  for (int i = 0; i < count_; ++i) {
+    nodes_[i].task();
+  }
+}
+
+void TaskGraph::Run(ThreadPool &pool) { pool.Run(*this); }
+
+ThreadPool::ThreadPool(const int threads) {
+  workers_.reserve(threads);
+  for (int i = 0; i < threads; ++i) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::Run(TaskGraph &graph) {
+  std::unique_lock<std::mutex> lock(mu_);
+  assert(graph_ == nullptr);
+  graph_ = &graph;
+  unfinished_ = graph.size();
+  ready_.clear();
+  ready_.reserve(graph.size());
+  next_ready_ = 0;
+  waiting_.resize(graph.size());
+  for (int i = 0; i < graph.size(); ++i) {
+    waiting_[i] = graph.nodes_[i].dependencies.size();
+    if (waiting_[i] == 0) ready_.push_back(i);
+  }
+  cv_.notify_all();
+
+  while (unfinished_ > 0) {
+    if (next_ready_ == ready_.size()) {
+      cv_.wait(lock);
+    } else {
+      RunOne(lock);
+    }
+  }
+  graph_ = nullptr;
+}
+
+void ThreadPool::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(mu_);
+  for (;;) {
+    cv_.wait(lock,
+             [this] { return stopping_ || next_ready_ < ready_.size(); });
+    if (stopping_) return;
+    RunOne(lock);
+  }
+}
+
+void ThreadPool::RunOne(std::unique_lock<std::mutex> &lock) {
+  const int stage = ready_[next_ready_++];
+  TaskGraph::Node &node = graph_->nodes_[stage];
+
+  lock.unlock();
+  node.task();
+  lock.lock();
+
+  bool notify = --unfinished_ == 0;
+  for (const int dependent : node.dependents) {
+    if (--waiting_[dependent] == 0) {
+      ready_.push_back(dependent);
+      notify = true;
+    }
+  }
+  if (notify) cv_.notify_all();
+}
+
+}  // namespace vstr
@@ -0,0 +1,123 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_TASK_GRAPH
+#define VSTR_TASK_GRAPH
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vstr {
+
+class ThreadPool;
+
+// A list of stages, each of which declares the resources (as a bitmask) it
+// reads and writes. A stage depends on every earlier stage that writes
+// something it reads or writes, or reads something it writes. Running the
+// graph on a ThreadPool overlaps stages that don't depend on each other, but
+// the result is always the same as running the stages one by one, in the order
+// they were added.
+//
+// Stages can also split a resource between them: each declares it as
+// partitioned, and promises to only read and write its own part. Such stages
+// don't wait for each other, but stages that use the resource in full still
+// wait for all of them (and vice versa).
+//
+// The graph can be cleared and rebuilt every frame - clearing keeps the
+// storage.
+class TaskGraph {
+ public:
+  using Task = std::function<void()>;
+
+  // Adds a stage after all the existing ones and returns its index.
+  // Partitioned must be a subset of writes.
+  int Add(uint32_t reads, uint32_t writes, Task task, uint32_t partitioned = 0);
+
+  // Removes all stages.
+  void Clear();
+
+  inline int size() const { return count_; }
+
+  // Indices of earlier stages that stage must wait for.
+  inline const std::vector<int> &dependencies(const int stage) const {
+    return nodes_[stage].dependencies;
+  }
+
+  // Runs the stages on the calling thread, in order.
+  void RunSerial();
+
+  // Runs the stages on the pool. The calling thread also runs stages, and
+  // returns once all of them finish.
+  void Run(ThreadPool &pool);
+
+ private:
+  friend class ThreadPool;
+
+  struct Node {
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t partitioned;
+    Task task;
+    std::vector<int> dependencies;
+    std::vector<int> dependents;
+  };
+
+  // Only the first count_ nodes are live. The rest are kept so that their
+  // vectors don't have to be reallocated the next time the graph is built.
+  std::vector<Node> nodes_;
+  int count_ = 0;
+};
+
+// A fixed set of worker threads that run TaskGraph stages from a shared queue.
+// A pool runs one graph at a time.
+class ThreadPool {
+ public:
+  // Starts the given number of worker threads. With zero threads, the thread
+  // calling TaskGraph::Run does all the work.
+  explicit ThreadPool(int threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  inline int threads() const { return workers_.size(); }
+
+ private:
+  friend class TaskGraph;
+
+  void Run(TaskGraph &graph);
+  void WorkerLoop();
+
+  // Pops one ready stage, runs it with the lock released, then queues the
+  // dependents it unblocked. The lock must be held.
+  void RunOne(std::unique_lock<std::mutex> &lock);
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool stopping_ = false;
+
+  TaskGraph *graph_ = nullptr;
+  // Stages become ready in the order they're pushed here, and each exactly
+  // once per run, so a vector and a read position make a queue that never
+  // allocates after the first run.
+  std::vector<int> ready_;
+  size_t next_ready_ = 0;
+  // Per stage: the number of dependencies that haven't finished yet.
+  std::vector<int> waiting_;
+  int unfinished_ = 0;
+
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace vstr
+
+#endif
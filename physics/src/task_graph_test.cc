@@ -0,0 +1,123 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "task_graph.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+namespace vstr {
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+
+constexpr uint32_t kA = 1 << 0;
+constexpr uint32_t kB = 1 << 1;
+constexpr uint32_t kC = 1 << 2;
+
+TEST(TaskGraphTest, Dependencies) {
+  TaskGraph graph;
+  graph.Add(kA, kB, [] {});  // 0
+  graph.Add(kA, kC, [] {});  // 1: only shares a read with 0
+  graph.Add(kB, 0, [] {});   // 2: reads what 0 writes
+  graph.Add(0, kA, [] {});   // 3: writes what 0 and 1 read
+  graph.Add(kC, kC, [] {});  // 4: reads and writes what 1 writes
+
+  EXPECT_THAT(graph.dependencies(0), IsEmpty());
+  EXPECT_THAT(graph.dependencies(1), IsEmpty());
+  EXPECT_THAT(graph.dependencies(2), ElementsAre(0));
+  EXPECT_THAT(graph.dependencies(3), ElementsAre(0, 1));
+  EXPECT_THAT(graph.dependencies(4), ElementsAre(1));
+
+  graph.Clear();
+  EXPECT_EQ(graph.size(), 0);
+  graph.Add(kA, kA, [] {});
+  EXPECT_THAT(graph.dependencies(0), IsEmpty());
+}
+
+TEST(TaskGraphTest, PartitionedWrites) {
+  TaskGraph graph;
+  graph.Add(0, kA, [] {});           // 0
+  graph.Add(kB, kA, [] {}, kA);      // 1: part of A
+  graph.Add(kA | kB, kA, [] {}, kA); // 2: another part of A
+  graph.Add(0, kB, [] {}, kB);       // 3: partitions B, but 1 and 2 read it
+  graph.Add(kA, 0, [] {});           // 4: reads all of A
+
+  EXPECT_THAT(graph.dependencies(1), ElementsAre(0));
+  EXPECT_THAT(graph.dependencies(2), ElementsAre(0));
+  EXPECT_THAT(graph.dependencies(3), ElementsAre(1, 2));
+  EXPECT_THAT(graph.dependencies(4), ElementsAre(0, 1, 2));
+}
+
+TEST(TaskGraphTest, SerialRunsInOrder) {
+  TaskGraph graph;
+  std::vector<int> order;
+  for (int i = 0; i < 5; ++i) {
+    graph.Add(0, 0, [&order, i] { order.push_back(i); });
+  }
+  graph.RunSerial();
+  EXPECT_THAT(order, ElementsAre(0, 1, 2, 3, 4));
+}
+
+TEST(TaskGraphTest, ParallelRespectsDependencies) {
+  ThreadPool pool(3);
+  TaskGraph graph;
+
+  // Two independent chains that each append to their own vector, and a final
+  // stage that reads both.
+  std::vector<int> a;
+  std::vector<int> b;
+  int sum = 0;
+  for (int round = 0; round < 100; ++round) {
+    a.clear();
+    b.clear();
+    for (int i = 0; i < 4; ++i) {
+      graph.Add(kA, kA, [&a, i] { a.push_back(i); });
+      graph.Add(kB, kB, [&b, i] { b.push_back(i); });
+    }
+    graph.Add(kA | kB, kC, [&] { sum = a.size() + b.size(); });
+    graph.Run(pool);
+    graph.Clear();
+
+    ASSERT_THAT(a, ElementsAre(0, 1, 2, 3));
+    ASSERT_THAT(b, ElementsAre(0, 1, 2, 3));
+    ASSERT_EQ(sum, 8);
+  }
+}
+
+TEST(TaskGraphTest, ParallelOverlapsIndependentStages) {
+  ThreadPool pool(1);
+  TaskGraph graph;
+
+  // Each stage waits for the other to start, which only finishes if they run
+  // at the same time.
+  std::atomic<int> started = 0;
+  auto task = [&started] {
+    ++started;
+    while (started < 2) std::this_thread::yield();
+  };
+  graph.Add(kA, kA, task);
+  graph.Add(kB, kB, task);
+  graph.Run(pool);
+  EXPECT_EQ(started, 2);
+}
+
+TEST(TaskGraphTest, EmptyPool) {
+  ThreadPool pool(0);
+  TaskGraph graph;
+  std::vector<int> order;
+  graph.Add(kA, kA, [&order] { order.push_back(0); });
+  graph.Add(kA, kA, [&order] { order.push_back(1); });
+  graph.Run(pool);
+  EXPECT_THAT(order, ElementsAre(0, 1));
+}
+
+}  // namespace
+}  // namespace vstr
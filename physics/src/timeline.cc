@@ -7,6 +7,11 @@
 
 #include "timeline.h"
 
+#include <chrono>
+#include <iterator>
+#include <limits>
+#include <utility>
+
 #include "systems/object_pool.h"
 
 namespace vstr {
@@ -21,8 +26,9 @@ bool EventPartialEq(const Event &a, const Event &b) {
 }
 
 void CopyUserInput(IntervalTree<Event> &tree, const Interval source,
-                   const int target) {
-  std::vector<IntervalTree<Event>::KV> buffer;
+                   const int target,
+                   std::vector<IntervalTree<Event>::KV> &buffer) {
+  buffer.clear();
   tree.Overlap(source, buffer);
 
   int offset = -source.low + target;
@@ -62,10 +68,7 @@ const Frame *Timeline::GetFrame(const int frame_no) {
   if (frame_no == head_) return &head_frame_;
   if (frame_no < tail_ || frame_no > head_) return nullptr;
 
-  auto d = std::div(frame_no - tail_, key_frame_period_);
-  if (d.rem == 0) return &key_frames_[d.quot];
-
-  Replay(frame_no);
+  if (!Replay(frame_no)) return nullptr;
   return &frame_;
 }
 
@@ -103,13 +106,19 @@ bool Timeline::GetEvents(const int first_frame_no, const int last_frame_no,
 
 void Timeline::Truncate(const int new_head, const Entity user_input_target) {
   if (new_head >= head_) return;
+  // Coarse frames are only a preview. Rather than replaying into them, drop
+  // them all.
+  if (head_ > coarse_start_) {
+    DiscardCoarseFrames();
+    if (new_head >= head_) return;
+  }
 
-  // TODO(adam): this could be about 5-10 times faster and require no allocation
-  // if the tree was right-aligned, instead of left-aligned.
+  // TODO(adam): this could be about 5-10 times faster if the tree was
+  // right-aligned, instead of left-aligned.
   if (events_.Count() > 0) {
-    std::vector<IntervalTree<Event>::KV> to_delete;
-    events_.Overlap(Interval(new_head, events_.MaxPoint()), to_delete);
-    for (auto &kv : to_delete) {
+    kv_buffer_.clear();
+    events_.Overlap(Interval(new_head, events_.MaxPoint()), kv_buffer_);
+    for (auto &kv : kv_buffer_) {
       if ((kv.second.flags & Event::kUserInput) == 0 &&
           kv.second.id != user_input_target) {
         continue;
@@ -122,20 +131,30 @@ void Timeline::Truncate(const int new_head, const Entity user_input_target) {
     }
   }
 
+  if (diff_base_no_ > new_head) diff_base_no_ = -1;
+
   auto d = std::div(new_head - tail_, key_frame_period_);
-  head_frame_ = key_frames_[d.quot];
-  key_frames_.erase(key_frames_.begin() + d.quot + 1, key_frames_.end());
+  key_frames_[d.quot].Restore(head_frame_);
+  while (key_frames_.size() > static_cast<size_t>(d.quot) + 1) {
+    free_key_frames_.push_back(std::move(key_frames_.back()));
+    key_frames_.pop_back();
+  }
 
   for (head_ = d.quot * key_frame_period_; head_ < new_head; ++head_) {
     replay_buffer_.clear();
     events_.Overlap(head_, replay_buffer_);
-    pipeline_->Replay(frame_time_, head_, head_frame_,
+    // Orbits are computed for the frame being simulated, same as in Simulate.
+    pipeline_->Replay(frame_time_, head_ + 1, head_frame_,
                       absl::MakeSpan(replay_buffer_));
   }
+  coarse_start_ = head_;
+  ClampAnchors();
 }
 
 void Timeline::InputEvent(const int frame_no, const Event &event) {
   assert(frame_no > tail_);
+  // Coarse steps can't apply input at the right frame (see NextStepCoarse).
+  if (frame_no > coarse_start_) DiscardCoarseFrames();
   Truncate(frame_no - 1, event.id);
   events_.MergeInsert(Interval(frame_no, frame_no + 1), event, EventPartialEq);
 }
@@ -143,12 +162,18 @@ void Timeline::InputEvent(const int frame_no, const Event &event) {
 void Timeline::InputEvent(int first_frame_no, int last_frame_no,
                           const Event &event) {
   assert(first_frame_no > tail_);
+  if (last_frame_no > coarse_start_) DiscardCoarseFrames();
   Truncate(first_frame_no - 1, event.id);
   events_.MergeInsert(Interval(first_frame_no, last_frame_no + 1), event,
                       EventPartialEq);
 }
 
 void Timeline::Simulate() {
+  if (NextStepCoarse()) {
+    SimulateCoarse();
+    return;
+  }
+
   ++head_;
   input_buffer_.clear();
   simulate_buffer_.clear();
@@ -159,50 +184,319 @@ void Timeline::Simulate() {
   assert(reset_event.ok());
 
   if (reset_event.value() != nullptr) {
-    head_frame_ = key_frames_[reset_event.value()->time_travel.frame_no /
-                              key_frame_period_];
+    key_frames_[reset_event.value()->time_travel.frame_no / key_frame_period_]
+        .Restore(head_frame_);
     // Copy user input events that took place in the intervening period.
     CopyUserInput(events_,
                   Interval(reset_event.value()->time_travel.frame_no, head_),
-                  head_);
+                  head_, kv_buffer_);
+    UpdateAnchors(false);
   } else {
     pipeline_->Step(frame_time_, head_, head_frame_,
                     absl::MakeSpan(input_buffer_), simulate_buffer_);
     for (const auto &event : simulate_buffer_) {
       events_.MergeInsert(Interval{head_, head_ + 1}, event, EventPartialEq);
     }
+    UpdateAnchors(true);
   }
 
+  coarse_start_ = head_;
+  CaptureKeyFrame();
+}
+
+bool Timeline::NextStepCoarse() const {
+  if (lod_stride_ == 1) return false;
+  // InputEvent drops the coarse frames when input lands past coarse_start_, so
+  // none is ever pending here.
+  if (head_ > coarse_start_) return true;
+  if (head_ - playhead_ < lod_horizon_ || (head_ % key_frame_period_) != 0) {
+    return false;
+  }
+  // A coarse step would apply input (or time travel) to the wrong frame, or
+  // for too long, so coarse frames only start once none is pending.
+  return events_.Count() == 0 || events_.MaxPoint() <= head_ + 1;
+}
+
+void Timeline::SimulateCoarse() {
+  const int first_frame_no = head_ + 1;
+  head_ += lod_stride_;
+  input_buffer_.clear();
+  simulate_buffer_.clear();
+
+  // NextStepCoarse made sure that no input falls into the step.
+  events_.Overlap(Interval(first_frame_no, head_ + 1), input_buffer_);
+  assert(input_buffer_.empty());
+  pipeline_->Step(frame_time_, head_, head_frame_,
+                  absl::MakeSpan(input_buffer_), simulate_buffer_, lod_stride_);
+  for (const auto &event : simulate_buffer_) {
+    events_.MergeInsert(Interval{head_, head_ + 1}, event, EventPartialEq);
+  }
+  UpdateAnchors(true);
+
+  CaptureKeyFrame();
+}
+
+void Timeline::CaptureKeyFrame() {
   if ((head_ % key_frame_period_) == 0) {
-    key_frames_.push_back(head_frame_);
+    if (free_key_frames_.empty()) {
+      key_frames_.emplace_back();
+    } else {
+      key_frames_.push_back(std::move(free_key_frames_.back()));
+      free_key_frames_.pop_back();
+    }
+    key_frames_.back().Capture(head_frame_);
+    pipeline_->UpdateSpatialOrder(head_frame_);
+  }
+}
+
+void Timeline::DiscardCoarseFrames() {
+  if (head_ == coarse_start_) return;
+
+  // Coarse frames only start once no events are pending past the head, and
+  // input past them discards them first, so every event after coarse_start_
+  // came from a coarse step.
+  if (events_.Count() > 0 && events_.MaxPoint() > coarse_start_ + 1) {
+    kv_buffer_.clear();
+    events_.Overlap(Interval(coarse_start_ + 1, events_.MaxPoint()),
+                    kv_buffer_);
+    for (const auto &kv : kv_buffer_) events_.Delete(kv);
   }
+
+  // Coarse frames always start at a key frame.
+  const size_t index = (coarse_start_ - tail_) / key_frame_period_;
+  key_frames_[index].Restore(head_frame_);
+  while (key_frames_.size() > index + 1) {
+    free_key_frames_.push_back(std::move(key_frames_.back()));
+    key_frames_.pop_back();
+  }
+  head_ = coarse_start_;
+
+  if (frame_no_ > head_) {
+    key_frames_[index].Restore(frame_);
+    frame_no_ = head_;
+  }
+  if (diff_base_no_ > head_) diff_base_no_ = -1;
+  ClampAnchors();
+}
+
+void Timeline::UpdateAnchors(const bool stepped) {
+  const size_t count = head_frame_.transforms.size();
+  closed_form_.assign(count, kNotClosedForm);
+  if (stepped && anchors_.size() == count) {
+    for (const int32_t id : pipeline_->ballistic()) {
+      closed_form_[id] = kStraight;
+    }
+    // Only events can change these flags or the orbit, so a body that's
+    // orbiting now, and that no event touched, orbited for the whole step.
+    head_frame_.flag_index.ForEach(
+        Flags::kOrbiting, Flags::kGlued | Flags::kDestroyed,
+        [&](const size_t i) {
+          if (head_frame_.orbits.Find(Entity(i)) != nullptr) {
+            closed_form_[i] = kOrbit;
+          }
+        });
+    const auto touch = [&](const Entity id) {
+      if (id.value() >= 0 && static_cast<size_t>(id.value()) < count) {
+        closed_form_[id.value()] = kNotClosedForm;
+      }
+    };
+    for (const auto *events : {&input_buffer_, &simulate_buffer_}) {
+      for (const Event &event : *events) {
+        touch(event.id);
+        if (event.type == Event::kCollision) touch(event.collision.second_id);
+      }
+    }
+    // A moon's position depends on its parents' orbits, so it's only closed
+    // form while they are. (A destroyed parent could respawn on another orbit.)
+    for (const Orbit &orbit : head_frame_.orbits) {
+      const int32_t i = orbit.id.value();
+      if (closed_form_[i] != kOrbit) continue;
+      const Orbit *parent = head_frame_.orbits.Find(orbit.parent_id);
+      for (size_t depth = 0; parent != nullptr && depth < count; ++depth) {
+        if (closed_form_[parent->id.value()] != kOrbit) {
+          closed_form_[i] = kNotClosedForm;
+          break;
+        }
+        parent = head_frame_.orbits.Find(parent->parent_id);
+      }
+    }
+  }
+
+  anchors_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    if (closed_form_[i] == kStraight && !anchors_[i].orbit) continue;
+    if (closed_form_[i] == kOrbit && anchors_[i].orbit) continue;
+    if (closed_form_[i] == kOrbit) {
+      // Replay applies the events in a frame in the step to the next frame, so
+      // an event that touched the body in the last step still moves it in
+      // this one.
+      anchors_[i] = Anchor{head_ + 1, {}, {}, true};
+      continue;
+    }
+    anchors_[i] = Anchor{head_, head_frame_.transforms[i].position,
+                         head_frame_.motion[i].velocity, false};
+  }
+}
+
+void Timeline::ClampAnchors() {
+  for (size_t i = 0; i < anchors_.size(); ++i) {
+    if (anchors_[i].frame_no <= head_) continue;
+    anchors_[i] = Anchor{head_, head_frame_.transforms[i].position,
+                         head_frame_.motion[i].velocity, false};
+  }
+}
+
+float Timeline::OrbitTime(const int frame_no) const {
+  // Same as Pipeline::UpdateOrbits computes for Simulate and SimulateCoarse.
+  if (frame_no > coarse_start_) {
+    return frame_time_ * lod_stride_ * (frame_no / lod_stride_);
+  }
+  return frame_time_ * frame_no;
+}
+
+int Timeline::PreviousFrameNo(const int frame_no) const {
+  return frame_no > coarse_start_ ? frame_no - lod_stride_ : frame_no - 1;
+}
+
+void Timeline::Resimulate() {
+  const int head = head_;
+  DiscardCoarseFrames();
+  while (head_ < head) Simulate();
+}
+
+void Timeline::Refine() {
+  const int head = head_;
+  const int coarse_start = coarse_start_;
+
+  // Set the coarse frames aside: their key frames, events and head frame.
+  const size_t first = (coarse_start - tail_) / key_frame_period_ + 1;
+  std::vector<FrameSnapshot> coarse_key_frames(
+      std::make_move_iterator(key_frames_.begin() + first),
+      std::make_move_iterator(key_frames_.end()));
+  key_frames_.erase(key_frames_.begin() + first, key_frames_.end());
+  std::vector<IntervalTree<Event>::KV> coarse_events;
+  if (events_.Count() > 0 && events_.MaxPoint() > coarse_start + 1) {
+    events_.Overlap(Interval(coarse_start + 1, events_.MaxPoint()),
+                    coarse_events);
+  }
+  Frame head_frame;
+  std::swap(head_frame, head_frame_);
+  DiscardCoarseFrames();
+
+  // Full rate up to the horizon, then coarse up to the next key frame.
+  while (head_ < head &&
+         (head_ == coarse_start_ || (head_ % key_frame_period_) != 0)) {
+    Simulate();
+  }
+  if (head_ == head) {
+    for (auto &key_frame : coarse_key_frames) {
+      free_key_frames_.push_back(std::move(key_frame));
+    }
+    return;
+  }
+
+  // The old coarse frames past this key frame were stepped from it, so they
+  // are kept, along with it, the events of its step and everything after.
+  const size_t kept = (head_ - coarse_start) / key_frame_period_ - 1;
+  free_key_frames_.push_back(std::move(key_frames_.back()));
+  key_frames_.pop_back();
+  for (size_t i = 0; i < coarse_key_frames.size(); ++i) {
+    (i < kept ? free_key_frames_ : key_frames_)
+        .push_back(std::move(coarse_key_frames[i]));
+  }
+  kv_buffer_.clear();
+  events_.Overlap(head_, kv_buffer_);
+  for (const auto &kv : kv_buffer_) events_.Delete(kv);
+  for (const auto &kv : coarse_events) {
+    if (kv.first.low >= head_) events_.Insert(kv.first, kv.second);
+  }
+  std::swap(head_frame, head_frame_);
+  head_ = head;
+  UpdateAnchors(false);
+  pipeline_->UpdateSpatialOrder(head_frame_);
+}
+
+absl::Status Timeline::SetTimeLod(const int horizon, const int stride) {
+  if (horizon < 0) return absl::InvalidArgumentError("negative horizon");
+  if (stride < 1 || key_frame_period_ % stride != 0) {
+    return absl::InvalidArgumentError(
+        "stride must divide the key frame period");
+  }
+  lod_horizon_ = horizon;
+  lod_stride_ = stride;
+  Resimulate();
+  return absl::OkStatus();
+}
+
+void Timeline::SetPlayhead(const int frame_no) {
+  playhead_ = frame_no;
+  if (head_ > coarse_start_ && coarse_start_ - playhead_ < lod_horizon_) {
+    Refine();
+  }
+}
+
+int Timeline::Simulate(const float time_budget, const int limit,
+                       uint64_t &time_spent_nanos) {
+  if (head_ >= limit) return 0;
+  const int first_head = head_;
+
+  // Simulate one frame and measure how long that took us.
+  auto now = std::chrono::steady_clock::now();
+  auto start = now;
+  Simulate();
+
+  // We really don't want to exceed the time budget, so we assume subsequent
+  // frames might take 1.2x as long as the first frame did.
+  now = std::chrono::steady_clock::now();
+  auto cost = 1.2 * (now - start);
+  auto deadline = start + std::chrono::duration<double>(time_budget);
+
+  // Keep going as long as we think simulating the next frame won't exceed the
+  // deadline.
+  while (now + cost < deadline && head_ < limit) {
+    Simulate();
+    now = std::chrono::steady_clock::now();
+  }
+
+  time_spent_nanos =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+  return head_ - first_head;
 }
 
 bool Timeline::Replay(int frame_no) {
   if (frame_no > head_) return false;
+  if (frame_no > coarse_start_ &&
+      (frame_no - coarse_start_) % lod_stride_ != 0) {
+    return false;
+  }
 
   const auto d = std::div(frame_no - tail_, key_frame_period_);
   assert(key_frames_.size() > d.quot);
   if (d.quot != (frame_no_ - tail_) / key_frame_period_ ||
       frame_no_ > frame_no) {
-    frame_ = key_frames_[d.quot];
+    key_frames_[d.quot].Restore(frame_);
     frame_no_ = tail_ + d.quot * key_frame_period_;
   }
 
-  for (; frame_no_ < frame_no; ++frame_no_) {
+  while (frame_no_ < frame_no) {
+    const int step = frame_no_ >= coarse_start_ ? lod_stride_ : 1;
     replay_buffer_.clear();
-    events_.Overlap(frame_no_, replay_buffer_);
+    events_.Overlap(Interval(frame_no_, frame_no_ + step), replay_buffer_);
     auto reset_event =
         ShouldResetTimeline(absl::MakeSpan(replay_buffer_), key_frame_period_);
     assert(reset_event.ok());
 
     if (reset_event.value() != nullptr) {
-      frame_ = key_frames_[reset_event.value()->time_travel.frame_no /
-                           key_frame_period_];
+      key_frames_[reset_event.value()->time_travel.frame_no /
+                  key_frame_period_]
+          .Restore(frame_);
     } else {
-      pipeline_->Replay(frame_time_, frame_no_, frame_,
-                        absl::MakeSpan(replay_buffer_));
+      // Orbits are computed for the frame being simulated, same as in
+      // Simulate and SimulateCoarse.
+      pipeline_->Replay(frame_time_, frame_no_ + step, frame_,
+                        absl::MakeSpan(replay_buffer_), step);
     }
+    frame_no_ += step;
   }
 
   assert(frame_no == frame_no);
@@ -249,11 +543,127 @@ absl::Status Timeline::Query(int resolution,
     return absl::OutOfRangeError(
         absl::StrCat("last frame ", last, " > head ", head_));
   }
+  if (last > coarse_start_ && (resolution % lod_stride_) != 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "resolution ", resolution, " is finer than the coarse frames after ",
+        coarse_start_));
+  }
+
+  // Second pass: bodies that moved along their orbit (or, if approximate
+  // queries are on, in a straight line) since before the query starts don't
+  // need replay. Find the range of frames
+  // the rest need.
+  bool closed_form[trajectories.size()];
+  first = head_;
+  last = tail_;
+  query_orbits_.clear();
+  query_index_.clear();
+  int orbit_first = head_;
+  int orbit_last = tail_;
+  bool orbit_velocity = false;
+  for (size_t i = 0; i < trajectories.size(); ++i) {
+    auto &query = trajectories[i];
+    closed_form[i] = query.id >= 0 &&
+                     static_cast<size_t>(query.id) < anchors_.size() &&
+                     anchors_[query.id].frame_no <= query.first_frame_no;
+    // Straight lines only match the simulated frames up to rounding.
+    if (closed_form[i] && !anchors_[query.id].orbit) {
+      closed_form[i] = approximate_queries_;
+    }
+    // An orbit's velocity is the distance it moved since the previous frame,
+    // which must have been on the orbit too.
+    if (closed_form[i] && anchors_[query.id].orbit &&
+        (query.attribute & Trajectory::Attribute::kVelocity)) {
+      closed_form[i] = anchors_[query.id].frame_no <=
+                       PreviousFrameNo(query.first_frame_no);
+    }
+    const int query_last =
+        query.first_frame_no +
+        static_cast<int>(query.buffer_sz) * resolution / hamming_weights[i];
+    if (!closed_form[i]) {
+      first = std::min(first, query.first_frame_no);
+      last = std::max(last, query_last);
+      continue;
+    }
+
+    const Anchor &anchor = anchors_[query.id];
+    if (anchor.orbit) {
+      query_orbits_.push_back(*head_frame_.orbits.Find(Entity(query.id)));
+      query_index_.push_back(i);
+      orbit_velocity |= query.attribute & Trajectory::Attribute::kVelocity;
+      orbit_first = std::min(orbit_first, query.first_frame_no);
+      orbit_last = std::max(orbit_last, query_last);
+      continue;
+    }
+    const int entries = query.buffer_sz / hamming_weights[i];
+    int buffer_off = 0;
+    for (int j = 0; j < entries; ++j) {
+      const int frame_no = query.first_frame_no + j * resolution;
+      if (query.attribute & Trajectory::Attribute::kPosition) {
+        query.buffer[buffer_off] =
+            anchor.position + anchor.velocity * (frame_time_ *
+                                                 (frame_no - anchor.frame_no));
+        ++buffer_off;
+      }
+      if (query.attribute & Trajectory::Attribute::kVelocity) {
+        query.buffer[buffer_off] = anchor.velocity;
+        ++buffer_off;
+      }
+    }
+  }
+
+  // Moons also need their parents' orbits. UpdateAnchors made sure they didn't
+  // change since the moon's anchor.
+  query_included_.resize(head_frame_.transforms.size());
+  for (const Orbit &orbit : query_orbits_) {
+    query_included_[orbit.id.value()] = true;
+  }
+  for (size_t k = 0; k < query_orbits_.size(); ++k) {
+    const Orbit *parent = head_frame_.orbits.Find(query_orbits_[k].parent_id);
+    if (parent == nullptr || query_included_[parent->id.value()]) continue;
+    query_included_[parent->id.value()] = true;
+    query_orbits_.push_back(*parent);
+  }
+  for (const Orbit &orbit : query_orbits_) {
+    query_included_[orbit.id.value()] = false;
+  }
+
+  // Third pass: solve the orbits in batches, one frame at a time. The pipeline
+  // used the same solver, so the results are exact.
+  for (int frame_no = orbit_first; frame_no <= orbit_last;
+       frame_no += resolution) {
+    const Vector3Array &positions =
+        orbit_solver_.Solve(OrbitTime(frame_no), query_orbits_);
+    const Vector3Array &previous_positions =
+        orbit_velocity
+            ? previous_orbit_solver_.Solve(
+                  OrbitTime(PreviousFrameNo(frame_no)), query_orbits_)
+            : positions;
+    for (size_t k = 0; k < query_index_.size(); ++k) {
+      auto &query = trajectories[query_index_[k]];
+      const int weight = hamming_weights[query_index_[k]];
+      int buffer_off = (frame_no - query.first_frame_no) / resolution * weight;
+      if (buffer_off < 0 || buffer_off >= static_cast<int>(query.buffer_sz)) {
+        continue;
+      }
+
+      const Vector3 position = positions.Get(k);
+      if (query.attribute & Trajectory::Attribute::kPosition) {
+        query.buffer[buffer_off] = position;
+        ++buffer_off;
+      }
+      if (query.attribute & Trajectory::Attribute::kVelocity) {
+        query.buffer[buffer_off] = position - previous_positions.Get(k);
+        ++buffer_off;
+      }
+    }
+  }
 
-  // Second pass: load the attribute data requested.
+  // Fourth pass: replay and load the attribute data requested.
   for (int frame_no = first; frame_no <= last; frame_no += resolution) {
     Replay(frame_no);
     for (int i = 0; i < trajectories.size(); ++i) {
+      if (closed_form[i]) continue;
       auto &query = trajectories[i];
       int buffer_off =
           (frame_no - query.first_frame_no) / resolution * hamming_weights[i];
@@ -274,6 +684,95 @@ absl::Status Timeline::Query(int resolution,
   return absl::OkStatus();
 }
 
+absl::Status Timeline::Predict(const int resolution,
+                               absl::Span<Trajectory> trajectories) {
+  if (trajectories.empty()) return absl::OkStatus();
+  if (resolution <= 0) {
+    return absl::InvalidArgumentError("resolution must be positive");
+  }
+
+  int hamming_weights[trajectories.size()];
+  int first = std::numeric_limits<int>::max();
+  int last = head_;
+  predict_ids_.clear();
+  for (size_t i = 0; i < trajectories.size(); ++i) {
+    const auto &query = trajectories[i];
+    hamming_weights[i] =
+        std::bitset<sizeof(Trajectory::Attribute)>(query.attribute).count();
+    if ((query.first_frame_no % resolution) != 0) {
+      return absl::InvalidArgumentError("query not aligned to resolution");
+    }
+    if (hamming_weights[i] == 0) {
+      return absl::InvalidArgumentError("no data requested in query");
+    }
+    if (query.first_frame_no < head_) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("prediction starts at ", query.first_frame_no,
+                       ", before the head ", head_));
+    }
+    if (query.id < 0 ||
+        static_cast<size_t>(query.id) >= head_frame_.transforms.size()) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("no such object ", query.id));
+    }
+    first = std::min(first, query.first_frame_no);
+    last = std::max(last,
+                    query.first_frame_no + static_cast<int>(query.buffer_sz) *
+                                               resolution / hamming_weights[i]);
+    predict_ids_.push_back(Entity(query.id));
+  }
+
+  // Sample at the times the pipeline would simulate the frames at, so that
+  // bodies on an orbit match exactly.
+  predictor_.Reset(OrbitTime(head_), frame_time_, predict_ids_,
+                   head_frame_.transforms, head_frame_.motion, head_frame_.mass,
+                   head_frame_.flag_index, head_frame_.orbits);
+  for (int frame_no = first; frame_no <= last; frame_no += resolution) {
+    predictor_.Advance(OrbitTime(frame_no));
+    for (size_t i = 0; i < trajectories.size(); ++i) {
+      auto &query = trajectories[i];
+      int buffer_off =
+          (frame_no - query.first_frame_no) / resolution * hamming_weights[i];
+      if (buffer_off < 0 || buffer_off >= static_cast<int>(query.buffer_sz)) {
+        continue;
+      }
+
+      if (query.attribute & Trajectory::Attribute::kPosition) {
+        query.buffer[buffer_off] = predictor_.position(i);
+        ++buffer_off;
+      }
+      if (query.attribute & Trajectory::Attribute::kVelocity) {
+        query.buffer[buffer_off] = predictor_.velocity(i);
+        ++buffer_off;
+      }
+    }
+  }
+
+  return absl::OkStatus();
+}
+
+bool Timeline::GetChanges(const int since_frame_no, const int frame_no,
+                          FrameDelta &delta) {
+  if (since_frame_no < tail_ || since_frame_no > head_ || frame_no < tail_ ||
+      frame_no > head_) {
+    return false;
+  }
+
+  // Frames between coarse frames don't exist.
+  if (since_frame_no != diff_base_no_) {
+    const Frame *since = GetFrame(since_frame_no);
+    if (since == nullptr) return false;
+    diff_base_ = *since;
+    diff_base_no_ = since_frame_no;
+  }
+  const Frame *frame = GetFrame(frame_no);
+  if (frame == nullptr) return false;
+  Diff(diff_base_, *frame, delta);
+  Patch(delta, diff_base_);
+  diff_base_no_ = frame_no;
+  return true;
+}
+
 void Timeline::SetLabel(const int id, Label label) {
   if (labels_.size() <= id) {
     labels_.reserve(id * 2);
@@ -15,7 +15,11 @@
 #include "absl/types/span.h"
 #include "dsa/interval_tree.h"
 #include "pipeline.h"
+#include "systems/conic_predictor.h"
+#include "systems/kepler.h"
 #include "types/frame.h"
+#include "types/frame_delta.h"
+#include "types/frame_snapshot.h"
 #include "types/required_components.h"
 
 namespace vstr {
@@ -33,11 +37,15 @@ class Timeline {
         key_frame_period_(key_frame_period),
         frame_no_{first_frame_no},
         frame_{scene},
-        key_frames_{scene},
+        playhead_(first_frame_no),
+        coarse_start_(first_frame_no),
+        key_frames_{FrameSnapshot(scene)},
         pipeline_(std::make_shared<Pipeline>(collision_matrix, rule_set,
                                              integrator)) {}
   Timeline() = delete;
 
+  // Returns nullptr if the frame is out of range, or if it falls between two
+  // coarse frames (see SetTimeLod).
   const Frame *GetFrame(int frame_no);
   bool GetEvents(int frame_no, std::vector<Event> &buffer) const;
   bool GetEvents(int first_frame_no, int last_frame_no,
@@ -57,8 +65,16 @@ class Timeline {
   void Truncate(int new_head, Entity user_input_target = Entity::Nil());
   void InputEvent(int frame_no, const Event &event);
   void InputEvent(int first_frame_no, int last_frame_no, const Event &event);
+  // Simulates the next frame, or the next coarse frame (see SetTimeLod).
   void Simulate();
 
+  // Simulates frames until the head reaches limit, or until the next frame
+  // would likely take the total time past time_budget (in seconds). At least
+  // one frame is simulated, unless the head is already at the limit. Returns
+  // the number of frames the head advanced by and, if it's non-zero, sets
+  // time_spent_nanos. (A coarse frame can take the head past the limit.)
+  int Simulate(float time_budget, int limit, uint64_t &time_spent_nanos);
+
   struct Trajectory {
     enum Attribute { kPosition = 1 << 0, kVelocity = 1 << 1 };
     int id;
@@ -70,8 +86,65 @@ class Timeline {
     Vector3 *buffer;
   };
 
+  // Fails if the resolution is finer than the coarse timestep for any frame
+  // past coarse_start.
+  //
+  // Trajectories of bodies that followed their orbit over the whole queried
+  // range (kOrbiting and not glued, destroyed, or touched by any event, and the
+  // same for the parents of moons) are computed in closed form, without
+  // replay. They match the simulated frames exactly. With approximate queries
+  // on, so are trajectories of bodies that moved in a straight line over the
+  // whole range (see Pipeline::ballistic).
   absl::Status Query(int resolution, absl::Span<Trajectory> trajectories);
 
+  // Lets Query compute straight-line trajectories in closed form. The
+  // simulation adds velocity × dt every frame, rounding each time, so the
+  // closed form's positions are off by up to about n × 2^-24 × |position| after
+  // n frames of straight-line motion. Velocities are exact. Off by default.
+  inline void set_approximate_queries(const bool approximate) {
+    approximate_queries_ = approximate;
+  }
+  inline bool approximate_queries() const { return approximate_queries_; }
+
+  // Predicts trajectories past the head with patched conics (see
+  // ConicPredictor), which is much cheaper than simulating, for previews. Uses
+  // the same buffer format as Query, but the trajectories must start at or past
+  // the head. Input events are ignored, and velocities are in units per
+  // second.
+  absl::Status Predict(int resolution, absl::Span<Trajectory> trajectories);
+
+  // Enables time LOD: once the head is more than horizon frames past the
+  // playhead, Simulate advances it stride frames at a time, in a single
+  // pipeline step with stride times the frame time. Collision detection sweeps
+  // over the whole coarse step. The coarse frames start at a key frame, and
+  // stride must divide the key frame period. Stride 1 turns time LOD off.
+  //
+  // Frames between coarse frames don't exist - GetFrame returns nullptr for
+  // them, and queries over them must use a multiple of stride as resolution.
+  //
+  // Coarse steps don't take input or time travel: coarse frames only start once
+  // no events are pending past the head, and InputEvent past coarse_start drops
+  // them. Changing the settings re-simulates the coarse frames.
+  absl::Status SetTimeLod(int horizon, int stride);
+
+  // Tells the timeline which frame is being shown. If that brings coarse frames
+  // within the horizon, they're re-simulated at full rate up to the next key
+  // frame past the horizon, and with coarse steps up to the key frame after
+  // that. The coarse frames from there on up to the head are kept.
+  void SetPlayhead(int frame_no);
+
+  // Frames after this one are coarse. Equal to head when there are none.
+  inline int coarse_start() const { return coarse_start_; }
+
+  // Computes the changes between two frames, so that a caller holding a copy
+  // of since_frame_no can bring it up to frame_no with Patch. Returns false if
+  // either frame is out of range, or falls between two coarse frames.
+  //
+  // The timeline keeps its own copy of the last frame returned this way, so
+  // calling this with consecutive frame numbers (e.g. once per rendered frame)
+  // doesn't have to replay since_frame_no each time.
+  bool GetChanges(int since_frame_no, int frame_no, FrameDelta &delta);
+
   inline int head() const { return head_; }
   inline int tail() const { return tail_; }
 
@@ -87,6 +160,36 @@ class Timeline {
 
   bool Replay(int frame_no);
 
+  // Whether the next call to Simulate takes a coarse step.
+  bool NextStepCoarse() const;
+  void SimulateCoarse();
+  void CaptureKeyFrame();
+
+  // Rolls the head back to coarse_start_, removing the coarse frames and the
+  // events they generated.
+  void DiscardCoarseFrames();
+
+  // Discards coarse frames and simulates back up to the same head with the
+  // current settings.
+  void Resimulate();
+  // For SetPlayhead: re-simulates the coarse frames that came within the
+  // horizon, but keeps the rest.
+  void Refine();
+
+  // Call after simulating the head frame. Bodies that the pipeline moved in a
+  // straight line or along their orbit, the same as before, and that no event
+  // touched, keep their anchors. The rest are anchored at the head. If stepped
+  // is false, the head frame didn't come from the pipeline, and all bodies are
+  // re-anchored.
+  void UpdateAnchors(bool stepped);
+  // Call after moving the head back. Re-anchors bodies anchored past the head.
+  void ClampAnchors();
+
+  // The time the pipeline computed orbits for when it simulated frame_no, and
+  // the frame it simulated it from.
+  float OrbitTime(int frame_no) const;
+  int PreviousFrameNo(int frame_no) const;
+
   int head_;
   Frame head_frame_;
 
@@ -98,13 +201,60 @@ class Timeline {
   int frame_no_;
   Frame frame_;
 
-  std::vector<Frame> key_frames_;
+  // The newest frame passed to GetChanges, kept up to date by patching.
+  int diff_base_no_ = -1;
+  Frame diff_base_;
+
+  // Time LOD. Frames in (coarse_start_, head_] were simulated lod_stride_
+  // frames at a time.
+  int lod_horizon_ = 0;
+  int lod_stride_ = 1;
+  int playhead_;
+  int coarse_start_;
+
+  // A body that has moved in a straight line from frame_no up to the head is
+  // at position + velocity × (frame_no' - frame_no) × frame time at any frame
+  // in between.
+  //
+  // If orbit is set, the pipeline instead computed the body's position from its
+  // Orbit at every frame from frame_no up to the head, and position and
+  // velocity are unused. (Then frame_no can be one past the head.)
+  struct Anchor {
+    int frame_no;
+    Vector3 position;
+    Vector3 velocity;
+    bool orbit;
+  };
+  // Indexed by entity ID.
+  std::vector<Anchor> anchors_;
+  // Per entity, for UpdateAnchors: how the body moved in the last step.
+  enum ClosedForm : uint8_t { kNotClosedForm, kStraight, kOrbit };
+  std::vector<uint8_t> closed_form_;
+  // Whether Query uses anchors that aren't orbits.
+  bool approximate_queries_ = false;
+  // For Query: orbits of trajectories computed in closed form, and the index
+  // of each trajectory. Their parents' orbits follow.
+  std::vector<Orbit> query_orbits_;
+  std::vector<int> query_index_;
+  // Indexed by entity ID: whether query_orbits_ has its orbit. Kept all false
+  // between queries.
+  std::vector<bool> query_included_;
+  KeplerSolver orbit_solver_;
+  KeplerSolver previous_orbit_solver_;
+  // For Predict.
+  ConicPredictor predictor_;
+  std::vector<Entity> predict_ids_;
+
+  std::vector<FrameSnapshot> key_frames_;
+  // Key frames dropped by Truncate, kept to reuse their arenas.
+  std::vector<FrameSnapshot> free_key_frames_;
   IntervalTree<Event> events_;
   std::shared_ptr<Pipeline> pipeline_;
 
   std::vector<Event> simulate_buffer_;
   std::vector<Event> replay_buffer_;
   std::vector<Event> input_buffer_;
+  std::vector<IntervalTree<Event>::KV> kv_buffer_;
 };
 
 }  // namespace vstr
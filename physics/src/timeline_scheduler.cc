@@ -0,0 +1,123 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "timeline_scheduler.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace vstr {
+namespace {
+
+uint64_t Nanos(const std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+}  // namespace
+
+int TimelineScheduler::Add(Timeline *timeline, const float time_budget) {
+  assert(timeline != nullptr);
+  Entry entry{.timeline = timeline,
+              .time_budget = time_budget,
+              .limit = timeline->head(),
+              .stats = {}};
+  if (free_handles_.empty()) {
+    entries_.push_back(entry);
+    return entries_.size() - 1;
+  }
+  const int handle = free_handles_.back();
+  free_handles_.pop_back();
+  entries_[handle] = entry;
+  return handle;
+}
+
+bool TimelineScheduler::Remove(const int handle) {
+  if (!Registered(handle)) return false;
+  entries_[handle].timeline = nullptr;
+  free_handles_.push_back(handle);
+  return true;
+}
+
+bool TimelineScheduler::SetLimit(const int handle, const int limit) {
+  if (!Registered(handle)) return false;
+  Entry &entry = entries_[handle];
+  entry.limit = limit;
+  entry.stats.lag = std::max(0, limit - entry.timeline->head());
+  return true;
+}
+
+bool TimelineScheduler::SetTimeBudget(const int handle,
+                                      const float time_budget) {
+  if (!Registered(handle)) return false;
+  entries_[handle].time_budget = time_budget;
+  return true;
+}
+
+bool TimelineScheduler::Registered(const int handle) const {
+  return handle >= 0 && handle < static_cast<int>(entries_.size()) &&
+         entries_[handle].timeline != nullptr;
+}
+
+int TimelineScheduler::Run() {
+  run_order_.clear();
+  for (size_t handle = 0; handle < entries_.size(); ++handle) {
+    Entry &entry = entries_[handle];
+    if (entry.timeline == nullptr) continue;
+    entry.stats.last_frames = 0;
+    entry.stats.last_wait_nanos = 0;
+    entry.stats.last_run_nanos = 0;
+    if (entry.timeline->head() < entry.limit) run_order_.push_back(handle);
+  }
+
+  // Most behind first. The pool starts stages in the order they're added.
+  std::stable_sort(run_order_.begin(), run_order_.end(), [&](int a, int b) {
+    return entries_[a].limit - entries_[a].timeline->head() >
+           entries_[b].limit - entries_[b].timeline->head();
+  });
+
+  run_start_ = std::chrono::steady_clock::now();
+  // The timelines share nothing, so no stage depends on another.
+  for (const int handle : run_order_) {
+    stages_.Add(0, 0, [this, handle] { Simulate(entries_[handle]); });
+  }
+  if (thread_pool_ == nullptr) {
+    stages_.RunSerial();
+  } else {
+    stages_.Run(*thread_pool_);
+  }
+  stages_.Clear();
+
+  int frames = 0;
+  for (const int handle : run_order_) {
+    frames += entries_[handle].stats.last_frames;
+  }
+  return frames;
+}
+
+void TimelineScheduler::Simulate(Entry &entry) {
+  Stats &stats = entry.stats;
+  stats.last_wait_nanos = Nanos(std::chrono::steady_clock::now() - run_start_);
+
+  uint64_t time_spent_nanos = 0;
+  stats.last_frames = entry.timeline->Simulate(entry.time_budget, entry.limit,
+                                               time_spent_nanos);
+  stats.frames += stats.last_frames;
+  stats.last_run_nanos = time_spent_nanos;
+  stats.max_run_nanos = std::max(stats.max_run_nanos, time_spent_nanos);
+  stats.lag = entry.limit - entry.timeline->head();
+
+  // Exponential moving average with a weight of 1/8 for the new sample.
+  const uint64_t frame_nanos = time_spent_nanos / stats.last_frames;
+  if (stats.mean_frame_nanos == 0) {
+    stats.mean_frame_nanos = frame_nanos;
+  } else {
+    stats.mean_frame_nanos =
+        (7 * stats.mean_frame_nanos + frame_nanos + 4) / 8;
+  }
+}
+
+}  // namespace vstr
@@ -0,0 +1,120 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_TIMELINE_SCHEDULER
+#define VSTR_TIMELINE_SCHEDULER
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "task_graph.h"
+#include "timeline.h"
+
+namespace vstr {
+
+// Steps many independent timelines on one thread pool. This is meant for
+// servers that host lots of small scenes - instead of driving each timeline
+// from its own thread, register them all here and call Run once per tick.
+//
+// Each timeline has a target head frame (its limit) and a time budget per
+// tick. Run simulates every timeline that's behind its limit, like
+// Timeline::Simulate(time_budget, limit, ...), with as many timelines in
+// parallel as the pool has threads (plus the calling thread).
+//
+// Timelines that are furthest behind their limit start first, so a timeline
+// that ran out of budget on one tick gets ahead of the queue on the next.
+//
+// The timelines' own pipelines must not use the scheduler's pool.
+class TimelineScheduler {
+ public:
+  // Per-timeline metrics. Times are in nanoseconds.
+  struct Stats {
+    // Frames simulated since the timeline was added.
+    int64_t frames;
+    // Frames simulated in the last Run.
+    int32_t last_frames;
+    // How far behind its limit the timeline was after the last Run.
+    int32_t lag;
+    // From the start of the last Run to the timeline starting to simulate.
+    uint64_t last_wait_nanos;
+    // Time spent simulating the timeline in the last Run.
+    uint64_t last_run_nanos;
+    // The largest last_run_nanos seen so far.
+    uint64_t max_run_nanos;
+    // Moving average of the time it takes to simulate one frame.
+    uint64_t mean_frame_nanos;
+  };
+
+  // With no pool, Run simulates the timelines one after another on the calling
+  // thread.
+  explicit TimelineScheduler(std::shared_ptr<ThreadPool> thread_pool = nullptr)
+      : thread_pool_(std::move(thread_pool)) {}
+
+  // Registers a timeline (which must outlive its registration) and returns a
+  // handle to it. The limit starts at the timeline's current head, so nothing
+  // is simulated until SetLimit is called.
+  int Add(Timeline *timeline, float time_budget);
+
+  // Unregisters the timeline. The handle may be reused by a later Add.
+  //
+  // This and the setters below return false, changing nothing, if the handle
+  // isn't registered.
+  bool Remove(int handle);
+
+  bool SetLimit(int handle, int limit);
+  bool SetTimeBudget(int handle, float time_budget);
+
+  // Simulates all timelines that are behind their limits and returns the total
+  // number of frames simulated.
+  int Run();
+
+  // Whether the handle was returned by Add and not removed since.
+  bool Registered(int handle) const;
+
+  // The handle must be registered.
+  inline const Stats &stats(const int handle) const {
+    assert(Registered(handle));
+    return entries_[handle].stats;
+  }
+
+  inline Timeline *timeline(const int handle) const {
+    assert(Registered(handle));
+    return entries_[handle].timeline;
+  }
+
+  // Number of registered timelines.
+  inline int size() const { return entries_.size() - free_handles_.size(); }
+
+ private:
+  struct Entry {
+    Timeline *timeline;
+    float time_budget;
+    int limit;
+    Stats stats;
+  };
+
+  // Simulates one timeline as part of Run.
+  void Simulate(Entry &entry);
+
+  std::shared_ptr<ThreadPool> thread_pool_;
+
+  // Indexed by handle. Removed entries have a null timeline.
+  std::vector<Entry> entries_;
+  std::vector<int> free_handles_;
+
+  // Scratch space for Run.
+  std::chrono::steady_clock::time_point run_start_;
+  std::vector<int> run_order_;
+  TaskGraph stages_;
+};
+
+}  // namespace vstr
+
+#endif
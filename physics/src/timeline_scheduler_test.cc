@@ -0,0 +1,143 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "timeline_scheduler.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+
+namespace vstr {
+namespace {
+
+Frame Scene(const float height) {
+  Frame frame;
+  frame.Push(Transform{.position{0, height, 0}}, Mass{}, Motion{},
+             Collider{.layer = 1, .radius = 1}, Glue{}, Flags{});
+  frame.Push(Transform{.position{0, 0, 0}},
+             Mass{.inertial = 100, .active = 100}, Motion{},
+             Collider{.layer = 1, .radius = 1}, Glue{}, Flags{});
+  return frame;
+}
+
+std::unique_ptr<Timeline> MakeTimeline(const float height) {
+  return std::make_unique<Timeline>(Scene(height), 0, LayerMatrix({{1, 1}}),
+                                    CollisionRuleSet{}, 0.01f, 30);
+}
+
+class TimelineSchedulerTest : public testing::TestWithParam<int> {};
+
+TEST_P(TimelineSchedulerTest, MatchesSequentialSimulation) {
+  std::shared_ptr<ThreadPool> pool;
+  if (GetParam() > 0) pool = std::make_shared<ThreadPool>(GetParam());
+  TimelineScheduler scheduler(pool);
+
+  std::vector<std::unique_ptr<Timeline>> timelines;
+  std::vector<int> handles;
+  for (int i = 0; i < 16; ++i) {
+    timelines.push_back(MakeTimeline(10 + i));
+    handles.push_back(scheduler.Add(timelines.back().get(), 1));
+    // Staggered limits, so the timelines finish at different times.
+    scheduler.SetLimit(handles.back(), 100 + i * 10);
+  }
+  EXPECT_EQ(scheduler.size(), 16);
+
+  int frames = 0;
+  for (int tick = 0; tick < 1000; ++tick) {
+    const int simulated = scheduler.Run();
+    if (simulated == 0) break;
+    frames += simulated;
+  }
+  EXPECT_EQ(frames, 16 * 100 + 10 * (15 * 16 / 2));
+
+  for (int i = 0; i < 16; ++i) {
+    const int limit = 100 + i * 10;
+    EXPECT_EQ(timelines[i]->head(), limit);
+    EXPECT_EQ(scheduler.stats(handles[i]).frames, limit);
+    EXPECT_EQ(scheduler.stats(handles[i]).lag, 0);
+
+    auto reference = MakeTimeline(10 + i);
+    for (int frame_no = 0; frame_no < limit; ++frame_no) {
+      reference->Simulate();
+    }
+    EXPECT_EQ(timelines[i]->GetFrame(limit)->transforms[0].position,
+              reference->GetFrame(limit)->transforms[0].position);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(TimelineSchedulerTest, TimelineSchedulerTest,
+                         testing::Values(0, 1, 4));
+
+TEST(TimelineSchedulerTest, TimeBudget) {
+  TimelineScheduler scheduler;
+  auto fast = MakeTimeline(10);
+  auto slow = MakeTimeline(10);
+  const int fast_handle = scheduler.Add(fast.get(), 10);
+  // A budget this small only ever allows the one mandatory frame.
+  const int slow_handle = scheduler.Add(slow.get(), 1e-12);
+  scheduler.SetLimit(fast_handle, 50);
+  scheduler.SetLimit(slow_handle, 50);
+
+  EXPECT_EQ(scheduler.Run(), 51);
+  EXPECT_EQ(scheduler.stats(fast_handle).last_frames, 50);
+  EXPECT_EQ(scheduler.stats(slow_handle).last_frames, 1);
+  EXPECT_EQ(scheduler.stats(slow_handle).lag, 49);
+  EXPECT_GT(scheduler.stats(slow_handle).mean_frame_nanos, 0);
+
+  EXPECT_EQ(scheduler.Run(), 1);
+  EXPECT_EQ(scheduler.stats(fast_handle).last_frames, 0);
+  EXPECT_EQ(scheduler.stats(slow_handle).frames, 2);
+  EXPECT_EQ(scheduler.stats(slow_handle).lag, 48);
+
+  scheduler.SetTimeBudget(slow_handle, 10);
+  EXPECT_EQ(scheduler.Run(), 48);
+  EXPECT_EQ(slow->head(), 50);
+}
+
+TEST(TimelineSchedulerTest, RemoveReusesHandles) {
+  TimelineScheduler scheduler;
+  auto a = MakeTimeline(10);
+  auto b = MakeTimeline(10);
+  const int a_handle = scheduler.Add(a.get(), 1);
+  const int b_handle = scheduler.Add(b.get(), 1);
+  scheduler.SetLimit(a_handle, 10);
+  scheduler.SetLimit(b_handle, 10);
+
+  scheduler.Remove(a_handle);
+  EXPECT_EQ(scheduler.size(), 1);
+  EXPECT_EQ(scheduler.Run(), 10);
+  EXPECT_EQ(a->head(), 0);
+  EXPECT_EQ(b->head(), 10);
+
+  // Adding a timeline starts it at its own head.
+  const int c_handle = scheduler.Add(a.get(), 1);
+  EXPECT_EQ(c_handle, a_handle);
+  EXPECT_EQ(scheduler.stats(c_handle).frames, 0);
+  EXPECT_EQ(scheduler.Run(), 0);
+}
+
+TEST(TimelineSchedulerTest, RejectsUnknownHandles) {
+  TimelineScheduler scheduler;
+  auto a = MakeTimeline(10);
+  const int handle = scheduler.Add(a.get(), 1);
+  EXPECT_TRUE(scheduler.Remove(handle));
+
+  for (const int bad : {handle, handle + 1, -1}) {
+    EXPECT_FALSE(scheduler.SetLimit(bad, 10)) << bad;
+    EXPECT_FALSE(scheduler.SetTimeBudget(bad, 1)) << bad;
+    EXPECT_FALSE(scheduler.Remove(bad)) << bad;
+    EXPECT_FALSE(scheduler.Registered(bad)) << bad;
+  }
+  // Removing twice didn't free the handle twice.
+  EXPECT_EQ(scheduler.size(), 0);
+  EXPECT_EQ(scheduler.Run(), 0);
+  EXPECT_EQ(a->head(), 0);
+}
+
+}  // namespace
+}  // namespace vstr
@@ -13,6 +13,7 @@
 #include <random>
 
 #include "absl/container/flat_hash_map.h"
+#include "allocation_counter.h"
 #include "systems/object_pool.h"
 #include "test_matchers/vector3.h"
 #include "types/required_components.h"
@@ -180,6 +181,345 @@ TEST(TimelineTest, TimeTravel) {
               Vector3ApproxEq(Vector3{0, 0, 0}, 0.5));
 }
 
+TEST(TimelineTest, IncrementalSync) {
+  Frame initial_frame;
+  const Entity rock = initial_frame.Push();
+  rock.Set(initial_frame.motion, Motion{.velocity{1, 0, 0}});
+  const Entity planet = initial_frame.Push();
+  planet.Set(initial_frame.transforms, Transform{.position{0, 1000, 0}});
+
+  LayerMatrix matrix({});
+  Timeline timeline(initial_frame, 0, matrix, {}, 0.1, 5, kFirstOrderEuler);
+  for (int i = 0; i < 20; ++i) timeline.Simulate();
+
+  // Mirror the timeline one frame at a time, the way a renderer would.
+  Frame mirror = initial_frame;
+  FrameDelta delta;
+  for (int frame_no = 1; frame_no <= 20; ++frame_no) {
+    ASSERT_TRUE(timeline.GetChanges(frame_no - 1, frame_no, delta));
+    EXPECT_THAT(delta.transforms.ranges,
+                testing::ElementsAre(testing::FieldsAre(rock.value(), 1)));
+    Patch(delta, mirror);
+    EXPECT_EQ(mirror.transforms, timeline.GetFrame(frame_no)->transforms);
+  }
+
+  // Jumping around works too.
+  ASSERT_TRUE(timeline.GetChanges(20, 7, delta));
+  Patch(delta, mirror);
+  EXPECT_EQ(mirror.transforms, timeline.GetFrame(7)->transforms);
+
+  EXPECT_FALSE(timeline.GetChanges(7, 21, delta));
+}
+
+TEST(TimelineTest, SteadyStateDoesNotAllocate) {
+  Frame initial_frame;
+  const Entity rock = initial_frame.Push();
+  rock.Set(initial_frame.motion, Motion{.velocity{1, 0, 0}});
+  const Entity planet = initial_frame.Push();
+  planet.Set(initial_frame.transforms, Transform{.position{0, 1000, 0}});
+  planet.Set(initial_frame.mass, Mass{.inertial = 1e6, .active = 1e6});
+
+  // Capturing a key frame allocates its snapshot (which is kept, not
+  // transient), so the measured frames stay clear of key frames.
+  LayerMatrix matrix({});
+  Timeline timeline(initial_frame, 0, matrix, {}, 0.1, 1000);
+  for (int i = 0; i < 5; ++i) timeline.Simulate();
+
+  const int64_t before = AllocationCount();
+  for (int i = 0; i < 100; ++i) timeline.Simulate();
+  EXPECT_EQ(AllocationCount() - before, 0);
+}
+
+TEST(TimelineTest, TimeLod) {
+  Frame initial_frame;
+  const Entity rock = initial_frame.Push();
+  rock.Set(initial_frame.motion, Motion{.velocity{10, 0, 0}});
+  const Entity planet = initial_frame.Push();
+  planet.Set(initial_frame.transforms, Transform{.position{0, 1000, 0}});
+  planet.Set(initial_frame.mass, Mass{.inertial = 1e6, .active = 1e6});
+
+  LayerMatrix matrix({});
+  Timeline reference(initial_frame, 0, matrix, {}, 0.1, 30);
+  Timeline timeline(initial_frame, 0, matrix, {}, 0.1, 30);
+  EXPECT_FALSE(timeline.SetTimeLod(60, 7).ok());
+  ASSERT_TRUE(timeline.SetTimeLod(60, 5).ok());
+
+  for (int i = 0; i < 300; ++i) reference.Simulate();
+  int steps = 0;
+  for (; timeline.head() < 300; ++steps) timeline.Simulate();
+  EXPECT_EQ(timeline.head(), 300);
+  EXPECT_EQ(timeline.coarse_start(), 60);
+  EXPECT_EQ(steps, 60 + 240 / 5);
+
+  // Full rate up to coarse_start, then only every fifth frame exists.
+  EXPECT_EQ(timeline.GetFrame(60)->transforms,
+            reference.GetFrame(60)->transforms);
+  EXPECT_EQ(timeline.GetFrame(62), nullptr);
+  ASSERT_NE(timeline.GetFrame(65), nullptr);
+  FrameDelta delta;
+  EXPECT_FALSE(timeline.GetChanges(60, 62, delta));
+  EXPECT_FALSE(timeline.GetChanges(62, 65, delta));
+  ASSERT_TRUE(timeline.GetChanges(60, 65, delta));
+  Frame mirror = *timeline.GetFrame(60);
+  Patch(delta, mirror);
+  EXPECT_EQ(mirror.transforms, timeline.GetFrame(65)->transforms);
+  // Coarse frames integrate with a longer timestep, so they only approximate
+  // the full-rate trajectory.
+  EXPECT_THAT(
+      rock.Get(timeline.GetFrame(300)->transforms).position,
+      Vector3ApproxEq(rock.Get(reference.GetFrame(300)->transforms).position,
+                      10));
+
+  std::vector<Vector3> buffer(10);
+  Timeline::Trajectory trajectory{
+      .id = rock.value(),
+      .first_frame_no = 250,
+      .attribute = Timeline::Trajectory::kPosition,
+      .buffer_sz = buffer.size(),
+      .buffer = buffer.data(),
+  };
+  EXPECT_EQ(timeline.Query(1, absl::MakeSpan(&trajectory, 1)).code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_TRUE(timeline.Query(5, absl::MakeSpan(&trajectory, 1)).ok());
+  EXPECT_EQ(buffer[2], rock.Get(timeline.GetFrame(260)->transforms).position);
+
+  // Moving the playhead refines the frames within the horizon, up to the next
+  // key frame, and keeps the head in place. Coarse frames from the key frame
+  // after that on are kept.
+  const std::vector<Transform> kept = timeline.GetFrame(240)->transforms;
+  const std::vector<Transform> head = timeline.GetFrame(300)->transforms;
+  timeline.SetPlayhead(100);
+  EXPECT_EQ(timeline.coarse_start(), 180);
+  EXPECT_EQ(timeline.head(), 300);
+  EXPECT_EQ(timeline.GetFrame(171)->transforms,
+            reference.GetFrame(171)->transforms);
+  EXPECT_EQ(timeline.GetFrame(182), nullptr);
+  ASSERT_NE(timeline.GetFrame(185), nullptr);
+  EXPECT_EQ(timeline.GetFrame(240)->transforms, kept);
+  EXPECT_EQ(timeline.GetFrame(300)->transforms, head);
+  for (int i = 0; i < 3; ++i) timeline.Simulate();
+  EXPECT_EQ(timeline.head(), 315);
+
+  // Input in the coarse region drops the coarse frames.
+  timeline.InputEvent(
+      250, Event(rock, {}, Acceleration{Vector3{1, 0, 0}}));
+  EXPECT_EQ(timeline.head(), 180);
+  EXPECT_EQ(timeline.coarse_start(), 180);
+}
+
+TEST(TimelineTest, TimeLodWithPendingInput) {
+  Frame initial_frame;
+  const Entity rock = initial_frame.Push();
+  rock.Set(initial_frame.motion, Motion{.velocity{10, 0, 0}});
+
+  LayerMatrix matrix({});
+  Timeline reference(initial_frame, 0, matrix, {}, 0.1, 30);
+  Timeline timeline(initial_frame, 0, matrix, {}, 0.1, 30);
+  ASSERT_TRUE(timeline.SetTimeLod(0, 5).ok());
+  const Event burn(rock, {}, Acceleration{Vector3{0, 1, 0}});
+  reference.InputEvent(92, burn);
+  timeline.InputEvent(92, burn);
+  reference.InputEvent(152, burn);
+  for (int i = 0; i < 200; ++i) reference.Simulate();
+
+  // The burn falls inside what would be a coarse step, so the frames up to it
+  // are simulated at full rate, and coarse frames start at the next key frame.
+  while (timeline.head() < 120) timeline.Simulate();
+  EXPECT_EQ(timeline.coarse_start(), 120);
+  EXPECT_EQ(timeline.GetFrame(120)->transforms,
+            reference.GetFrame(120)->transforms);
+
+  // Input past the head drops the coarse frames, too.
+  while (timeline.head() < 135) timeline.Simulate();
+  EXPECT_GT(timeline.head(), timeline.coarse_start());
+  timeline.InputEvent(152, burn);
+  EXPECT_EQ(timeline.head(), 120);
+  while (timeline.head() < 200) timeline.Simulate();
+  EXPECT_EQ(timeline.coarse_start(), 180);
+  EXPECT_EQ(timeline.GetFrame(180)->transforms,
+            reference.GetFrame(180)->transforms);
+}
+
+TEST(TimelineTest, BallisticQuery) {
+  Frame initial_frame;
+  const Entity drifter = initial_frame.Push();
+  drifter.Set(initial_frame.motion, Motion{.velocity{10, 0, 0}});
+  const Entity rocket = initial_frame.Push();
+  rocket.Set(initial_frame.motion, Motion{.velocity{10, 0, 0}});
+  // Too far to pull at either of them.
+  const Entity planet = initial_frame.Push();
+  planet.Set(initial_frame.transforms, Transform{.position{0, 1000, 0}});
+  planet.Set(initial_frame.mass,
+             Mass{.inertial = 1e6, .active = 1e6, .cutoff_distance = 100});
+
+  LayerMatrix matrix({});
+  const float dt = 0.1;
+  Timeline timeline(initial_frame, 0, matrix, {}, dt, 30);
+  timeline.InputEvent(50, Event(rocket, {}, Acceleration{Vector3{0, 1, 0}}));
+  for (int i = 0; i < 100; ++i) timeline.Simulate();
+
+  std::vector<Vector3> drifter_buffer(18);
+  std::vector<Vector3> rocket_buffer(18);
+  std::vector<Timeline::Trajectory> trajectories{
+      Timeline::Trajectory{
+          .id = drifter.value(),
+          .first_frame_no = 10,
+          .attribute = static_cast<Timeline::Trajectory::Attribute>(
+              Timeline::Trajectory::kPosition |
+              Timeline::Trajectory::kVelocity),
+          .buffer_sz = drifter_buffer.size(),
+          .buffer = drifter_buffer.data(),
+      },
+      Timeline::Trajectory{
+          .id = rocket.value(),
+          .first_frame_no = 10,
+          .attribute = static_cast<Timeline::Trajectory::Attribute>(
+              Timeline::Trajectory::kPosition |
+              Timeline::Trajectory::kVelocity),
+          .buffer_sz = rocket_buffer.size(),
+          .buffer = rocket_buffer.data(),
+      },
+  };
+  // By default, both trajectories are replayed, so they match exactly.
+  ASSERT_TRUE(timeline.Query(10, absl::MakeSpan(trajectories)).ok());
+  for (int i = 0; i < 9; ++i) {
+    const Frame *frame = timeline.GetFrame(10 + i * 10);
+    ASSERT_NE(frame, nullptr);
+    EXPECT_EQ(drifter_buffer[i * 2], drifter.Get(frame->transforms).position)
+        << "frame " << 10 + i * 10;
+    EXPECT_EQ(drifter_buffer[i * 2 + 1], drifter.Get(frame->motion).velocity);
+  }
+
+  timeline.set_approximate_queries(true);
+  ASSERT_TRUE(timeline.Query(10, absl::MakeSpan(trajectories)).ok());
+
+  // Now the drifter's trajectory is computed in closed form, which only matches
+  // the simulation up to rounding. The rocket's is still replayed.
+  for (int i = 0; i < 9; ++i) {
+    const Frame *frame = timeline.GetFrame(10 + i * 10);
+    ASSERT_NE(frame, nullptr);
+    EXPECT_THAT(drifter_buffer[i * 2],
+                Vector3ApproxEq(drifter.Get(frame->transforms).position, 1e-3))
+        << "frame " << 10 + i * 10;
+    EXPECT_EQ(drifter_buffer[i * 2 + 1], drifter.Get(frame->motion).velocity);
+    EXPECT_EQ(rocket_buffer[i * 2], rocket.Get(frame->transforms).position)
+        << "frame " << 10 + i * 10;
+    EXPECT_EQ(rocket_buffer[i * 2 + 1], rocket.Get(frame->motion).velocity);
+  }
+  EXPECT_NE(rocket_buffer[17], drifter_buffer[17]);
+}
+
+TEST(TimelineTest, OrbitQuery) {
+  Frame initial_frame;
+  const Entity planet =
+      initial_frame.Push(Transform{}, Mass{}, Motion{}, Collider{}, Glue{},
+                         Flags{.value = Flags::kOrbiting});
+  const Entity moon =
+      initial_frame.Push(Transform{}, Mass{}, Motion{}, Collider{}, Glue{},
+                         Flags{.value = Flags::kOrbiting});
+  planet.Set(initial_frame.orbits,
+             Orbit{.epoch{.semi_major_axis = 100, .eccentricity = 0.2},
+                   .delta{.mean_longitude_deg = 3}});
+  moon.Set(initial_frame.orbits,
+           Orbit{.focus{50, 0, 0},
+                 .epoch{.semi_major_axis = 10,
+                        .eccentricity = 0.5,
+                        .inclination_deg = 30},
+                 .delta{.mean_longitude_deg = 10},
+                 .parent_id = planet});
+
+  LayerMatrix matrix({});
+  Timeline timeline(initial_frame, 0, matrix, {}, 0.1, 30);
+  // The moon is teleported off its orbit around the planet, but the orbit puts
+  // it back on the next frame.
+  timeline.InputEvent(
+      50, Event(moon, {}, Teleportation{.new_position{0, 0, 1000}}));
+  for (int i = 0; i < 90; ++i) timeline.Simulate();
+  ASSERT_TRUE(timeline.SetTimeLod(0, 5).ok());
+  for (int i = 0; i < 12; ++i) timeline.Simulate();
+  ASSERT_EQ(timeline.head(), 150);
+
+  // Orbits are computed in closed form with the same solver as the pipeline,
+  // so they match exactly. Trajectories that start before the teleportation
+  // are replayed.
+  for (const int first_frame_no : {10, 40, 50, 60, 90, 95}) {
+    std::vector<Vector3> planet_buffer(10);
+    std::vector<Vector3> moon_buffer(10);
+    std::vector<Timeline::Trajectory> trajectories;
+    for (const auto &[id, buffer] :
+         {std::make_pair(planet, &planet_buffer),
+          std::make_pair(moon, &moon_buffer)}) {
+      trajectories.push_back(Timeline::Trajectory{
+          .id = id.value(),
+          .first_frame_no = first_frame_no,
+          .attribute = static_cast<Timeline::Trajectory::Attribute>(
+              Timeline::Trajectory::kPosition |
+              Timeline::Trajectory::kVelocity),
+          .buffer_sz = buffer->size(),
+          .buffer = buffer->data(),
+      });
+    }
+    ASSERT_TRUE(timeline.Query(5, absl::MakeSpan(trajectories)).ok());
+
+    for (int i = 0; i < 5; ++i) {
+      const int frame_no = first_frame_no + i * 5;
+      const Frame *frame = timeline.GetFrame(frame_no);
+      ASSERT_NE(frame, nullptr);
+      EXPECT_EQ(planet_buffer[i * 2], planet.Get(frame->transforms).position)
+          << "frame " << frame_no;
+      EXPECT_EQ(planet_buffer[i * 2 + 1], planet.Get(frame->motion).velocity)
+          << "frame " << frame_no;
+      EXPECT_EQ(moon_buffer[i * 2], moon.Get(frame->transforms).position)
+          << "frame " << frame_no;
+      EXPECT_EQ(moon_buffer[i * 2 + 1], moon.Get(frame->motion).velocity)
+          << "frame " << frame_no;
+    }
+  }
+}
+
+TEST(TimelineTest, Predict) {
+  // A ship on a circular orbit around a sun, at 0.1 radians per second.
+  Frame initial_frame;
+  const Entity sun = initial_frame.Push();
+  sun.Set(initial_frame.mass, Mass{.inertial = 1e4, .active = 1e4});
+  const Entity ship = initial_frame.Push();
+  ship.Set(initial_frame.transforms, Transform{.position{100, 0, 0}});
+  ship.Set(initial_frame.motion, Motion{.velocity{0, 10, 0}});
+  ship.Set(initial_frame.mass, Mass{.inertial = 1});
+
+  LayerMatrix matrix({});
+  Timeline timeline(initial_frame, 0, matrix, {}, 0.01, 30);
+  std::vector<Vector3> buffer(32);
+  std::vector<Timeline::Trajectory> trajectories{Timeline::Trajectory{
+      .id = ship.value(),
+      .first_frame_no = 100,
+      .attribute = static_cast<Timeline::Trajectory::Attribute>(
+          Timeline::Trajectory::kPosition | Timeline::Trajectory::kVelocity),
+      .buffer_sz = buffer.size(),
+      .buffer = buffer.data(),
+  }};
+  ASSERT_TRUE(timeline.Predict(100, absl::MakeSpan(trajectories)).ok());
+
+  // The prediction is close to what the simulation does.
+  EXPECT_THAT(buffer[30], Vector3ApproxEq(Vector3{100 * std::cos(1.6f),
+                                                   100 * std::sin(1.6f), 0},
+                                           0.1));
+  for (int i = 0; i < 1600; ++i) timeline.Simulate();
+  for (int i = 0; i < 16; ++i) {
+    const Frame *frame = timeline.GetFrame(100 + i * 100);
+    ASSERT_NE(frame, nullptr);
+    EXPECT_THAT(buffer[i * 2],
+                Vector3ApproxEq(ship.Get(frame->transforms).position, 0.5))
+        << "frame " << 100 + i * 100;
+    EXPECT_THAT(buffer[i * 2 + 1],
+                Vector3ApproxEq(ship.Get(frame->motion).velocity, 0.05))
+        << "frame " << 100 + i * 100;
+  }
+
+  // Past frames can only be queried.
+  EXPECT_FALSE(timeline.Predict(100, absl::MakeSpan(trajectories)).ok());
+}
+
 TEST(TimelineTest, DestroyAttractor) {
   const float dt = 1.0f / 30;
 
@@ -17,14 +17,18 @@ namespace vstr {
 // Forward declaration for the OptionalComponent concept.
 class Entity;
 
-// Optional components are stored in sorted vectors and found using binary
-// search. As such, they must specify what entity they belong to in the
+// Optional components are stored in sorted vectors (usually wrapped in a
+// SparseSet). As such, they must specify what entity they belong to in the
 // component data.
 template <typename T>
 concept OptionalComponent = requires(T x) {
   { T().id } -> std::same_as<Entity>;
 };
 
+// Forward declaration for the optional component overloads of Entity::Get.
+template <OptionalComponent T>
+class SparseSet;
+
 // Clang concept support is missing std::integral as of Clang 12. Defining
 // Entity operators to only accept integers is a cheap way to guard against some
 // type confusion errors.
@@ -142,6 +146,23 @@ class Entity {
     return &(*it);
   }
 
+  // Same as above, except the lookup uses the SparseSet index and takes
+  // constant time.
+  template <OptionalComponent T>
+  inline T &GetOrInit(SparseSet<T> &component_data) const {
+    return component_data.GetOrInit(*this);
+  }
+
+  template <OptionalComponent T>
+  inline T *Get(SparseSet<T> &component_data) const {
+    return component_data.Find(*this);
+  }
+
+  template <OptionalComponent T>
+  inline const T *Get(const SparseSet<T> &component_data) const {
+    return component_data.Find(*this);
+  }
+
   // Sets the required component data for this entity. Does not check bounds:
   // trying to set data for an invalid entity will result in out of bounds
   // access.
@@ -163,6 +184,14 @@ class Entity {
     return current;
   }
 
+  template <OptionalComponent T>
+  T &Set(SparseSet<T> &component_data, const T &value) const {
+    T &current = GetOrInit(component_data);
+    current = value;
+    current.id = *this;
+    return current;
+  }
+
   // Sentinel value meaning no entity.
   static Entity Nil() { return Entity(-1); }
 
@@ -224,9 +253,9 @@ void CopyOptionalComponent(const Entity dst, const Entity src,
                            std::vector<T> &component_data) {
   const T *src_value = src.Get(component_data);
   if (src_value == nullptr) return;
-  T &dst_value = dst.GetOrInit(component_data);
-  dst_value = *src_value;
-  dst_value.id = dst;
+  // GetOrInit can reallocate the vector out from under src_value.
+  const T value = *src_value;
+  dst.Set(component_data, value);
 }
 
 }  // namespace vstr
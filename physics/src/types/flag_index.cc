@@ -0,0 +1,90 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "flag_index.h"
+
+#include <algorithm>
+
+namespace vstr {
+
+static_assert(Flags::kReusable < (1 << FlagIndex::kFlagCount));
+
+void FlagIndex::Rebuild(const std::vector<Flags> &flags) {
+  size_ = 0;
+  for (auto &bits : bits_) bits.clear();
+  for (const Flags &f : flags) Push(f);
+}
+
+void FlagIndex::Push(const Flags flags) {
+  if (size_ % 64 == 0) {
+    for (auto &bits : bits_) bits.push_back(0);
+  }
+  ++size_;
+  Set(Entity(size_ - 1), flags);
+}
+
+void FlagIndex::Reserve(const size_t size) {
+  for (auto &bits : bits_) bits.reserve((size + 63) / 64);
+}
+
+void FlagIndex::Set(const Entity id, const Flags flags) {
+  const size_t i = id.value();
+  if (i >= size_) return;
+  for (int bit = 0; bit < kFlagCount; ++bit) {
+    if (flags.value & (1 << bit)) {
+      bits_[bit][i / 64] |= 1ull << (i % 64);
+    } else {
+      bits_[bit][i / 64] &= ~(1ull << (i % 64));
+    }
+  }
+}
+
+void FlagIndex::Assign(const size_t size,
+                       const std::array<const uint64_t *, kFlagCount> &words) {
+  size_ = size;
+  const size_t count = (size + 63) / 64;
+  for (int bit = 0; bit < kFlagCount; ++bit) {
+    bits_[bit].assign(words[bit], words[bit] + count);
+  }
+}
+
+bool FlagIndex::Matches(const std::vector<Flags> &flags) const {
+  if (flags.size() != size_) return false;
+  for (size_t i = 0; i < size_; ++i) {
+    for (int bit = 0; bit < kFlagCount; ++bit) {
+      const bool expected = flags[i].value & (1 << bit);
+      const bool actual = bits_[bit][i / 64] & (1ull << (i % 64));
+      if (expected != actual) return false;
+    }
+  }
+  return true;
+}
+
+bool FlagIndex::Sync(const std::vector<Flags> &flags) {
+  if (flags.size() == size_) {
+    const size_t words = (size_ + 63) / 64;
+    bool stale = false;
+    for (size_t w = 0; w < words && !stale; ++w) {
+      std::array<uint64_t, kFlagCount> expected{};
+      const size_t end = std::min(size_, (w + 1) * 64);
+      for (size_t i = w * 64; i < end; ++i) {
+        for (int bit = 0; bit < kFlagCount; ++bit) {
+          expected[bit] |= static_cast<uint64_t>((flags[i].value >> bit) & 1)
+                           << (i % 64);
+        }
+      }
+      for (int bit = 0; bit < kFlagCount; ++bit) {
+        stale |= expected[bit] != bits_[bit][w];
+      }
+    }
+    if (!stale) return false;
+  }
+  Rebuild(flags);
+  return true;
+}
+
+}  // namespace vstr
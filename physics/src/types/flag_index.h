@@ -0,0 +1,108 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_TYPES_FLAG_INDEX
+#define VSTR_TYPES_FLAG_INDEX
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include "types/entity.h"
+#include "types/required_components.h"
+
+namespace vstr {
+
+// Mirrors the Flags column as one bitset per flag. Systems use it to visit only
+// the objects they care about, skipping 64 objects at a time. (In scenes with
+// object pools, most objects are usually destroyed pool reserves.)
+class FlagIndex {
+ public:
+  // Number of bits defined in Flags.
+  static constexpr int kFlagCount = 4;
+
+  // Recomputes the index from scratch.
+  void Rebuild(const std::vector<Flags> &flags);
+
+  // Appends a new object.
+  void Push(Flags flags);
+
+  void Reserve(size_t size);
+
+  // Updates the bits for one object. Does nothing if id is past the end of the
+  // index: that only happens if the index is already stale and will be rebuilt.
+  void Set(Entity id, Flags flags);
+
+  inline size_t size() const { return size_; }
+
+  inline bool Test(const Entity id, const uint32_t mask) const {
+    const size_t i = id.value();
+    for (int bit = 0; bit < kFlagCount; ++bit) {
+      if ((mask & (1 << bit)) && (bits_[bit][i / 64] & (1ull << (i % 64)))) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Raw access to the bitset of one flag bit, for FrameSnapshot.
+  inline const std::vector<uint64_t> &words(const int bit) const {
+    return bits_[bit];
+  }
+
+  // Overwrites the index with copies previously taken from words(). Each
+  // pointer must point to (size + 63) / 64 words.
+  void Assign(size_t size,
+              const std::array<const uint64_t *, kFlagCount> &words);
+
+  // Returns whether the index matches the flags exactly. For use in asserts.
+  bool Matches(const std::vector<Flags> &flags) const;
+
+  // Rebuilds the index if it doesn't match the flags, for example after many
+  // direct writes. Returns whether it did. This is one pass over the flags, 64
+  // objects at a time, so the Pipeline doesn't call it every frame.
+  bool Sync(const std::vector<Flags> &flags);
+
+  // Calls fn(size_t id) for each object that has all of the flags in all_of
+  // and none of the flags in none_of, in ascending order of ID.
+  template <typename F>
+  inline void ForEach(const uint32_t all_of, const uint32_t none_of,
+                      F &&fn) const {
+    const size_t words = word_count();
+    for (size_t w = 0; w < words; ++w) {
+      uint64_t word = Word(w, all_of, none_of);
+      while (word != 0) {
+        fn(w * 64 + std::countr_zero(word));
+        word &= word - 1;
+      }
+    }
+  }
+
+  inline size_t word_count() const { return (size_ + 63) / 64; }
+
+  // Objects w * 64 to w * 64 + 63 that have all of the flags in all_of and
+  // none of the flags in none_of, as a bitmask.
+  inline uint64_t Word(const size_t w, const uint32_t all_of,
+                       const uint32_t none_of) const {
+    uint64_t word = ~0ull;
+    if (w == size_ / 64) word = (1ull << (size_ % 64)) - 1;
+    for (int bit = 0; bit < kFlagCount; ++bit) {
+      if (all_of & (1 << bit)) word &= bits_[bit][w];
+      if (none_of & (1 << bit)) word &= ~bits_[bit][w];
+    }
+    return word;
+  }
+
+ private:
+  std::array<std::vector<uint64_t>, kFlagCount> bits_;
+  size_t size_ = 0;
+};
+
+}  // namespace vstr
+
+#endif
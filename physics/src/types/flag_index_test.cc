@@ -0,0 +1,108 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "flag_index.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <random>
+
+namespace vstr {
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+
+std::vector<size_t> Collect(const FlagIndex &index, uint32_t all_of,
+                            uint32_t none_of) {
+  std::vector<size_t> result;
+  index.ForEach(all_of, none_of, [&](size_t i) { result.push_back(i); });
+  return result;
+}
+
+TEST(FlagIndexTest, Empty) {
+  FlagIndex index;
+  index.Rebuild({});
+  EXPECT_THAT(Collect(index, 0, 0), IsEmpty());
+  EXPECT_TRUE(index.Matches({}));
+}
+
+TEST(FlagIndexTest, AllOfNoneOf) {
+  FlagIndex index;
+  index.Rebuild({
+      Flags{},
+      Flags{Flags::kDestroyed},
+      Flags{Flags::kGlued},
+      Flags{Flags::kDestroyed | Flags::kGlued},
+      Flags{Flags::kOrbiting},
+  });
+
+  EXPECT_THAT(Collect(index, 0, 0), ElementsAre(0, 1, 2, 3, 4));
+  EXPECT_THAT(Collect(index, 0, Flags::kDestroyed), ElementsAre(0, 2, 4));
+  EXPECT_THAT(Collect(index, Flags::kGlued, 0), ElementsAre(2, 3));
+  EXPECT_THAT(Collect(index, Flags::kGlued, Flags::kDestroyed),
+              ElementsAre(2));
+  EXPECT_THAT(
+      Collect(index, 0, Flags::kDestroyed | Flags::kGlued | Flags::kOrbiting),
+      ElementsAre(0));
+  EXPECT_TRUE(index.Test(Entity(3), Flags::kGlued));
+  EXPECT_FALSE(index.Test(Entity(4), Flags::kGlued | Flags::kDestroyed));
+}
+
+TEST(FlagIndexTest, PushAndSetAcrossWords) {
+  std::mt19937 random_generator(42);
+  std::uniform_int_distribution<uint32_t> flags_rg(0, 15);
+
+  std::vector<Flags> flags;
+  FlagIndex index;
+  for (int i = 0; i < 200; ++i) {
+    flags.push_back(Flags{flags_rg(random_generator)});
+    index.Push(flags.back());
+  }
+  ASSERT_TRUE(index.Matches(flags));
+
+  for (int i = 0; i < 200; i += 3) {
+    flags[i].value ^= Flags::kDestroyed;
+    index.Set(Entity(i), flags[i]);
+  }
+  ASSERT_TRUE(index.Matches(flags));
+
+  std::vector<size_t> expected;
+  for (size_t i = 0; i < flags.size(); ++i) {
+    if ((flags[i].value & Flags::kReusable) &&
+        !(flags[i].value & Flags::kDestroyed)) {
+      expected.push_back(i);
+    }
+  }
+  EXPECT_EQ(Collect(index, Flags::kReusable, Flags::kDestroyed), expected);
+
+  // Set past the end does nothing.
+  index.Set(Entity(500), Flags{Flags::kDestroyed});
+  EXPECT_EQ(index.size(), 200);
+}
+
+TEST(FlagIndexTest, Sync) {
+  std::vector<Flags> flags(130);
+  FlagIndex index;
+  EXPECT_TRUE(index.Sync(flags));
+  EXPECT_FALSE(index.Sync(flags));
+
+  // A write to the last, partial word.
+  flags[129].value = Flags::kOrbiting;
+  EXPECT_TRUE(index.Sync(flags));
+  EXPECT_TRUE(index.Matches(flags));
+  EXPECT_THAT(Collect(index, Flags::kOrbiting, 0), ElementsAre(129));
+
+  flags.push_back(Flags{Flags::kGlued});
+  EXPECT_TRUE(index.Sync(flags));
+  EXPECT_TRUE(index.Matches(flags));
+  EXPECT_FALSE(index.Sync(flags));
+}
+
+}  // namespace
+}  // namespace vstr
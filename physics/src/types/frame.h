@@ -8,35 +8,31 @@
 #ifndef VSTR_FRAME
 #define VSTR_FRAME
 
+#include <absl/status/status.h>
+#include <absl/strings/str_cat.h>
 #include <absl/types/span.h>
 
+#include <algorithm>
 #include <compare>
 #include <concepts>
 #include <iostream>
+#include <type_traits>
 
 #include "systems/collision_detector.h"
 #include "systems/glue_system.h"
 #include "systems/kepler.h"
 #include "systems/motion.h"
 #include "types/entity.h"
+#include "types/flag_index.h"
 #include "types/optional_components.h"
 #include "types/required_components.h"
 
 namespace vstr {
 
-// Groups all the data required to render a frame. Each frame is the
-// deterministic result of modifying the previous by calling Pipeline::Step.
-//
-// The frame consists of (1) required components, which are dense vectors with
-// offsets equivalent to entity IDs; and (2) optional components, which are
-// sorted vectors of structures that include the entity ID as their first field.
-//
-// The recommended way of accessing data in Frames is by using Entity::Get and
-// Entity::Set, which maintain all of the above invariants.
-struct Frame {
-  static int32_t constexpr kMaxObjects = 10000;
-
-  // Core components. Point mass moves clumsily, goes fast.
+// Complete component arrays for a whole scene, used to build a Frame in one
+// step with Frame::Import. The required columns must all be the same length.
+// Optional components may be in any order.
+struct FrameColumns {
   std::vector<Transform> transforms;
   std::vector<Mass> mass;
   std::vector<Motion> motion;
@@ -44,22 +40,324 @@ struct Frame {
   std::vector<Glue> glue;
   std::vector<Flags> flags;
 
-  // Optional components:
   std::vector<Orbit> orbits;
   std::vector<Durability> durability;
   std::vector<Rocket> rockets;
   std::vector<Trigger> triggers;
   std::vector<ReusePool> reuse_pools;
   std::vector<ReuseTag> reuse_tags;
+};
+
+// The required components, which every BasicFrame has. This is the first base
+// of BasicFrame, so frames can still be initialized with just the required
+// columns: Frame{transforms, mass, motion, colliders, glue, flags}.
+struct RequiredStorage {
+  // Core components. Point mass moves clumsily, goes fast.
+  std::vector<Transform> transforms;
+  std::vector<Mass> mass;
+  std::vector<Motion> motion;
+  std::vector<Collider> colliders;
+  std::vector<Glue> glue;
+  std::vector<Flags> flags;
+};
+
+// Gives each optional component its field name in BasicFrame (and FrameColumns)
+// and a label for error messages.
+template <OptionalComponent T>
+struct OptionalStorage;
+
+template <>
+struct OptionalStorage<Orbit> {
+  SparseSet<Orbit> orbits;
+  static constexpr auto kField = &OptionalStorage::orbits;
+  static constexpr auto kColumn = &FrameColumns::orbits;
+  static constexpr char kName[] = "orbit";
+};
+
+template <>
+struct OptionalStorage<Durability> {
+  SparseSet<Durability> durability;
+  static constexpr auto kField = &OptionalStorage::durability;
+  static constexpr auto kColumn = &FrameColumns::durability;
+  static constexpr char kName[] = "durability";
+};
+
+template <>
+struct OptionalStorage<Rocket> {
+  SparseSet<Rocket> rockets;
+  static constexpr auto kField = &OptionalStorage::rockets;
+  static constexpr auto kColumn = &FrameColumns::rockets;
+  static constexpr char kName[] = "rocket";
+};
+
+template <>
+struct OptionalStorage<Trigger> {
+  SparseSet<Trigger> triggers;
+  static constexpr auto kField = &OptionalStorage::triggers;
+  static constexpr auto kColumn = &FrameColumns::triggers;
+  static constexpr char kName[] = "trigger";
+};
+
+template <>
+struct OptionalStorage<ReusePool> {
+  SparseSet<ReusePool> reuse_pools;
+  static constexpr auto kField = &OptionalStorage::reuse_pools;
+  static constexpr auto kColumn = &FrameColumns::reuse_pools;
+  static constexpr char kName[] = "reuse pool";
+};
+
+template <>
+struct OptionalStorage<ReuseTag> {
+  SparseSet<ReuseTag> reuse_tags;
+  static constexpr auto kField = &OptionalStorage::reuse_tags;
+  static constexpr auto kColumn = &FrameColumns::reuse_tags;
+  static constexpr char kName[] = "reuse tag";
+};
+
+// Groups all the data required to render a frame. Each frame is the
+// deterministic result of modifying the previous by calling Pipeline::Step.
+//
+// The frame consists of (1) required components, which are dense vectors with
+// offsets equivalent to entity IDs; and (2) optional components, which are
+// sorted vectors of structures that include the entity ID as their first field,
+// indexed by entity ID using a SparseSet.
+//
+// The set of optional components is a template parameter, so applications that
+// don't use e.g. rockets can leave them out, and copying frames doesn't pay for
+// them. Each optional component keeps its usual field name (frame.rockets).
+// Frame, below, has all of them, and it's what the Timeline and the C API use.
+// BasicPipeline can step any frame type that has the components its stages
+// need.
+//
+// The recommended way of accessing data in Frames is by using Entity::Get and
+// Entity::Set, which maintain all of the above invariants.
+template <OptionalComponent... Optional>
+struct BasicFrame : RequiredStorage, OptionalStorage<Optional>... {
+  static int32_t constexpr kMaxObjects = Entity::kMax;
+
+  static constexpr size_t kOptionalCount = sizeof...(Optional);
+
+  template <OptionalComponent T>
+  static constexpr bool kHas = (std::is_same_v<T, Optional> || ...);
+
+  // Bitsets mirroring flags. Push and the systems that change flags keep it up
+  // to date. Frames assembled without Push start out with a stale index, which
+  // the Pipeline rebuilds. Code that writes to flags directly must call
+  // flag_index.Set afterwards, or flag_index.Sync after many writes.
+  FlagIndex flag_index;
+
+  // Generic access to optional components, for code that works with any
+  // BasicFrame.
+  template <OptionalComponent T>
+  inline SparseSet<T> &optional() {
+    return this->*OptionalStorage<T>::kField;
+  }
+
+  template <OptionalComponent T>
+  inline const SparseSet<T> &optional() const {
+    return this->*OptionalStorage<T>::kField;
+  }
+
+  // Calls fn(SparseSet<T> &) for each optional component, in the order of the
+  // template parameters.
+  template <typename Fn>
+  inline void ForEachOptional(Fn fn) {
+    (fn(optional<Optional>()), ...);
+  }
+
+  template <typename Fn>
+  inline void ForEachOptional(Fn fn) const {
+    (fn(optional<Optional>()), ...);
+  }
+
+  // Reserves storage for the required components of up to size objects, so
+  // that Push doesn't have to reallocate until the frame grows past that.
+  void Reserve(size_t size);
 
   // Create a new entity by extending the required component vectors by one
   // element.
   //
   // WARNING: invalidates all previous references if storage is reallocated.
+  // (Call Reserve up front to avoid that.)
   Entity Push();
   Entity Push(Transform &&transform, Mass &&mass, Motion &&motion,
               Collider &&collider, Glue &&glue, Flags &&flags);
+
+  // Copies all of src's components to dst, except ReusePool. (Pools belong to
+  // one object, their copies would share its free list.)
+  void CopyObject(Entity dst, Entity src);
+
+  // Replaces the contents of the frame with columns, taking over their storage
+  // instead of copying. Optional components are sorted once (if they aren't
+  // sorted already) and indexed, which is much faster than adding objects and
+  // components one by one.
+  //
+  // Returns InvalidArgumentError if the required columns differ in length, if
+  // an optional component refers to a missing object or appears twice, or if
+  // columns has components that this frame type leaves out. The frame is
+  // unchanged in that case.
+  absl::Status Import(FrameColumns &&columns);
 };
 
+// The frame with every optional component.
+using Frame =
+    BasicFrame<Orbit, Durability, Rocket, Trigger, ReusePool, ReuseTag>;
+
+namespace frame_internal {
+
+// Sorts components by ID and checks that every ID is unique and refers to one
+// of the object_count objects.
+template <OptionalComponent T>
+absl::Status SortOptionalComponents(std::vector<T> &components,
+                                    const size_t object_count) {
+  const char *name = OptionalStorage<T>::kName;
+  const auto by_id = [](const T &a, const T &b) { return a.id < b.id; };
+  if (!std::is_sorted(components.begin(), components.end(), by_id)) {
+    std::sort(components.begin(), components.end(), by_id);
+  }
+  if (components.empty()) return absl::OkStatus();
+
+  if (components.front().id.value() < 0 ||
+      components.back().id.value() >= static_cast<int32_t>(object_count)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat(name, " component refers to an object outside [0, ",
+                     object_count, ")"));
+  }
+
+  auto duplicate = std::adjacent_find(
+      components.begin(), components.end(),
+      [](const T &a, const T &b) { return a.id == b.id; });
+  if (duplicate != components.end()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("duplicate ", name, " component for object ",
+                     duplicate->id.value()));
+  }
+  return absl::OkStatus();
+}
+
+// Fails if columns has components of type T, but the frame can't store them.
+template <typename FrameType, OptionalComponent T>
+absl::Status CheckOmitted(const FrameColumns &columns) {
+  if (FrameType::template kHas<T> ||
+      (columns.*OptionalStorage<T>::kColumn).empty()) {
+    return absl::OkStatus();
+  }
+  return absl::InvalidArgumentError(absl::StrCat(
+      "this frame type has no ", OptionalStorage<T>::kName, " components"));
+}
+
+}  // namespace frame_internal
+
+template <OptionalComponent... Optional>
+void BasicFrame<Optional...>::Reserve(const size_t size) {
+  assert(size <= kMaxObjects);
+
+  transforms.reserve(size);
+  mass.reserve(size);
+  motion.reserve(size);
+  colliders.reserve(size);
+  glue.reserve(size);
+  flags.reserve(size);
+  flag_index.Reserve(size);
+}
+
+template <OptionalComponent... Optional>
+Entity BasicFrame<Optional...>::Push() {
+  size_t id = transforms.size();
+  assert(id < kMaxObjects);
+
+  transforms.resize(id + 1);
+  mass.resize(id + 1);
+  motion.resize(id + 1);
+  colliders.resize(id + 1);
+  glue.resize(id + 1);
+  flags.resize(id + 1);
+  if (flag_index.size() == id) flag_index.Push(Flags{});
+
+  // Static cast checked by assert.
+  return Entity{static_cast<int32_t>(id)};
+}
+
+template <OptionalComponent... Optional>
+Entity BasicFrame<Optional...>::Push(Transform &&transform, Mass &&mass,
+                                     Motion &&motion, Collider &&collider,
+                                     Glue &&glue, Flags &&flags) {
+  assert(this->transforms.size() < kMaxObjects);
+
+  this->transforms.push_back(std::move(transform));
+  this->mass.push_back(std::move(mass));
+  this->motion.push_back(std::move(motion));
+  this->colliders.push_back(std::move(collider));
+  this->glue.push_back(std::move(glue));
+  this->flags.push_back(std::move(flags));
+  if (flag_index.size() + 1 == this->flags.size()) {
+    flag_index.Push(this->flags.back());
+  }
+
+  // Static cast checked by assert.
+  return Entity{static_cast<int32_t>(transforms.size() - 1)};
+}
+
+template <OptionalComponent... Optional>
+void BasicFrame<Optional...>::CopyObject(const Entity dst, const Entity src) {
+  dst.Set(mass, src.Get(mass));
+  dst.Set(colliders, src.Get(colliders));
+  dst.Set(glue, src.Get(glue));
+  dst.Set(flags, src.Get(flags));
+  flag_index.Set(dst, dst.Get(flags));
+  dst.Set(transforms, src.Get(transforms));
+  dst.Set(motion, src.Get(motion));
+
+  ForEachOptional([&]<typename T>(SparseSet<T> &components) {
+    if constexpr (!std::is_same_v<T, ReusePool>) {
+      CopyOptionalComponent(dst, src, components);
+    }
+  });
+}
+
+template <OptionalComponent... Optional>
+absl::Status BasicFrame<Optional...>::Import(FrameColumns &&columns) {
+  const size_t object_count = columns.transforms.size();
+  if (object_count > static_cast<size_t>(kMaxObjects)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "scene has ", object_count, " objects, maximum is ", kMaxObjects));
+  }
+  if (columns.mass.size() != object_count ||
+      columns.motion.size() != object_count ||
+      columns.colliders.size() != object_count ||
+      columns.glue.size() != object_count ||
+      columns.flags.size() != object_count) {
+    return absl::InvalidArgumentError(
+        "required component columns must all be the same length");
+  }
+
+  absl::Status status;
+  ForEachOptional([&]<typename T>(const SparseSet<T> &) {
+    status.Update(frame_internal::SortOptionalComponents(
+        columns.*OptionalStorage<T>::kColumn, object_count));
+  });
+  status.Update(frame_internal::CheckOmitted<BasicFrame, Orbit>(columns));
+  status.Update(frame_internal::CheckOmitted<BasicFrame, Durability>(columns));
+  status.Update(frame_internal::CheckOmitted<BasicFrame, Rocket>(columns));
+  status.Update(frame_internal::CheckOmitted<BasicFrame, Trigger>(columns));
+  status.Update(frame_internal::CheckOmitted<BasicFrame, ReusePool>(columns));
+  status.Update(frame_internal::CheckOmitted<BasicFrame, ReuseTag>(columns));
+  if (!status.ok()) return status;
+
+  transforms = std::move(columns.transforms);
+  mass = std::move(columns.mass);
+  motion = std::move(columns.motion);
+  colliders = std::move(columns.colliders);
+  glue = std::move(columns.glue);
+  flags = std::move(columns.flags);
+
+  ForEachOptional([&]<typename T>(SparseSet<T> &components) {
+    components.Adopt(std::move(columns.*OptionalStorage<T>::kColumn));
+  });
+
+  flag_index.Rebuild(flags);
+  return absl::OkStatus();
+}
+
 }  // namespace vstr
-#endif
\ No newline at end of file
+#endif
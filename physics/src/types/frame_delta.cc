@@ -0,0 +1,222 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "frame_delta.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace vstr {
+namespace {
+
+// Whether a and b hold the same value, down to the bits of each float. This is
+// stricter than operator==, which ignores some fields (e.g. Motion::spin) and
+// treats 0.0f and -0.0f alike. memcmp is only used for types without padding
+// or floats, where every byte is part of the value. The others are compared
+// field by field, so padding, inactive union members and unused array slots
+// don't count.
+template <typename T>
+  requires std::has_unique_object_representations_v<T>
+inline bool Same(const T &a, const T &b) {
+  return std::memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+inline bool Same(const float a, const float b) {
+  return std::bit_cast<uint32_t>(a) == std::bit_cast<uint32_t>(b);
+}
+
+inline bool Same(const Vector3 &a, const Vector3 &b) {
+  return Same(a.x, b.x) && Same(a.y, b.y) && Same(a.z, b.z);
+}
+
+inline bool Same(const Quaternion &a, const Quaternion &b) {
+  return Same(a.a, b.a) && Same(a.b, b.b) && Same(a.c, b.c) && Same(a.d, b.d);
+}
+
+inline bool Same(const Transform &a, const Transform &b) {
+  return Same(a.position, b.position) && Same(a.rotation, b.rotation);
+}
+
+inline bool Same(const Mass &a, const Mass &b) {
+  return Same(a.inertial, b.inertial) && Same(a.active, b.active) &&
+         Same(a.cutoff_distance, b.cutoff_distance);
+}
+
+inline bool Same(const Motion &a, const Motion &b) {
+  return Same(a.velocity, b.velocity) &&
+         Same(a.new_position, b.new_position) &&
+         Same(a.acceleration, b.acceleration) && Same(a.spin, b.spin);
+}
+
+inline bool Same(const Collider &a, const Collider &b) {
+  return a.layer == b.layer && Same(a.radius, b.radius) &&
+         Same(a.center, b.center);
+}
+
+inline bool Same(const Orbit::Kepler &a, const Orbit::Kepler &b) {
+  return Same(a.semi_major_axis, b.semi_major_axis) &&
+         Same(a.eccentricity, b.eccentricity) &&
+         Same(a.mean_longitude_deg, b.mean_longitude_deg) &&
+         Same(a.longitude_of_perihelion_deg, b.longitude_of_perihelion_deg) &&
+         Same(a.longitude_of_ascending_node_deg,
+              b.longitude_of_ascending_node_deg) &&
+         Same(a.inclination_deg, b.inclination_deg);
+}
+
+inline bool Same(const Orbit &a, const Orbit &b) {
+  return a.id == b.id && Same(a.focus, b.focus) && Same(a.epoch, b.epoch) &&
+         Same(a.delta, b.delta) && a.parent_id == b.parent_id;
+}
+
+inline bool Same(const Rocket::FuelTank &a, const Rocket::FuelTank &b) {
+  return Same(a.mass_flow_rate, b.mass_flow_rate) && Same(a.fuel, b.fuel) &&
+         Same(a.thrust, b.thrust);
+}
+
+inline bool Same(const Rocket &a, const Rocket &b) {
+  if (a.id != b.id || a.fuel_tank_count != b.fuel_tank_count) return false;
+  for (int i = 0; i < a.fuel_tank_count; ++i) {
+    if (!Same(a.fuel_tanks[i], b.fuel_tanks[i])) return false;
+  }
+  return true;
+}
+
+// Event::operator== compares the active payload only.
+inline bool Same(const Trigger &a, const Trigger &b) {
+  return a.id == b.id && a.condition == b.condition && a.target == b.target &&
+         a.flags == b.flags && a.event == b.event &&
+         a.event.flags == b.event.flags;
+}
+
+template <typename T>
+void DiffColumn(const std::vector<T> &from, const std::vector<T> &to,
+                ColumnDelta<T> &delta) {
+  delta.clear();
+  const size_t common = std::min(from.size(), to.size());
+  for (size_t i = 0; i < to.size(); ++i) {
+    if (i < common && Same(from[i], to[i])) continue;
+
+    // Static cast is safe, because frames can't have more than
+    // Frame::kMaxObjects objects.
+    const int32_t id = static_cast<int32_t>(i);
+    if (!delta.ranges.empty() &&
+        delta.ranges.back().first_id + delta.ranges.back().count == id) {
+      ++delta.ranges.back().count;
+    } else {
+      delta.ranges.push_back(DeltaRange{.first_id = id, .count = 1});
+    }
+    delta.values.push_back(to[i]);
+  }
+}
+
+template <OptionalComponent T>
+void DiffOptional(const SparseSet<T> &from, const SparseSet<T> &to,
+                  OptionalDelta<T> &delta) {
+  delta.clear();
+  if (from.size() == to.size() &&
+      std::equal(from.begin(), from.end(), to.begin(),
+                 [](const T &a, const T &b) { return Same(a, b); })) {
+    return;
+  }
+  delta.changed = true;
+  delta.components.assign(to.begin(), to.end());
+}
+
+template <typename T>
+void PatchColumn(const ColumnDelta<T> &delta, std::vector<T> &column) {
+  auto value = delta.values.begin();
+  for (const DeltaRange &range : delta.ranges) {
+    std::copy(value, value + range.count, column.begin() + range.first_id);
+    value += range.count;
+  }
+}
+
+template <OptionalComponent T>
+void PatchOptional(const OptionalDelta<T> &delta, SparseSet<T> &set) {
+  if (!delta.changed) return;
+  set.Adopt(std::vector<T>(delta.components));
+}
+
+}  // namespace
+
+void FrameDelta::Clear() {
+  object_count = 0;
+  transforms.clear();
+  mass.clear();
+  motion.clear();
+  colliders.clear();
+  glue.clear();
+  flags.clear();
+  orbits.clear();
+  durability.clear();
+  rockets.clear();
+  triggers.clear();
+  reuse_pools.clear();
+  reuse_tags.clear();
+}
+
+void Diff(const Frame &from, const Frame &to, FrameDelta &delta) {
+  delta.object_count = to.transforms.size();
+
+  DiffColumn(from.transforms, to.transforms, delta.transforms);
+  DiffColumn(from.mass, to.mass, delta.mass);
+  DiffColumn(from.motion, to.motion, delta.motion);
+  DiffColumn(from.colliders, to.colliders, delta.colliders);
+  DiffColumn(from.glue, to.glue, delta.glue);
+  DiffColumn(from.flags, to.flags, delta.flags);
+
+  DiffOptional(from.orbits, to.orbits, delta.orbits);
+  DiffOptional(from.durability, to.durability, delta.durability);
+  DiffOptional(from.rockets, to.rockets, delta.rockets);
+  DiffOptional(from.triggers, to.triggers, delta.triggers);
+  DiffOptional(from.reuse_pools, to.reuse_pools, delta.reuse_pools);
+  DiffOptional(from.reuse_tags, to.reuse_tags, delta.reuse_tags);
+}
+
+void Patch(const FrameDelta &delta, Frame &frame) {
+  const bool resized =
+      frame.transforms.size() != static_cast<size_t>(delta.object_count);
+  if (resized) {
+    frame.transforms.resize(delta.object_count);
+    frame.mass.resize(delta.object_count);
+    frame.motion.resize(delta.object_count);
+    frame.colliders.resize(delta.object_count);
+    frame.glue.resize(delta.object_count);
+    frame.flags.resize(delta.object_count);
+  }
+
+  PatchColumn(delta.transforms, frame.transforms);
+  PatchColumn(delta.mass, frame.mass);
+  PatchColumn(delta.motion, frame.motion);
+  PatchColumn(delta.colliders, frame.colliders);
+  PatchColumn(delta.glue, frame.glue);
+  PatchColumn(delta.flags, frame.flags);
+
+  PatchOptional(delta.orbits, frame.orbits);
+  PatchOptional(delta.durability, frame.durability);
+  PatchOptional(delta.rockets, frame.rockets);
+  PatchOptional(delta.triggers, frame.triggers);
+  PatchOptional(delta.reuse_pools, frame.reuse_pools);
+  PatchOptional(delta.reuse_tags, frame.reuse_tags);
+
+  if (resized) {
+    frame.flag_index.Rebuild(frame.flags);
+    return;
+  }
+  auto value = delta.flags.values.begin();
+  for (const DeltaRange &range : delta.flags.ranges) {
+    for (int32_t id = range.first_id; id < range.first_id + range.count;
+         ++id, ++value) {
+      frame.flag_index.Set(Entity(id), *value);
+    }
+  }
+}
+
+}  // namespace vstr
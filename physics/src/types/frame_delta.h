@@ -0,0 +1,85 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_TYPES_FRAME_DELTA
+#define VSTR_TYPES_FRAME_DELTA
+
+#include <cstdint>
+#include <vector>
+
+#include "types/frame.h"
+
+namespace vstr {
+
+// A run of consecutive objects whose component changed.
+struct DeltaRange {
+  int32_t first_id;
+  int32_t count;
+};
+
+// Changes to one required component column: the changed ranges, and the new
+// values for every object in them, back to back.
+template <typename T>
+struct ColumnDelta {
+  std::vector<DeltaRange> ranges;
+  std::vector<T> values;
+
+  inline bool empty() const { return ranges.empty(); }
+  inline void clear() {
+    ranges.clear();
+    values.clear();
+  }
+};
+
+// Changes to one optional component set. These are small and change rarely, so
+// a changed set is sent whole.
+template <OptionalComponent T>
+struct OptionalDelta {
+  bool changed = false;
+  std::vector<T> components;
+
+  inline void clear() {
+    changed = false;
+    components.clear();
+  }
+};
+
+// The difference between two frames. Usually only moving objects change from
+// one frame to the next, so this is much smaller than the frame.
+//
+// Components are compared field by field and bit for bit, not with operator==,
+// which ignores some fields (e.g. Motion::spin).
+struct FrameDelta {
+  int32_t object_count = 0;
+
+  ColumnDelta<Transform> transforms;
+  ColumnDelta<Mass> mass;
+  ColumnDelta<Motion> motion;
+  ColumnDelta<Collider> colliders;
+  ColumnDelta<Glue> glue;
+  ColumnDelta<Flags> flags;
+
+  OptionalDelta<Orbit> orbits;
+  OptionalDelta<Durability> durability;
+  OptionalDelta<Rocket> rockets;
+  OptionalDelta<Trigger> triggers;
+  OptionalDelta<ReusePool> reuse_pools;
+  OptionalDelta<ReuseTag> reuse_tags;
+
+  void Clear();
+};
+
+// Computes the changes that turn from into to. Objects that only exist in to
+// count as changed. Overwrites delta, reusing its storage.
+void Diff(const Frame &from, const Frame &to, FrameDelta &delta);
+
+// Applies delta, which must have been computed from a frame equal to frame.
+void Patch(const FrameDelta &delta, Frame &frame);
+
+}  // namespace vstr
+
+#endif
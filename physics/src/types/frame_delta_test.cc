@@ -0,0 +1,132 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "frame_delta.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+namespace vstr {
+namespace {
+
+using testing::ElementsAre;
+using testing::FieldsAre;
+using testing::IsEmpty;
+
+Frame Scene(const int size) {
+  Frame frame;
+  for (int i = 0; i < size; ++i) {
+    frame.Push(Transform{.position = Vector3{static_cast<float>(i), 0, 0}},
+               Mass{.inertial = 1}, Motion{}, Collider{}, Glue{}, Flags{});
+  }
+  return frame;
+}
+
+void ExpectFramesEqual(const Frame &a, const Frame &b) {
+  EXPECT_EQ(a.transforms, b.transforms);
+  EXPECT_EQ(a.mass, b.mass);
+  EXPECT_EQ(a.motion, b.motion);
+  EXPECT_EQ(a.colliders, b.colliders);
+  EXPECT_EQ(a.glue, b.glue);
+  EXPECT_EQ(a.flags, b.flags);
+  EXPECT_EQ(a.durability, b.durability);
+  EXPECT_TRUE(b.flag_index.Matches(b.flags));
+}
+
+TEST(FrameDeltaTest, Unchanged) {
+  const Frame frame = Scene(10);
+  FrameDelta delta;
+  Diff(frame, frame, delta);
+
+  EXPECT_EQ(delta.object_count, 10);
+  EXPECT_TRUE(delta.transforms.empty());
+  EXPECT_TRUE(delta.flags.empty());
+  EXPECT_FALSE(delta.orbits.changed);
+}
+
+TEST(FrameDeltaTest, RangesAndPatch) {
+  const Frame from = Scene(10);
+  Frame to = from;
+  for (int i : {2, 3, 4, 8}) to.transforms[i].position.y = 1;
+  to.flags[9].value = Flags::kDestroyed;
+  to.flag_index.Set(Entity(9), to.flags[9]);
+  Entity(5).Set(to.durability, Durability{.id = Entity(5), .value = 7});
+
+  FrameDelta delta;
+  Diff(from, to, delta);
+  EXPECT_THAT(delta.transforms.ranges,
+              ElementsAre(FieldsAre(2, 3), FieldsAre(8, 1)));
+  EXPECT_EQ(delta.transforms.values.size(), 4);
+  EXPECT_THAT(delta.flags.ranges, ElementsAre(FieldsAre(9, 1)));
+  EXPECT_TRUE(delta.mass.empty());
+  EXPECT_TRUE(delta.durability.changed);
+  EXPECT_FALSE(delta.rockets.changed);
+
+  Frame patched = from;
+  Patch(delta, patched);
+  ExpectFramesEqual(to, patched);
+  EXPECT_TRUE(patched.flag_index.Test(Entity(9), Flags::kDestroyed));
+}
+
+TEST(FrameDeltaTest, NewObjects) {
+  const Frame from = Scene(3);
+  const Frame to = Scene(5);
+
+  FrameDelta delta;
+  Diff(from, to, delta);
+  EXPECT_EQ(delta.object_count, 5);
+  EXPECT_THAT(delta.transforms.ranges, ElementsAre(FieldsAre(3, 2)));
+
+  Frame patched = from;
+  Patch(delta, patched);
+  ExpectFramesEqual(to, patched);
+
+  Diff(to, to, delta);
+  EXPECT_THAT(delta.transforms.ranges, IsEmpty());
+}
+
+// A trigger with every byte outside its fields, including the unused part of
+// the event payload, set to fill.
+Trigger FilledTrigger(const uint8_t fill) {
+  Trigger trigger;
+  std::memset(&trigger, fill, sizeof(trigger));
+  trigger.id = Entity(1);
+  trigger.condition = Trigger::kColission;
+  trigger.target = Trigger::kSelf;
+  trigger.flags = Trigger::kDestroyTrigger;
+  trigger.event.id = Entity(1);
+  trigger.event.type = Event::kStick;
+  trigger.event.position = Vector3{1, 2, 3};
+  trigger.event.flags = 0;
+  trigger.event.stick.parent_id = Entity(0);
+  return trigger;
+}
+
+TEST(FrameDeltaTest, IgnoresUnusedBytes) {
+  Frame from = Scene(2);
+  Frame to = from;
+  Entity(1).Set(from.triggers, FilledTrigger(0x00));
+  Entity(1).Set(to.triggers, FilledTrigger(0xff));
+
+  FrameDelta delta;
+  Diff(from, to, delta);
+  EXPECT_FALSE(delta.triggers.changed);
+
+  to.triggers.Find(Entity(1))->event.stick.parent_id = Entity(1);
+  Diff(from, to, delta);
+  EXPECT_TRUE(delta.triggers.changed);
+
+  // Fields that operator== ignores still count.
+  to.motion[0].spin = Quaternion{0, 0, 1, 0};
+  Diff(from, to, delta);
+  EXPECT_THAT(delta.motion.ranges, ElementsAre(FieldsAre(0, 1)));
+}
+
+}  // namespace
+}  // namespace vstr
@@ -0,0 +1,163 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_TYPES_FRAME_SNAPSHOT
+#define VSTR_TYPES_FRAME_SNAPSHOT
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "types/frame.h"
+
+namespace vstr {
+
+// A copy of a BasicFrame stored in a single arena, with all the component
+// arrays back-to-back. Used for key frames: capturing a frame is one allocation
+// at most (none, if the arena is already large enough) and restoring it doesn't
+// allocate if the target frame's vectors have enough capacity.
+//
+// Snapshots are meant to be recycled - capturing a different frame into an old
+// snapshot reuses its arena.
+template <typename FrameType>
+class BasicFrameSnapshot {
+ public:
+  BasicFrameSnapshot() = default;
+  explicit BasicFrameSnapshot(const FrameType &frame) { Capture(frame); }
+
+  // Copies frame into the arena, growing it if needed.
+  void Capture(const FrameType &frame);
+
+  // Overwrites frame with the contents of the snapshot.
+  void Restore(FrameType &frame) const;
+
+  // Number of objects in the captured frame.
+  inline size_t size() const { return columns_[0].count; }
+
+  // Size of the arena in bytes.
+  inline size_t capacity() const { return arena_.capacity(); }
+
+ private:
+  // The six required components, then the dense vector and index of each
+  // optional component, then one column per bit in the FlagIndex.
+  static constexpr size_t kColumnCount =
+      6 + 2 * FrameType::kOptionalCount + FlagIndex::kFlagCount;
+
+  // Every column starts at a multiple of this. (The arena itself comes from
+  // operator new, which aligns to at least this much.)
+  static constexpr size_t kAlignment = alignof(std::max_align_t);
+
+  struct Column {
+    size_t offset;
+    size_t count;
+  };
+
+  template <typename T>
+  static inline size_t ColumnBytes(const std::vector<T> &data) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return (data.size() * sizeof(T) + kAlignment - 1) & ~(kAlignment - 1);
+  }
+
+  template <typename T>
+  static inline size_t SparseSetBytes(const SparseSet<T> &data) {
+    return ColumnBytes(data.dense()) + ColumnBytes(data.index());
+  }
+
+  // Copies data into the next column.
+  template <typename T>
+  void Capture(const std::vector<T> &data, size_t &column, size_t &offset) {
+    columns_[column] = Column{.offset = offset, .count = data.size()};
+    if (!data.empty()) {
+      std::memcpy(arena_.data() + offset, data.data(), data.size() * sizeof(T));
+    }
+    offset += ColumnBytes(data);
+    ++column;
+  }
+
+  template <typename T>
+  inline const T *Get(const size_t column) const {
+    return reinterpret_cast<const T *>(arena_.data() + columns_[column].offset);
+  }
+
+  // Overwrites data with the next column.
+  template <typename T>
+  void Restore(std::vector<T> &data, size_t &column) const {
+    data.assign(Get<T>(column), Get<T>(column) + columns_[column].count);
+    ++column;
+  }
+
+  std::array<Column, kColumnCount> columns_{};
+  size_t flag_index_size_ = 0;
+  std::vector<std::byte> arena_;
+};
+
+using FrameSnapshot = BasicFrameSnapshot<Frame>;
+
+template <typename FrameType>
+void BasicFrameSnapshot<FrameType>::Capture(const FrameType &frame) {
+  size_t bytes = ColumnBytes(frame.transforms) + ColumnBytes(frame.mass) +
+                 ColumnBytes(frame.motion) + ColumnBytes(frame.colliders) +
+                 ColumnBytes(frame.glue) + ColumnBytes(frame.flags);
+  frame.ForEachOptional(
+      [&](const auto &components) { bytes += SparseSetBytes(components); });
+  for (int bit = 0; bit < FlagIndex::kFlagCount; ++bit) {
+    bytes += ColumnBytes(frame.flag_index.words(bit));
+  }
+  // Shrinking a vector never frees its storage, so the arena only reallocates
+  // when a frame is larger than every frame captured into it before.
+  arena_.resize(bytes);
+
+  size_t column = 0;
+  size_t offset = 0;
+  Capture(frame.transforms, column, offset);
+  Capture(frame.mass, column, offset);
+  Capture(frame.motion, column, offset);
+  Capture(frame.colliders, column, offset);
+  Capture(frame.glue, column, offset);
+  Capture(frame.flags, column, offset);
+  frame.ForEachOptional([&](const auto &components) {
+    Capture(components.dense(), column, offset);
+    Capture(components.index(), column, offset);
+  });
+  for (int bit = 0; bit < FlagIndex::kFlagCount; ++bit) {
+    Capture(frame.flag_index.words(bit), column, offset);
+  }
+  flag_index_size_ = frame.flag_index.size();
+  assert(column == kColumnCount);
+  assert(offset == bytes);
+}
+
+template <typename FrameType>
+void BasicFrameSnapshot<FrameType>::Restore(FrameType &frame) const {
+  // For trivially copyable types, vector::assign from a pointer range is a
+  // memmove into the existing storage, if it's large enough.
+  size_t column = 0;
+  Restore(frame.transforms, column);
+  Restore(frame.mass, column);
+  Restore(frame.motion, column);
+  Restore(frame.colliders, column);
+  Restore(frame.glue, column);
+  Restore(frame.flags, column);
+  frame.ForEachOptional([&]<typename T>(SparseSet<T> &components) {
+    components.Assign(Get<T>(column), columns_[column].count,
+                      Get<int32_t>(column + 1), columns_[column + 1].count);
+    column += 2;
+  });
+
+  std::array<const uint64_t *, FlagIndex::kFlagCount> words;
+  for (int bit = 0; bit < FlagIndex::kFlagCount; ++bit) {
+    words[bit] = Get<uint64_t>(column + bit);
+  }
+  frame.flag_index.Assign(flag_index_size_, words);
+}
+
+}  // namespace vstr
+
+#endif
@@ -0,0 +1,104 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "frame_snapshot.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace vstr {
+namespace {
+
+using testing::ElementsAreArray;
+
+Frame MakeFrame(const int size) {
+  Frame frame;
+  for (int i = 0; i < size; ++i) {
+    Entity id = frame.Push(
+        Transform{.position = Vector3{static_cast<float>(i), 0, 0}},
+        Mass{.inertial = 1, .active = static_cast<float>(i)},
+        Motion::FromPositionAndVelocity(Vector3{static_cast<float>(i), 0, 0},
+                                        Vector3{0, 1, 0}),
+        Collider{.layer = 1, .radius = 1}, Glue{},
+        Flags{i % 3 == 0 ? Flags::kDestroyed : 0u});
+    if (i % 2 == 0) id.Set(frame.durability, Durability{.value = i, .max = i});
+    if (i % 5 == 0) id.Set(frame.orbits, Orbit{});
+  }
+  return frame;
+}
+
+void ExpectFramesEqual(const Frame &a, const Frame &b) {
+  EXPECT_THAT(a.transforms, ElementsAreArray(b.transforms));
+  EXPECT_THAT(a.mass, ElementsAreArray(b.mass));
+  EXPECT_THAT(a.motion, ElementsAreArray(b.motion));
+  EXPECT_THAT(a.colliders, ElementsAreArray(b.colliders));
+  EXPECT_THAT(a.glue, ElementsAreArray(b.glue));
+  EXPECT_THAT(a.flags, ElementsAreArray(b.flags));
+  EXPECT_EQ(a.orbits, b.orbits);
+  EXPECT_EQ(a.durability, b.durability);
+  EXPECT_EQ(a.rockets, b.rockets);
+  EXPECT_EQ(a.reuse_pools, b.reuse_pools);
+  EXPECT_EQ(a.reuse_tags, b.reuse_tags);
+  EXPECT_TRUE(a.flag_index.Matches(b.flags));
+}
+
+TEST(FrameSnapshotTest, RoundTrip) {
+  const Frame frame = MakeFrame(100);
+  FrameSnapshot snapshot(frame);
+  EXPECT_EQ(snapshot.size(), 100);
+
+  Frame restored;
+  snapshot.Restore(restored);
+  ExpectFramesEqual(restored, frame);
+
+  // The sparse set index must survive the round trip too.
+  ASSERT_NE(Entity(42).Get(restored.durability), nullptr);
+  EXPECT_EQ(Entity(42).Get(restored.durability)->value, 42);
+  EXPECT_EQ(Entity(43).Get(restored.durability), nullptr);
+}
+
+TEST(FrameSnapshotTest, Empty) {
+  FrameSnapshot snapshot{Frame{}};
+  Frame restored = MakeFrame(10);
+  snapshot.Restore(restored);
+  EXPECT_TRUE(restored.transforms.empty());
+  EXPECT_TRUE(restored.durability.empty());
+  EXPECT_EQ(restored.flag_index.size(), 0);
+}
+
+TEST(FrameSnapshotTest, ReusesMemory) {
+  const Frame large = MakeFrame(1000);
+  const Frame small = MakeFrame(10);
+
+  FrameSnapshot snapshot(large);
+  const size_t capacity = snapshot.capacity();
+  snapshot.Capture(small);
+  EXPECT_EQ(snapshot.capacity(), capacity);
+
+  // Restoring into a frame that's already big enough doesn't reallocate.
+  Frame restored = large;
+  const Transform *transforms = restored.transforms.data();
+  snapshot.Restore(restored);
+  EXPECT_EQ(restored.transforms.data(), transforms);
+  ExpectFramesEqual(restored, small);
+}
+
+TEST(FrameSnapshotTest, ReducedComponentSet) {
+  BasicFrame<Durability> frame;
+  const Entity id = frame.Push();
+  id.Set(frame.durability, Durability{.value = 3});
+
+  BasicFrameSnapshot<BasicFrame<Durability>> snapshot(frame);
+  BasicFrame<Durability> restored;
+  snapshot.Restore(restored);
+  EXPECT_EQ(restored.transforms.size(), 1);
+  EXPECT_EQ(restored.durability, frame.durability);
+  EXPECT_TRUE(restored.flag_index.Matches(restored.flags));
+}
+
+}  // namespace
+}  // namespace vstr
@@ -0,0 +1,119 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "frame.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace vstr {
+namespace {
+
+using testing::ElementsAre;
+
+FrameColumns Scene(const int size) {
+  FrameColumns columns;
+  for (int i = 0; i < size; ++i) {
+    columns.transforms.push_back(
+        Transform{.position = Vector3{static_cast<float>(i), 0, 0}});
+    columns.mass.push_back(Mass{.inertial = 1});
+    columns.motion.push_back(Motion{});
+    columns.colliders.push_back(Collider{});
+    columns.glue.push_back(Glue{});
+    columns.flags.push_back(Flags{});
+  }
+  return columns;
+}
+
+TEST(FrameTest, ImportSortsOptionalComponents) {
+  FrameColumns columns = Scene(4);
+  columns.flags[2].value = Flags::kDestroyed;
+  const Transform *transforms = columns.transforms.data();
+  columns.durability = {Durability{.id = Entity(3), .value = 3},
+                        Durability{.id = Entity(0), .value = 0},
+                        Durability{.id = Entity(2), .value = 2}};
+
+  Frame frame;
+  ASSERT_TRUE(frame.Import(std::move(columns)).ok());
+
+  // The frame took over the caller's storage.
+  EXPECT_EQ(frame.transforms.data(), transforms);
+  EXPECT_EQ(frame.transforms.size(), 4);
+  EXPECT_TRUE(frame.flag_index.Matches(frame.flags));
+  EXPECT_TRUE(frame.flag_index.Test(Entity(2), Flags::kDestroyed));
+
+  EXPECT_THAT(frame.durability.dense(),
+              ElementsAre(Durability{.id = Entity(0), .value = 0},
+                          Durability{.id = Entity(2), .value = 2},
+                          Durability{.id = Entity(3), .value = 3}));
+  ASSERT_NE(Entity(3).Get(frame.durability), nullptr);
+  EXPECT_EQ(Entity(3).Get(frame.durability)->value, 3);
+  EXPECT_EQ(Entity(1).Get(frame.durability), nullptr);
+}
+
+TEST(FrameTest, ImportRejectsInvalidScenes) {
+  Frame frame;
+  ASSERT_TRUE(frame.Import(Scene(2)).ok());
+
+  FrameColumns short_column = Scene(3);
+  short_column.glue.pop_back();
+  EXPECT_EQ(frame.Import(std::move(short_column)).code(),
+            absl::StatusCode::kInvalidArgument);
+
+  FrameColumns out_of_range = Scene(3);
+  out_of_range.rockets = {Rocket{.id = Entity(3)}};
+  EXPECT_EQ(frame.Import(std::move(out_of_range)).code(),
+            absl::StatusCode::kInvalidArgument);
+
+  FrameColumns duplicate = Scene(3);
+  duplicate.orbits = {Orbit{.id = Entity(1)}, Orbit{.id = Entity(0)},
+                      Orbit{.id = Entity(1)}};
+  EXPECT_EQ(frame.Import(std::move(duplicate)).code(),
+            absl::StatusCode::kInvalidArgument);
+
+  // Failed imports leave the frame alone.
+  EXPECT_EQ(frame.transforms.size(), 2);
+  EXPECT_TRUE(frame.orbits.empty());
+}
+
+// A frame type without most optional components.
+using SmallFrame = BasicFrame<Durability>;
+
+static_assert(SmallFrame::kHas<Durability>);
+static_assert(!SmallFrame::kHas<Rocket>);
+static_assert(sizeof(SmallFrame) < sizeof(Frame));
+
+TEST(FrameTest, ReducedComponentSet) {
+  SmallFrame frame;
+  const Entity a = frame.Push();
+  const Entity b = frame.Push();
+  a.Set(frame.transforms, Transform{.position = Vector3{1, 2, 3}});
+  a.Set(frame.durability, Durability{.value = 5});
+  frame.CopyObject(b, a);
+
+  EXPECT_EQ(b.Get(frame.transforms).position, (Vector3{1, 2, 3}));
+  ASSERT_NE(b.Get(frame.durability), nullptr);
+  EXPECT_EQ(b.Get(frame.durability)->value, 5);
+
+  int optional_count = 0;
+  frame.ForEachOptional([&](const auto &) { ++optional_count; });
+  EXPECT_EQ(optional_count, 1);
+
+  FrameColumns with_rockets = Scene(2);
+  with_rockets.rockets = {Rocket{.id = Entity(0)}};
+  EXPECT_EQ(frame.Import(std::move(with_rockets)).code(),
+            absl::StatusCode::kInvalidArgument);
+
+  FrameColumns columns = Scene(3);
+  columns.durability = {Durability{.id = Entity(2), .value = 1}};
+  ASSERT_TRUE(frame.Import(std::move(columns)).ok());
+  EXPECT_EQ(frame.transforms.size(), 3);
+  EXPECT_EQ(Entity(2).Get(frame.durability)->value, 1);
+}
+
+}  // namespace
+}  // namespace vstr
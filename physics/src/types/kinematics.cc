@@ -0,0 +1,46 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "kinematics.h"
+
+namespace vstr {
+
+void Kinematics::Load(const std::vector<Transform> &transforms,
+                      const std::vector<Motion> &motion) {
+  const size_t count = transforms.size();
+  position.resize(count);
+  velocity.resize(count);
+  new_position.resize(count);
+  acceleration.resize(count);
+
+  for (size_t i = 0; i < count; ++i) {
+    position.Set(i, transforms[i].position);
+    velocity.Set(i, motion[i].velocity);
+    new_position.Set(i, motion[i].new_position);
+    acceleration.Set(i, motion[i].acceleration);
+  }
+}
+
+void Kinematics::Store(std::vector<Motion> &motion) const {
+  const size_t count = size();
+  for (size_t i = 0; i < count; ++i) {
+    motion[i].velocity = velocity.Get(i);
+    motion[i].new_position = new_position.Get(i);
+    motion[i].acceleration = acceleration.Get(i);
+  }
+}
+
+void Kinematics::Store(const std::vector<int32_t> &ids,
+                       std::vector<Motion> &motion) const {
+  for (const int32_t i : ids) {
+    motion[i].velocity = velocity.Get(i);
+    motion[i].new_position = new_position.Get(i);
+    motion[i].acceleration = acceleration.Get(i);
+  }
+}
+
+}  // namespace vstr
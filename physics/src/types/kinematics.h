@@ -0,0 +1,77 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_TYPES_KINEMATICS
+#define VSTR_TYPES_KINEMATICS
+
+#include <cstdint>
+#include <vector>
+
+#include "geometry/vector3.h"
+#include "types/required_components.h"
+
+namespace vstr {
+
+// Three parallel float arrays, one for each axis.
+struct Vector3Array {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+
+  inline size_t size() const { return x.size(); }
+
+  inline void resize(const size_t size) {
+    x.resize(size);
+    y.resize(size);
+    z.resize(size);
+  }
+
+  inline Vector3 Get(const size_t i) const { return Vector3{x[i], y[i], z[i]}; }
+
+  inline void Set(const size_t i, const Vector3 v) {
+    x[i] = v.x;
+    y[i] = v.y;
+    z[i] = v.z;
+  }
+};
+
+// Structure-of-arrays copy of the hot numeric fields of Transform and Motion.
+//
+// The Frame stores components as arrays of structures, because that's what the
+// C API and Entity::Get hand out. Systems that make several passes over
+// positions and velocities load them into Kinematics first: that way their
+// inner loops only pull the fields they use through cache and the compiler can
+// vectorize them.
+//
+// Offsets are entity IDs, same as with the required components.
+struct Kinematics {
+  Vector3Array position;
+  Vector3Array velocity;
+  Vector3Array new_position;
+  Vector3Array acceleration;
+
+  inline size_t size() const { return position.size(); }
+
+  // Copies the hot fields out of the AoS components.
+  void Load(const std::vector<Transform> &transforms,
+            const std::vector<Motion> &motion);
+
+  // Copies velocity, new_position and acceleration back into motion. (Position
+  // is only read by the systems using Kinematics - UpdatePositions writes it.)
+  void Store(std::vector<Motion> &motion) const;
+
+  // Same as above, but only for the objects in ids. Motion is the widest
+  // component, and most of it (spin, and the acceleration of objects that
+  // don't move) is cold. Writing back only the objects a system changed keeps
+  // the rest out of cache.
+  void Store(const std::vector<int32_t> &ids,
+             std::vector<Motion> &motion) const;
+};
+
+}  // namespace vstr
+
+#endif
@@ -20,7 +20,7 @@ std::ostream &operator<<(std::ostream &os, const Orbit::Kepler &kepler) {
 std::ostream &operator<<(std::ostream &os, const Orbit &orbit) {
   return os << "Orbit{/*id=*/" << orbit.id << "/*focus=*/" << orbit.focus
             << ", /*initial=*/" << orbit.epoch << ", /*delta=*/" << orbit.delta
-            << "}";
+            << ", /*parent_id=*/" << orbit.parent_id << "}";
 }
 
 std::ostream &operator<<(std::ostream &os, const Durability &durability) {
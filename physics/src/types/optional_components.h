@@ -16,6 +16,7 @@
 #include "geometry/quaternion.h"
 #include "geometry/vector3.h"
 #include "types/entity.h"
+#include "types/sparse_set.h"
 
 namespace vstr {
 
@@ -33,9 +34,17 @@ struct Orbit {
     bool operator==(const Kepler &) const = default;
   };
 
+  // Relative to the parent, if there is one.
   Vector3 focus;
   Kepler epoch;
   Kepler delta;
+  // If set, the focus moves with the parent along the parent's own Orbit, so
+  // moons follow their planets. Ignored if the parent has no Orbit. Parents
+  // must not form a cycle. If they do, one orbit on it is treated as having no
+  // parent, the same one by KeplerSolver and UpdateOrbitalMotion. Nil (-1) if
+  // there's no parent, because zero is a valid ID. (The C API's FrameSetOrbit
+  // ignores this field, see FrameSetOrbitParent.)
+  Entity parent_id;
 
   bool operator==(const Orbit &) const = default;
 };
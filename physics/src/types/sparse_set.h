@@ -0,0 +1,200 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_TYPES_SPARSE_SET
+#define VSTR_TYPES_SPARSE_SET
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <initializer_list>
+#include <iostream>
+#include <vector>
+
+#include "types/entity.h"
+
+namespace vstr {
+
+// Storage for one optional component type. The components themselves are kept
+// in a dense vector sorted by entity ID (this is what the C API hands out),
+// next to a sparse array mapping entity IDs to offsets in the dense vector.
+// This makes lookup O(1) instead of a binary search.
+//
+// Both arrays are flat vectors of plain data, so copying a SparseSet (e.g. into
+// a key frame) costs two memcpys.
+//
+// Callers may modify components through operator[] and the iterators, but must
+// not change their IDs.
+template <OptionalComponent T>
+class SparseSet {
+ public:
+  using value_type = T;
+  using size_type = size_t;
+  using iterator = typename std::vector<T>::iterator;
+  using const_iterator = typename std::vector<T>::const_iterator;
+
+  SparseSet() = default;
+
+  // Builds the set from components in any order. IDs must be unique.
+  explicit SparseSet(std::vector<T> components) {
+    std::sort(components.begin(), components.end(),
+              [](const T &a, const T &b) { return a.id < b.id; });
+    Adopt(std::move(components));
+  }
+
+  SparseSet(std::initializer_list<T> components)
+      : SparseSet(std::vector<T>(components)) {}
+
+  // Returns the offset of the entity's component in the dense vector, or -1 if
+  // the entity has no component in this set.
+  inline ssize_t IndexOf(const Entity id) const {
+    const int32_t i = id.value();
+    if (i < 0 || i >= static_cast<int32_t>(index_.size())) return -1;
+    return index_[i];
+  }
+
+  inline T *Find(const Entity id) {
+    const ssize_t idx = IndexOf(id);
+    return idx < 0 ? nullptr : &dense_[idx];
+  }
+
+  inline const T *Find(const Entity id) const {
+    const ssize_t idx = IndexOf(id);
+    return idx < 0 ? nullptr : &dense_[idx];
+  }
+
+  // Returns the entity's component, inserting a default-initialized one if
+  // there isn't one yet. Appending a component for the highest entity ID so far
+  // is amortized O(1), inserting in the middle is linear.
+  //
+  // WARNING: Invalidates existing pointers and references to components.
+  T &GetOrInit(const Entity id);
+
+  inline size_t size() const { return dense_.size(); }
+  inline bool empty() const { return dense_.empty(); }
+  inline void reserve(const size_t size) { dense_.reserve(size); }
+
+  inline T *data() { return dense_.data(); }
+  inline const T *data() const { return dense_.data(); }
+
+  inline T &operator[](const size_t idx) { return dense_[idx]; }
+  inline const T &operator[](const size_t idx) const { return dense_[idx]; }
+
+  inline iterator begin() { return dense_.begin(); }
+  inline iterator end() { return dense_.end(); }
+  inline const_iterator begin() const { return dense_.begin(); }
+  inline const_iterator end() const { return dense_.end(); }
+
+  // Replaces the contents of the set with components, which must already be
+  // sorted by ID, without duplicates. Takes over the vector's storage and only
+  // allocates the index.
+  void Adopt(std::vector<T> &&components) {
+    assert(std::adjacent_find(components.begin(), components.end(),
+                              [](const T &a, const T &b) {
+                                return !(a.id < b.id);
+                              }) == components.end());
+    dense_ = std::move(components);
+    index_.assign(dense_.empty() ? 0 : dense_.back().id.value() + 1, -1);
+    Reindex(0);
+  }
+
+  // Raw access to both arrays, for FrameSnapshot.
+  inline const std::vector<T> &dense() const { return dense_; }
+  inline const std::vector<int32_t> &index() const { return index_; }
+
+  // Overwrites both arrays with copies previously taken from dense() and
+  // index(). Reuses the existing storage if it's large enough.
+  void Assign(const T *dense, const size_t dense_size, const int32_t *index,
+              const size_t index_size) {
+    dense_.assign(dense, dense + dense_size);
+    index_.assign(index, index + index_size);
+  }
+
+  // The index is derived from the dense vector, so there's no need to compare
+  // it.
+  bool operator==(const SparseSet &other) const {
+    return dense_ == other.dense_;
+  }
+
+ private:
+  // Rewrites index entries for components at dense offsets from start on.
+  void Reindex(size_t start);
+
+  std::vector<T> dense_;
+  std::vector<int32_t> index_;
+};
+
+template <OptionalComponent T>
+T &SparseSet<T>::GetOrInit(const Entity id) {
+  const ssize_t existing = IndexOf(id);
+  if (existing >= 0) return dense_[existing];
+
+  assert(id.value() >= 0);
+  if (id.value() >= static_cast<int32_t>(index_.size())) {
+    index_.resize(id.value() + 1, -1);
+  }
+
+  if (dense_.empty() || dense_.back().id < id) {
+    index_[id.value()] = dense_.size();
+    dense_.push_back(T{.id = id});
+    return dense_.back();
+  }
+
+  auto it = std::lower_bound(
+      dense_.begin(), dense_.end(), T{.id = id},
+      [](const T &a, const T &b) { return a.id < b.id; });
+  const ssize_t idx = it - dense_.begin();
+#if !defined(NDEBUG)
+  std::cerr << "inserting optional component " << T{} << " for entity " << id
+            << " at non-terminal index " << idx
+            << " is a linear-time operation (building the scene this way "
+               "takes quadratic time)";
+#endif
+  dense_.insert(it, T{.id = id});
+  Reindex(idx);
+  return dense_[idx];
+}
+
+template <OptionalComponent T>
+void SparseSet<T>::Reindex(const size_t start) {
+  if (!dense_.empty() &&
+      dense_.back().id.value() >= static_cast<int32_t>(index_.size())) {
+    index_.resize(dense_.back().id.value() + 1, -1);
+  }
+  for (size_t i = start; i < dense_.size(); ++i) {
+    index_[dense_[i].id.value()] = i;
+  }
+}
+
+// DEPRECATED
+template <OptionalComponent T>
+ssize_t FindOptionalComponent(const SparseSet<T> &component_data,
+                              const Entity id) {
+  return component_data.IndexOf(id);
+}
+
+// DEPRECATED
+template <OptionalComponent T>
+ssize_t SetOptionalComponent(const Entity id, const T &component,
+                             SparseSet<T> &component_data) {
+  id.Set(component_data, component);
+  return component_data.IndexOf(id);
+}
+
+template <OptionalComponent T>
+void CopyOptionalComponent(const Entity dst, const Entity src,
+                           SparseSet<T> &component_data) {
+  const T *src_value = src.Get(component_data);
+  if (src_value == nullptr) return;
+  // GetOrInit can reallocate the dense vector out from under src_value.
+  const T value = *src_value;
+  dst.Set(component_data, value);
+}
+
+}  // namespace vstr
+
+#endif
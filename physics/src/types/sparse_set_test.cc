@@ -0,0 +1,101 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "sparse_set.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "types/optional_components.h"
+
+namespace vstr {
+namespace {
+
+using testing::ElementsAre;
+using testing::Field;
+
+TEST(SparseSetTest, Empty) {
+  SparseSet<Durability> set;
+  EXPECT_TRUE(set.empty());
+  EXPECT_EQ(Entity(0).Get(set), nullptr);
+  EXPECT_EQ(Entity(Entity::kMax - 1).Get(set), nullptr);
+  EXPECT_EQ(FindOptionalComponent(set, Entity::Nil()), -1);
+}
+
+TEST(SparseSetTest, BuildFromUnsorted) {
+  SparseSet<Durability> set(std::vector<Durability>{
+      Durability{.id = Entity(7), .value = 70},
+      Durability{.id = Entity(2), .value = 20},
+      Durability{.id = Entity(5), .value = 50},
+  });
+
+  EXPECT_THAT(set, ElementsAre(Field(&Durability::id, Entity(2)),
+                               Field(&Durability::id, Entity(5)),
+                               Field(&Durability::id, Entity(7))));
+  EXPECT_EQ(Entity(5).Get(set)->value, 50);
+  EXPECT_EQ(Entity(7).Get(set)->value, 70);
+  EXPECT_EQ(Entity(6).Get(set), nullptr);
+  EXPECT_EQ(Entity(8).Get(set), nullptr);
+}
+
+TEST(SparseSetTest, InsertKeepsIndexValid) {
+  SparseSet<Durability> set;
+  Entity(10).Set(set, Durability{.value = 10});
+  Entity(20).Set(set, Durability{.value = 20});
+  // Inserting in the middle shifts the component for entity 20.
+  Entity(15).Set(set, Durability{.value = 15});
+  Entity(1).Set(set, Durability{.value = 1});
+
+  EXPECT_THAT(set, ElementsAre(Field(&Durability::id, Entity(1)),
+                               Field(&Durability::id, Entity(10)),
+                               Field(&Durability::id, Entity(15)),
+                               Field(&Durability::id, Entity(20))));
+  for (const Durability &durability : set) {
+    ASSERT_NE(durability.id.Get(set), nullptr);
+    EXPECT_EQ(durability.id.Get(set)->value, durability.id.value());
+    EXPECT_EQ(&set[FindOptionalComponent(set, durability.id)],
+              durability.id.Get(set));
+  }
+
+  // GetOrInit on an existing entity doesn't insert.
+  EXPECT_EQ(Entity(15).GetOrInit(set).value, 15);
+  EXPECT_EQ(set.size(), 4);
+}
+
+TEST(SparseSetTest, CopyToSelf) {
+  SparseSet<Durability> set;
+  Entity(0).Set(set, Durability{.value = 3, .max = 5});
+  for (int i = 1; i < 100; ++i) {
+    // Each copy grows the dense vector, which is when it reallocates.
+    CopyOptionalComponent(Entity(i), Entity(0), set);
+  }
+
+  ASSERT_EQ(set.size(), 100);
+  for (int i = 0; i < 100; ++i) {
+    const Durability *durability = Entity(i).Get(set);
+    ASSERT_NE(durability, nullptr);
+    EXPECT_EQ(durability->id, Entity(i));
+    EXPECT_EQ(durability->value, 3);
+    EXPECT_EQ(durability->max, 5);
+  }
+}
+
+TEST(SparseSetTest, Copy) {
+  SparseSet<Durability> set;
+  Entity(4).Set(set, Durability{.value = 4});
+  SparseSet<Durability> cpy = set;
+  Entity(2).Set(cpy, Durability{.value = 2});
+
+  EXPECT_EQ(Entity(2).Get(set), nullptr);
+  EXPECT_EQ(Entity(4).Get(set)->value, 4);
+  EXPECT_EQ(Entity(2).Get(cpy)->value, 2);
+  EXPECT_EQ(Entity(4).Get(cpy)->value, 4);
+  EXPECT_FALSE(set == cpy);
+}
+
+}  // namespace
+}  // namespace vstr
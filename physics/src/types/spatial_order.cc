@@ -0,0 +1,46 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "spatial_order.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "geometry/morton.h"
+
+namespace vstr {
+
+void SpatialOrder::Rebuild(const std::vector<Transform> &transforms,
+                           const FlagIndex &flag_index) {
+  assert(flag_index.size() == transforms.size());
+  size_ = transforms.size();
+  order_.clear();
+  keys_.clear();
+  live_.resize(flag_index.word_count());
+  for (size_t w = 0; w < live_.size(); ++w) {
+    live_[w] = flag_index.Word(w, 0, Flags::kDestroyed);
+  }
+
+  AABB bounds;
+  flag_index.ForEach(0, Flags::kDestroyed, [&](const size_t i) {
+    if (keys_.empty()) {
+      bounds = AABB(transforms[i].position, transforms[i].position);
+    }
+    bounds.Encapsulate(transforms[i].position);
+    // Static cast is safe, because frames can't have more than
+    // Frame::kMaxObjects objects.
+    keys_.emplace_back(0, static_cast<int32_t>(i));
+  });
+  for (auto &[code, id] : keys_) {
+    code = MortonCode(transforms[id].position, bounds);
+  }
+  // IDs are unique, so ties on the Morton code still sort deterministically.
+  std::sort(keys_.begin(), keys_.end());
+  for (const auto &[code, id] : keys_) order_.push_back(id);
+}
+
+}  // namespace vstr
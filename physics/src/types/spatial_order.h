@@ -0,0 +1,78 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#ifndef VSTR_TYPES_SPATIAL_ORDER
+#define VSTR_TYPES_SPATIAL_ORDER
+
+#include <bit>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "types/flag_index.h"
+#include "types/required_components.h"
+
+namespace vstr {
+
+// The IDs of objects that aren't destroyed, sorted by the Morton code of their
+// position.
+//
+// Entity IDs are offsets into the component arrays, which the C API hands out
+// directly, so objects can't move in memory. Instead, systems that benefit
+// from locality (e.g. the broadphase, where neighboring queries walk the same
+// BVH nodes) visit objects in this order.
+//
+// The order goes stale as objects move, which only costs performance. It's
+// meant to be rebuilt every so often (the Pipeline does it periodically, and
+// the Timeline on key frames) and must not affect results: systems that use it
+// must produce the same output no matter what order they visit objects in.
+class SpatialOrder {
+ public:
+  // Sorts the objects that aren't destroyed by position.
+  void Rebuild(const std::vector<Transform> &transforms,
+               const FlagIndex &flag_index);
+
+  // Number of objects, destroyed or not, the order was built for. If this
+  // doesn't match the frame, the order must be rebuilt before use.
+  inline size_t size() const { return size_; }
+
+  inline const std::vector<int32_t> &order() const { return order_; }
+
+  // Calls fn(size_t id) for each object that isn't destroyed. Objects that
+  // weren't destroyed at the last Rebuild come first, in spatial order. Objects
+  // spawned since then follow in ascending order of ID. Destroyed objects are
+  // skipped 64 at a time, as with FlagIndex::ForEach.
+  template <typename Fn>
+  void ForEach(const FlagIndex &flag_index, Fn fn) const {
+    for (const int32_t id : order_) {
+      if (!flag_index.Test(Entity(id), Flags::kDestroyed)) {
+        fn(static_cast<size_t>(id));
+      }
+    }
+    const size_t words = flag_index.word_count();
+    for (size_t w = 0; w < words; ++w) {
+      uint64_t word = flag_index.Word(w, 0, Flags::kDestroyed);
+      if (w < live_.size()) word &= ~live_[w];
+      while (word != 0) {
+        fn(w * 64 + std::countr_zero(word));
+        word &= word - 1;
+      }
+    }
+  }
+
+ private:
+  // Scratch space for sorting: Morton code and entity ID.
+  std::vector<std::pair<uint64_t, int32_t>> keys_;
+  std::vector<int32_t> order_;
+  // Bitset of the objects in order_.
+  std::vector<uint64_t> live_;
+  size_t size_ = 0;
+};
+
+}  // namespace vstr
+
+#endif
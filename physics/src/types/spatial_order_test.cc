@@ -0,0 +1,78 @@
+// This file is part of VSTR Space Physics.
+//
+// Copyright 2021 Adam Sindelar
+// License: http://www.gnu.org/licenses/old-licenses/gpl-2.0-standalone.html
+//
+// Author(s): Adam Sindelar <adam@wowsignal.io>
+
+#include "spatial_order.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace vstr {
+namespace {
+
+using testing::ElementsAre;
+
+TEST(SpatialOrderTest, GroupsNeighbors) {
+  // Two clusters, interleaved by ID.
+  const std::vector<Transform> transforms{
+      Transform{.position{100, 100, 100}}, Transform{.position{0, 0, 0}},
+      Transform{.position{101, 100, 100}}, Transform{.position{1, 0, 0}},
+      Transform{.position{100, 101, 100}}, Transform{.position{0, 1, 0}},
+  };
+  FlagIndex flag_index;
+  flag_index.Rebuild(std::vector<Flags>(transforms.size()));
+  SpatialOrder order;
+  order.Rebuild(transforms, flag_index);
+  EXPECT_THAT(order.order(), ElementsAre(1, 3, 5, 0, 2, 4));
+}
+
+TEST(SpatialOrderTest, ForEachSkipsDestroyed) {
+  const std::vector<Transform> transforms{
+      Transform{.position{3, 0, 0}}, Transform{.position{2, 0, 0}},
+      Transform{.position{1, 0, 0}}, Transform{.position{0, 0, 0}}};
+  FlagIndex flag_index;
+  flag_index.Rebuild({Flags{}, Flags{Flags::kDestroyed}, Flags{}, Flags{}});
+  SpatialOrder order;
+  order.Rebuild(transforms, flag_index);
+  EXPECT_THAT(order.order(), ElementsAre(3, 2, 0));
+
+  std::vector<size_t> visited;
+  order.ForEach(flag_index, [&](const size_t id) { visited.push_back(id); });
+  EXPECT_THAT(visited, ElementsAre(3, 2, 0));
+}
+
+TEST(SpatialOrderTest, ForEachAfterSpawnAndDestroy) {
+  // Mostly destroyed, like an object pool, across more than one word.
+  std::vector<Transform> transforms(130);
+  std::vector<Flags> flags(130, Flags{Flags::kDestroyed});
+  for (size_t i = 0; i < transforms.size(); ++i) {
+    transforms[i].position = Vector3{-static_cast<float>(i), 0, 0};
+  }
+  flags[2].value = 0;
+  flags[100].value = 0;
+  FlagIndex flag_index;
+  flag_index.Rebuild(flags);
+  SpatialOrder order;
+  order.Rebuild(transforms, flag_index);
+  EXPECT_THAT(order.order(), ElementsAre(100, 2));
+
+  // Spawned objects come after the sorted ones, destroyed ones are skipped.
+  flag_index.Set(Entity(129), Flags{});
+  flag_index.Set(Entity(5), Flags{});
+  flag_index.Set(Entity(100), Flags{Flags::kDestroyed});
+  std::vector<size_t> visited;
+  order.ForEach(flag_index, [&](const size_t id) { visited.push_back(id); });
+  EXPECT_THAT(visited, ElementsAre(2, 5, 129));
+}
+
+TEST(SpatialOrderTest, Empty) {
+  SpatialOrder order;
+  order.Rebuild({}, FlagIndex());
+  EXPECT_EQ(order.size(), 0);
+}
+
+}  // namespace
+}  // namespace vstr